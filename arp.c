@@ -0,0 +1,142 @@
+/* Tempo-synced arpeggiator */
+
+#include "pico/stdlib.h"
+#include "config.h"
+#include "state.h"
+#include "midi_clock.h"
+#include "note_queue.h"
+#include "synth_queue.h"
+#include "arp.h"
+
+// Steps per beat of each rate: 1/4, 1/8, 1/8 triplets, 1/16, 1/16 triplets, 1/32
+static const uint8_t steps_per_beat[NUM_ARP_RATES] = {1, 2, 3, 4, 6, 8};
+
+// Declare the static arpeggiator instance
+static arp_t arp;
+
+// Scheduled notes, in time order, for Midi and the looper
+static note_queue_t queue;
+
+void arp_hold(uint8_t id, uint8_t velocity) {
+    for (uint8_t i = 0; i < arp.held_count; i++) {
+        if (arp.held[i] == id) {
+            arp.velocity[i] = velocity;
+            return;
+        }
+    }
+    if (arp.held_count >= ARP_PADS_MAX) { return; }
+    arp.held[arp.held_count] = id;
+    arp.velocity[arp.held_count] = velocity;
+    arp.held_count++;
+}
+
+void arp_release(uint8_t id) {
+    for (uint8_t i = 0; i < arp.held_count; i++) {
+        if (arp.held[i] != id) { continue; }
+        for (uint8_t j = i; j < arp.held_count - 1; j++) {
+            arp.held[j] = arp.held[j + 1];
+            arp.velocity[j] = arp.velocity[j + 1];
+        }
+        arp.held_count--;
+        return;
+    }
+}
+
+void arp_clear() {
+    arp.held_count = 0;
+}
+
+static inline uint32_t get_step_us() {
+    return midi_clock_get_beat_us() / steps_per_beat[get_arp_rate()];
+}
+
+static inline uint32_t next_random() {
+    // Xorshift
+    arp.random ^= arp.random << 13;
+    arp.random ^= arp.random >> 17;
+    arp.random ^= arp.random << 5;
+    return arp.random;
+}
+
+// Index in the held pads of the given rank, from the lowest note up
+static inline uint8_t get_sorted_index(uint8_t rank) {
+    uint8_t order[ARP_PADS_MAX];
+    for (uint8_t i = 0; i < arp.held_count; i++) {
+        uint8_t j = i;
+        while (j > 0 && get_note_by_id(arp.held[order[j - 1]]) > get_note_by_id(arp.held[i])) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+    return order[rank];
+}
+
+// Pick the held pad and octave of the current step
+static void pick_step(uint8_t *index, uint8_t *octave) {
+    uint16_t length = arp.held_count * get_arp_octaves();
+    uint16_t step = arp.position % length;
+    switch (get_arp_pattern()) {
+        case ARP_DOWN:
+            step = length - 1 - step;
+        break;
+        case ARP_UP_DOWN:
+            if (length > 1) {
+                uint16_t cycle = 2 * length - 2; // The top and bottom notes are not repeated
+                step = arp.position % cycle;
+                if (step >= length) { step = cycle - step; }
+            }
+        break;
+        case ARP_RANDOM:
+            step = next_random() % length;
+        break;
+        default:
+        break;
+    }
+    *octave = step / arp.held_count;
+    uint8_t rank = step % arp.held_count;
+    *index = (get_arp_pattern() == ARP_AS_PLAYED ? rank : get_sorted_index(rank));
+}
+
+// Schedule the note on and note off of the next step
+static void schedule_step() {
+    uint8_t index, octave;
+    pick_step(&index, &octave);
+    uint8_t id = arp.held[index] + 12 * octave;
+    uint8_t note = get_note_by_id(id);
+    uint32_t step_us = get_step_us();
+    uint32_t gate_us = step_us * get_arp_gate() / ARP_GATE_MAX;
+
+    note_queue_push(&queue, arp.next_step_us, id, note, arp.velocity[index]);
+    note_queue_push(&queue, arp.next_step_us + gate_us, id, note, 0);
+    synth_queue_push(arp.next_step_us, SYNTH_NOTE_ON, note, arp.velocity[index]);
+    synth_queue_push(arp.next_step_us + gate_us, SYNTH_NOTE_OFF, note, 0);
+    arp.next_step_us += step_us;
+    arp.position++;
+}
+
+// Called from the main loop. Sends the notes that are due to Midi and the looper,
+// and schedules the steps that start within NOTE_LOOKAHEAD_US.
+void arp_task(uint32_t now) {
+    scheduled_note_t event;
+    while (note_queue_pop_due(&queue, now, &event)) {
+        arp_output(&event);
+    }
+
+    if (arp.held_count == 0 || get_arp_pattern() == ARP_OFF) {
+        arp.running = false;
+        return;
+    }
+    if (!arp.running) { // The first step plays right away
+        arp.running = true;
+        arp.position = 0;
+        arp.next_step_us = now;
+        if (arp.random == 0) { arp.random = now | 1; }
+    }
+    // If the main loop was held up for longer than the lookahead, drop the missed steps
+    if ((int32_t)(now - arp.next_step_us) > NOTE_LOOKAHEAD_US) { arp.next_step_us = now; }
+
+    while ((int32_t)(arp.next_step_us - now) < NOTE_LOOKAHEAD_US && note_queue_get_free(&queue) >= 2) {
+        schedule_step();
+    }
+}
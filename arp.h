@@ -0,0 +1,36 @@
+#ifndef ARP_H
+#define ARP_H
+#include "pico/stdlib.h"
+#include "note_queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ARP_PADS_MAX        12
+
+// Arpeggiator fed by the pads held. Steps are scheduled ahead of time by the
+// main loop; the synth plays them on core1 at the exact sample they are due,
+// so the timing does not depend on what the main loop is busy with.
+typedef struct arp {
+    uint8_t held[ARP_PADS_MAX];         // Pads held, in the order they were played
+    uint8_t velocity[ARP_PADS_MAX];     // Velocity of each pad held
+    uint8_t held_count;
+    bool running;
+    uint16_t position;                  // Step in the pattern
+    uint32_t next_step_us;              // Time of the next step to schedule
+    uint32_t random;                    // State of the random pattern generator
+} arp_t;
+
+void arp_hold(uint8_t id, uint8_t velocity);
+void arp_release(uint8_t id);
+void arp_clear();
+void arp_task(uint32_t now);
+
+extern void arp_output(const scheduled_note_t *event);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
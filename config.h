@@ -21,6 +21,10 @@
 #define ENCODER_CLK_DESCRIPTION     "Encoder clock pin"
 #define ENCODER_SWITCH_PIN          21
 #define ENCODER_SWITCH_DESCRIPTION  "Encoder switch"
+// Encoder acceleration: fast turns move long ranges (key, parameter values, presets) by several steps per detent
+#define ENCODER_ACCEL_SLOW_US       40000 // Detents further apart than this move by one step
+#define ENCODER_ACCEL_FAST_US       6000  // Detents this close move by ENCODER_ACCEL_MAX_STEPS
+#define ENCODER_ACCEL_MAX_STEPS     8     // Set to 1 to disable the acceleration
 #define LONG_PRESS_THRESHOLD        1000 // Amount of ms to hold the button to trigger a long press
 
 /* SSD1306 Display */
@@ -70,13 +74,17 @@
 #define MPR121_RELEASE_THRESHOLD    64 // size of your electrodes and their distance from the chip.
                                        // Threshold range is 0-255. If set incorrectly, you will get
                                        // "ghost" note_on and note_off events.
-#define MPR121_DEBOUNCE_THRESHOLD   46 // Larger values allow holding the electrode for longer without
+#define MPR121_DEBOUNCE_MS          90 // Larger values allow holding the electrode for longer without
                                        // triggering a new note_on event, but make it harder for the
                                        // sensor to detect quick subsequent taps
 
-#define VELOCITY_HOLD_SAMPLES       127 // How long to hold the peak value from accelerometer data.
+#define VELOCITY_HOLD_MS            250 // How long to hold the peak value from accelerometer data.
+#define VELOCITY_PEAK_MS            20  // The peak is the highest reading over this window.
 #define VELOCITY_MULTIPLIER         4   // Higher values yield higher velocity, but
                                         // lower the dynamic range.
+#define TILT_SMOOTHING_SHIFT        3   // Smoothing of tilt-driven cutoff and pitch bend. Each audio buffer
+                                        // covers 1/(2^shift) of the distance to the target value.
+#define MORPH_INTERVAL_US           10000 // Morphed parameters are sent to the synth at most this often
 
 /* Audio and synth */
 #define PRA32_U_MIDI_CH             0  // 0-based
@@ -94,17 +102,70 @@
 #define I2S_LRCK_DESCRIPTION        "I2S LRCK" // Must be BCK+1
 // The third required connection is GPIO 1 -> I2S LRCK (BCK+1)
 
+#define PRESET_SWITCH_FADE          // Briefly fade the output out and in when switching presets,
+                                    // to avoid clicks. Remove this line to switch instantly.
+
 #define LPF_MIN                     64 // Lowest filter cutoff frequency on a 0-127 scale.
 #define HIGHEST_KEY                 99 // Highest note that can be set as root note
-
-#define USE_MIDI                    // Remove this line to disable Midi output
+#define NUM_INSTRUMENTS_BUILTIN     9  // The Dodepan preset plus the 8 PRA32-U presets
+#define NUM_INSTRUMENTS             (NUM_INSTRUMENTS_BUILTIN + NUM_PRESET_SLOTS)
+
+#define USE_MIDI                    // Remove this line to disable Midi output and input
+#define MIDI_IN_CHANNEL             PRA32_U_MIDI_CH // Incoming Midi messages are received on this channel (0-based)
+#define MIDI_MIN_INTERVAL_US        5000  // Minimum time between two pitch bend or control change messages
+#define MIDI_BEND_THRESHOLD         128   // Pitch bend changes (0-16383) sent without waiting for the tilt to settle
+#define MIDI_CC_THRESHOLD           2     // Control changes (0-127) sent without waiting for the tilt to settle
+#define MIDI_SETTLE_US              40000 // Smaller changes are sent once the tilt has not changed for this long
+// #define MIDI_CLOCK_OUT              // Send Midi clock derived from the loop length while the looper plays
+#define MIDI_CLOCK_OUT_BEAT_US      500000 // Loops are assumed to be the whole number of beats closest to this length
+// #define USE_MIDI_DIN                // Also send Midi through a 5-pin DIN or TRS jack, at 31250 baud
+#define MIDI_DIN_PIO_NUM            1  // 0 for pio0, 1 for pio1
+#define MIDI_DIN_TX_PIN             8  // -> Midi out, through the usual 220Ω resistors
+#define MIDI_DIN_TX_DESCRIPTION     "Midi DIN out"
+// #define MIDI_MPE                    // Send each note on its own channel (MPE lower zone), with per-note bend and pressure
+#define MPE_MEMBER_CHANNELS         12 // Member channels of the zone, up to 15
+#define MPE_BEND_RANGE              2  // Pitch bend range of the member channels, in semitones
+
+/* Looper */
+#define LOOPER_EVENTS_MAX           2048   // Recorded notes and tilt values, 8 bytes each
+#define LOOPER_TILT_INTERVAL_US     50000  // Minimum time between two recorded values of the same tilt axis
+#define LOOPER_TILT_SETTLE_US       100000 // Smaller tilt changes are recorded once the tilt has not changed for this long
+#define LOOPER_BEND_THRESHOLD       256    // Pitch bend changes (0-16383) recorded without waiting for the tilt to settle
+#define LOOPER_CUTOFF_THRESHOLD     4      // Cutoff changes (0-127) recorded without waiting for the tilt to settle
+
+/* Arpeggiator and step sequencer */
+#define TEMPO_BPM                   120   // Tempo when no Midi clock is received
+#define NOTE_LOOKAHEAD_US           20000 // Steps are scheduled this far ahead, which covers the longest main loop iterations
+#define SEQ_GATE                    7     // Length of the sequencer notes, in tenths of a step
+
+/* Scheduling */
+// Period of the core0 tasks, in microseconds. Between runs, the core sleeps.
+#define ENCODER_PERIOD_US           1000
+#define TOUCH_PERIOD_US             1000
+#define IMU_PERIOD_US               5000  // 200 Hz
+#define LOOPER_PERIOD_US            1000
+#define MIDI_PERIOD_US              1000  // Midi input and output, and the USB device task
+#define DISPLAY_PERIOD_US           33333 // 30 frames per second at most
+#define FLASH_PERIOD_US             100000 // Checks for a pending settings write
 
 /* Flash memory */
-// Reserve the last 4KB of the default 2MB flash for persistence.
+// Reserve the last 4KB of the default 2MB flash for persistence of settings and scales,
+// and the PRESET_BANK_SECTORS sectors right before it for the user preset bank.
 #define FLASH_TARGET_OFFSET         (FLASH_SECTOR_SIZE * 511)
+#define PRESET_BANK_SECTORS         2   // Each 4KB sector holds 64 presets
+#define PRESET_BANK_OFFSET          (FLASH_TARGET_OFFSET - FLASH_SECTOR_SIZE * PRESET_BANK_SECTORS)
 #define MAGIC_NUMBER                {0x44, 0x4F, 0x44, 0x45} // 'DODE' - δώδε means 'twelve' in ancient Greek
 #define MAGIC_NUMBER_LENGTH         4
+#define FLASH_DATA_VERSION          1   // Version 0 (firmware 2.5.2 and earlier) stored presets with the settings
 #define FLASH_WRITE_DELAY_S         10  // To minimize flash operations, delay writing by this amount of seconds
-#define NUM_PRESET_SLOTS            4
+#define NUM_PRESET_SLOTS            128 // Must fit in PRESET_BANK_SECTORS
+#define NUM_LEGACY_PRESET_SLOTS     4   // Number of presets stored by flash data version 0
 #define NUM_SCALE_SLOTS             4
+
+/* Debugging */
+// #define USE_PROFILER                // Measure the main loop tasks and the Midi output queue, reported on the
+                                    // serial console and on hidden screens (turn the encoder on the info screen)
+// #define INPUT_TRACE                 // Record and replay the inputs, controlled from the serial console
+#define INPUT_TRACE_EVENTS          4096 // 8 bytes each
+#define INPUT_TRACE_OUTPUTS         1024 // Midi messages logged while tracing, 8 bytes each
 #endif /* CONFIG_H_ */
@@ -8,6 +8,9 @@
 #include "ssd1306.h"        // https://github.com/TuriSc/pico-ssd1306
 #include "state.h"
 #include "looper.h"
+#include "seq.h"
+#include "preset_bank.h"
+#include "profiler.h"
 #include "display.h"
 
 // Include assets
@@ -33,7 +36,11 @@
 
 #define ICON_CENTERED_MARGIN_X ((SSD1306_WIDTH / 2) - (32 / 2))
 
+#define SEQ_GRID_PAGE 3 // The step grid takes the bottom row of 8 pixels
+
 static alarm_id_t display_dim_alarm_id;
+static volatile bool draw_requested;
+static int8_t seq_drawn_step = -1; // Step marked on the grid shown, -1 when not shown
 
 void display_init(ssd1306_t *p) {
     p->external_vcc=false;
@@ -192,26 +199,190 @@ static inline void draw_synth_edit_screen(ssd1306_t *p) {
     }
 }
 
-// If you changed NUM_PRESET_SLOTS in config.h you will have to adjust this function accordingly
 static inline void draw_synth_store_screen(ssd1306_t *p) {
     int8_t slot = get_preset_slot();
 
-    uint8_t position = slot + 1;
-
     ssd1306_draw_string(p, 0, 0, 1, "Store preset in slot:");
 
     // Close icon
     ssd1306_bmp_show_image_with_offset(p, icon_close_data, icon_close_size, 8, 11);
 
-    ssd1306_draw_string_with_font(p,  34, 12, 1, octave_font, "1");
-    ssd1306_draw_string_with_font(p,  60, 12, 1, octave_font, "2");
-    ssd1306_draw_string_with_font(p,  86, 12, 1, octave_font, "3");
-    ssd1306_draw_string_with_font(p, 112, 12, 1, octave_font, "4");
-    
+    if (slot == -1) {
+        // Underline the close icon
+        ssd1306_draw_square(p, 8, 25, 12, 2);
+        return;
+    }
+
+    // Slot number
+    char str[4];
+    snprintf(str, sizeof(str), "%u", (uint8_t)(slot + 1));
+    ssd1306_draw_string_with_font(p, 34, 12, 1, octave_font, str);
+
     // Underline
-    ssd1306_draw_square(p, 8 + 26 * position, 25, 12, 2);
+    ssd1306_draw_square(p, 34, 25, 11 * strlen(str), 2);
+
+    // Warn before overwriting a stored preset
+    if (preset_bank_is_used(slot)) {
+        ssd1306_draw_string(p, 76, 14, 1, "(used)");
+    }
 }
 
+static inline void draw_morph_screen(ssd1306_t *p) {
+    int8_t slot = get_morph_slot();
+
+    ssd1306_draw_string(p, 0, 0, 1, "Morph into preset:");
+
+    if (slot == -1) {
+        // Close icon, underlined
+        ssd1306_bmp_show_image_with_offset(p, icon_close_data, icon_close_size, 8, 11);
+        ssd1306_draw_square(p, 8, 25, 12, 2);
+        return;
+    }
+
+    char str[10];
+    snprintf(str, sizeof(str), "%s%d", string_user_preset, slot + 1);
+    ssd1306_draw_string_with_font(p, 8, 14, 1, spaced_font, str);
+}
+
+static inline void draw_tuning_screen(ssd1306_t *p) {
+    ssd1306_draw_string(p, 0, 0, 1, "Tuning:");
+    ssd1306_draw_string_with_font(p, 8, 14, 1, spaced_font, tuning_names[get_tuning()]);
+}
+
+static inline void draw_chord_screen(ssd1306_t *p) {
+    ssd1306_draw_string(p, 8, 0, 1, "Chords:");
+    ssd1306_draw_string_with_font(p, 8, 14, 1, spaced_font, chord_mode_names[get_chord_mode()]);
+
+    // Draw selection mark
+    if(get_context() == CTX_CHORD) {
+        ssd1306_draw_square(p, 0, 0, 2, 32);
+    }
+}
+
+static inline void draw_arp_screen(ssd1306_t *p) {
+    static const uint8_t field_x[ARP_FIELD_LAST] = {8, 80, 8, 80};
+    static const uint8_t field_y[ARP_FIELD_LAST] = {12, 12, 23, 23};
+    char octaves[12];
+    char gate[12];
+    snprintf(octaves, sizeof(octaves), "%d oct", get_arp_octaves());
+    snprintf(gate, sizeof(gate), "%d%%", get_arp_gate() * 100 / ARP_GATE_MAX);
+    const char *fields[ARP_FIELD_LAST] = {
+        arp_pattern_names[get_arp_pattern()],
+        arp_rate_names[get_arp_rate()],
+        octaves,
+        gate,
+    };
+
+    ssd1306_draw_string(p, 8, 0, 1, "Arpeggio:");
+    for (uint8_t i = 0; i < ARP_FIELD_LAST; i++) {
+        ssd1306_draw_string(p, field_x[i], field_y[i], 1, fields[i]);
+    }
+
+    // Draw selection mark next to the field, and underline it while editing its value
+    context_t context = get_context();
+    if (context != CTX_ARP_FIELD && context != CTX_ARP_VALUE) { return; }
+    arp_field_t field = get_arp_field();
+    ssd1306_draw_square(p, field_x[field] - 5, field_y[field], 2, 7);
+    if (context == CTX_ARP_VALUE) {
+        ssd1306_draw_square(p, field_x[field], field_y[field] + 8, 6 * strlen(fields[field]) - 1, 1);
+    }
+}
+
+// One cell per step, a bar as high as the velocity for the notes,
+// and the step playing or under the cursor underlined
+static void draw_seq_grid(ssd1306_t *p) {
+    uint8_t length = seq_get_length();
+    uint8_t cell_width = SSD1306_WIDTH / length;
+    uint8_t marked = (seq_is_playing() ? seq_get_position() : seq_get_cursor());
+
+    ssd1306_clear_square(p, 0, SEQ_GRID_PAGE * 8, SSD1306_WIDTH, 8);
+    for (uint8_t i = 0; i < length; i++) {
+        uint8_t x = i * cell_width;
+        seq_step_t step = seq_get_step(i);
+        if (step.id == SEQ_REST) {
+            ssd1306_draw_square(p, x + cell_width / 2 - 1, 29, 1, 1);
+        } else {
+            uint8_t height = 1 + step.velocity * 5 / 7;
+            ssd1306_draw_square(p, x, 30 - height, cell_width - 1, height);
+        }
+    }
+    if (marked < length) {
+        ssd1306_draw_square(p, marked * cell_width, 31, cell_width - 1, 1);
+    }
+    seq_drawn_step = marked;
+}
+
+static inline void draw_seq_screen(ssd1306_t *p) {
+    if (get_context() == CTX_SELECTION) {
+        ssd1306_draw_string(p, 8, 0, 1, "Sequencer");
+        draw_seq_grid(p);
+        seq_drawn_step = -1; // Not updated on the selection screen
+        return;
+    }
+
+    char str[16];
+    if (seq_is_playing()) {
+        snprintf(str, sizeof(str), "Playing %d", seq_get_length());
+    } else {
+        snprintf(str, sizeof(str), "Step %d/%d", seq_get_cursor() + 1, SEQ_STEPS_MAX);
+    }
+    ssd1306_draw_string(p, 8, 0, 1, "Sequencer");
+    ssd1306_draw_string(p, 8, 12, 1, str);
+    draw_seq_grid(p);
+
+    // Draw selection mark
+    ssd1306_draw_square(p, 0, 0, 2, 20);
+}
+
+// Send a single page of the display buffer, instead of the whole of it
+static void show_page(ssd1306_t *p, uint8_t page) {
+    const uint8_t commands[] = {
+        0x00,                   // Command stream
+        0x21, 0, p->width - 1,  // Column address range
+        0x22, page, page,       // Page address range
+    };
+    i2c_write_blocking(p->i2c_i, p->address, commands, sizeof(commands), false);
+
+    uint8_t data[SSD1306_WIDTH + 1];
+    data[0] = 0x40; // Data stream
+    memcpy(&data[1], &p->buffer[page * p->width], p->width);
+    i2c_write_blocking(p->i2c_i, p->address, data, p->width + 1, false);
+}
+
+#if defined (USE_PROFILER)
+// Hidden screen with the main loop rate and the longest run of each task, in microseconds,
+// and the longest audio render in percent of the buffer period
+static inline void draw_diagnostics_screen(ssd1306_t *p) {
+    char str[22];
+    snprintf(str, sizeof(str), "%lu/s max %lu A%lu%%",
+             (unsigned long)profiler_get_loop_rate(), (unsigned long)profiler_get_max_us(PROF_LOOP),
+             (unsigned long)profiler_get_render_load());
+    ssd1306_draw_string(p, 0, 0, 1, str);
+    snprintf(str, sizeof(str), "Enc %-5lu Tch %lu",
+             (unsigned long)profiler_get_max_us(PROF_ENCODER), (unsigned long)profiler_get_max_us(PROF_TOUCH));
+    ssd1306_draw_string(p, 0, 8, 1, str);
+    snprintf(str, sizeof(str), "Imu %-5lu Lpr %lu",
+             (unsigned long)profiler_get_max_us(PROF_IMU), (unsigned long)profiler_get_max_us(PROF_LOOPER));
+    ssd1306_draw_string(p, 0, 16, 1, str);
+    snprintf(str, sizeof(str), "Mid %-5lu Usb %lu",
+             (unsigned long)profiler_get_max_us(PROF_MIDI), (unsigned long)profiler_get_max_us(PROF_USB));
+    ssd1306_draw_string(p, 0, 24, 1, str);
+}
+
+// Second hidden screen, with the Midi output queue counters over the last second
+static inline void draw_midi_diagnostics_screen(ssd1306_t *p) {
+    const midi_queue_stats_t *stats = profiler_get_midi_stats();
+    char str[22];
+    ssd1306_draw_string(p, 0, 0, 1, "Midi out /s");
+    snprintf(str, sizeof(str), "Sent %lu", (unsigned long)stats->sent);
+    ssd1306_draw_string(p, 0, 8, 1, str);
+    snprintf(str, sizeof(str), "Coalesced %lu", (unsigned long)stats->coalesced);
+    ssd1306_draw_string(p, 0, 16, 1, str);
+    snprintf(str, sizeof(str), "Dropped %lu", (unsigned long)stats->dropped);
+    ssd1306_draw_string(p, 0, 24, 1, str);
+}
+#endif
+
 static inline void draw_scale_edit_screen(ssd1306_t *p) {
     uint8_t spacing = 18;
     uint8_t line_height = 11;
@@ -272,6 +443,57 @@ void intro_animation(ssd1306_t *p, void (*callback)(void)) {
     callback();
 }
 
+static inline const char* get_instrument_name(uint8_t instrument, char *buf, size_t len) {
+    if (instrument < NUM_INSTRUMENTS_BUILTIN) { return instrument_names[instrument]; }
+    snprintf(buf, len, "%s%d", string_user_preset, instrument - NUM_INSTRUMENTS_BUILTIN + 1);
+    return buf;
+}
+
+static const char* looper_speed_names[LOOPER_SPEED_LAST] = {"1/2x", "1x", "2x"};
+
+static inline void draw_tracks_screen(ssd1306_t *p) {
+    static const uint8_t field_x[TRACK_FIELD_LAST] = {8, 8, 8, 72};
+    static const uint8_t field_y[TRACK_FIELD_LAST] = {0, 12, 23, 23};
+    uint8_t track = looper_get_track();
+    char track_str[10];
+    char volume_str[12];
+    char playback_str[10];
+    char user_preset_name[10];
+    snprintf(track_str, sizeof(track_str), "Track %d", track + 1);
+    snprintf(volume_str, sizeof(volume_str), "Volume %d", looper_get_track_volume(track));
+    snprintf(playback_str, sizeof(playback_str), "%s%s",
+             (looper_is_reversed() ? "Rev " : ""), looper_speed_names[looper_get_speed()]);
+    // A recorded track keeps its instrument, the next recording uses the current one
+    uint8_t instrument = (looper_track_has_recording(track) ? looper_get_track_instrument(track) : get_instrument());
+    const char *fields[TRACK_FIELD_LAST] = {
+        track_str,
+        get_instrument_name(instrument, user_preset_name, sizeof(user_preset_name)),
+        volume_str,
+        playback_str,
+    };
+
+    for (uint8_t i = 0; i < TRACK_FIELD_LAST; i++) {
+        ssd1306_draw_string(p, field_x[i], field_y[i], 1, fields[i]);
+    }
+    // One box per track, filled if it has a recording
+    for (uint8_t t = 0; t < LOOPER_TRACKS; t++) {
+        if (looper_track_has_recording(t)) {
+            ssd1306_draw_square(p, 80 + t * 10, 0, 7, 7);
+        } else {
+            ssd1306_draw_empty_square(p, 80 + t * 10, 0, 6, 6);
+        }
+    }
+
+    // Draw selection mark next to the field, and underline it while editing its value
+    context_t context = get_context();
+    if (context != CTX_TRACK_FIELD && context != CTX_TRACK_VALUE) { return; }
+    track_field_t field = get_track_field();
+    ssd1306_draw_square(p, field_x[field] - 5, field_y[field], 2, 7);
+    if (context == CTX_TRACK_VALUE) {
+        ssd1306_draw_square(p, field_x[field], field_y[field] + 8, 6 * strlen(fields[field]) - 1, 1);
+    }
+}
+
 #define OFFSET_X    32
 #define CHAR_W      7 // Includes spacing
 static inline void draw_main_screen(ssd1306_t *p) {
@@ -290,8 +512,10 @@ static inline void draw_main_screen(ssd1306_t *p) {
     if (scale_name_width > 12) { scale_name_width = 12; }
 
     // Instrument
-    ssd1306_draw_string_with_font(p, OFFSET_X, 21, 1, spaced_font, instrument_names[get_instrument()]);
-    uint8_t instrument_name_width = strlen(instrument_names[get_instrument()]);
+    char user_preset_name[10];
+    const char *instrument_name = get_instrument_name(get_instrument(), user_preset_name, sizeof(user_preset_name));
+    ssd1306_draw_string_with_font(p, OFFSET_X, 21, 1, spaced_font, instrument_name);
+    uint8_t instrument_name_width = strlen(instrument_name);
     if (instrument_name_width > 12) { instrument_name_width = 12; }
 
     // Volume
@@ -393,6 +617,7 @@ void display_draw(ssd1306_t *p) {
     context_t context = get_context();
 
     ssd1306_clear(p);
+    seq_drawn_step = -1;
 
     switch(context) {
         case CTX_SELECTION: {
@@ -409,6 +634,18 @@ void display_draw(ssd1306_t *p) {
                 case SELECTION_IMU_CONFIG:
                     draw_imu_axes_screen(p);
                 break;
+                case SELECTION_CHORD:
+                    draw_chord_screen(p);
+                break;
+                case SELECTION_ARP:
+                    draw_arp_screen(p);
+                break;
+                case SELECTION_SEQUENCER:
+                    draw_seq_screen(p);
+                break;
+                case SELECTION_TRACKS:
+                    draw_tracks_screen(p);
+                break;
             }
             break;
         }
@@ -441,10 +678,57 @@ void display_draw(ssd1306_t *p) {
         case CTX_SCALE_EDIT_STORE:
             draw_scale_store_screen(p);
         break;
+        case CTX_MORPH_SLOT:
+            draw_morph_screen(p);
+        break;
+        case CTX_TUNING:
+            draw_tuning_screen(p);
+        break;
+        case CTX_CHORD:
+            draw_chord_screen(p);
+        break;
+        case CTX_ARP_FIELD:
+        case CTX_ARP_VALUE:
+            draw_arp_screen(p);
+        break;
+        case CTX_SEQUENCER:
+            draw_seq_screen(p);
+        break;
+        case CTX_TRACK_FIELD:
+        case CTX_TRACK_VALUE:
+            draw_tracks_screen(p);
+        break;
         case CTX_INFO:
             draw_info_screen(p);
         break;
+#if defined (USE_PROFILER)
+        case CTX_DIAGNOSTICS:
+            draw_diagnostics_screen(p);
+        break;
+        case CTX_MIDI_DIAGNOSTICS:
+            draw_midi_diagnostics_screen(p);
+        break;
+#endif
     }
 
     ssd1306_show(p);
 }
+
+// Input handlers only request a redraw, which is done by display_task().
+// Several requests in the same display period result in a single redraw.
+void display_request_draw() {
+    draw_requested = true;
+}
+
+void display_task(ssd1306_t *p) {
+    if (draw_requested) {
+        draw_requested = false;
+        display_draw(p);
+        return;
+    }
+    // Follow the sequencer by updating the step grid only
+    if (seq_drawn_step >= 0 && seq_is_playing() && seq_get_position() != seq_drawn_step) {
+        draw_seq_grid(p);
+        show_page(p, SEQ_GRID_PAGE);
+    }
+}
@@ -15,6 +15,8 @@ extern "C" {
 
 void display_init(ssd1306_t *p);
 void display_draw(ssd1306_t *p);
+void display_request_draw();
+void display_task(ssd1306_t *p);
 void display_update_contrast(ssd1306_t *p);
 void display_dim(ssd1306_t *p);
 void display_wake(ssd1306_t *p);
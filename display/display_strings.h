@@ -41,6 +41,40 @@ const char *scale_names[] = {
     "Custom 4",
 };
 
+const char *tuning_names[] = {
+    "Equal",
+    "Just",
+    "Pythagorean",
+    "Meantone 1/4",
+    "Werckmeister",
+    "Rast",
+    "Harmonic",
+};
+
+const char *chord_mode_names[] = {
+    "Off",
+    "Triads",
+    "Sevenths",
+};
+
+const char *arp_pattern_names[] = {
+    "Off",
+    "Up",
+    "Down",
+    "Up-down",
+    "Random",
+    "As played",
+};
+
+const char *arp_rate_names[] = {
+    "1/4",
+    "1/8",
+    "1/8T",
+    "1/16",
+    "1/16T",
+    "1/32",
+};
+
 const char *octave_names[] = {
     "/",
     "0",
@@ -65,12 +99,10 @@ const char *instrument_names[] = {
     "PWM Lead",
     "Elec. Piano",
     "Square Tone",
-    "User 1",
-    "User 2",
-    "User 3",
-    "User 4",
 };
 
+const char *string_user_preset = "User ";
+
 const char *parameter_names[] = {
     "Osc 1 Wave",
     "Osc 1 Shape",
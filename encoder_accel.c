@@ -0,0 +1,35 @@
+/* Velocity-based encoder acceleration */
+
+#include "pico/stdlib.h"
+#include "encoder_accel.h"
+
+void encoder_accel_init(encoder_accel_t *accel, uint32_t slow_us, uint32_t fast_us, uint8_t max_steps) {
+    accel->slow_us = slow_us;
+    accel->fast_us = (fast_us < slow_us ? fast_us : slow_us);
+    accel->max_steps = (max_steps > 0 ? max_steps : 1);
+    accel->direction = 0;
+    accel->detent_us = 0;
+}
+
+// Steps for a detent that comes interval_us after the previous one
+uint8_t encoder_accel_get_steps(const encoder_accel_t *accel, uint32_t interval_us) {
+    if (interval_us >= accel->slow_us || accel->max_steps <= 1) { return 1; }
+    if (interval_us <= accel->fast_us) { return accel->max_steps; }
+
+    // Speed from 0 (slow) to 256 (fast), squared so that the acceleration
+    // only kicks in on deliberate sweeps and fine adjustments stay precise
+    uint32_t speed = (accel->slow_us - interval_us) * 256 / (accel->slow_us - accel->fast_us);
+    return 1 + (uint8_t)(((accel->max_steps - 1) * speed * speed + 32768) >> 16);
+}
+
+// Feed a detent. Returns the signed number of steps to move by.
+// Turning back always starts again from a single step.
+int8_t encoder_accel_update(encoder_accel_t *accel, int8_t direction, uint32_t now) {
+    uint8_t steps = 1;
+    if (direction == accel->direction) {
+        steps = encoder_accel_get_steps(accel, now - accel->detent_us);
+    }
+    accel->direction = direction;
+    accel->detent_us = now;
+    return (direction > 0 ? steps : -steps);
+}
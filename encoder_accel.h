@@ -0,0 +1,28 @@
+#ifndef ENCODER_ACCEL_H
+#define ENCODER_ACCEL_H
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Velocity-based encoder acceleration. A detent that follows the previous one
+// in the same direction within slow_us moves by more than one step, up to
+// max_steps when they are fast_us apart or less, along a quadratic curve.
+typedef struct encoder_accel {
+    uint32_t slow_us;           // Detents further apart than this move by one step
+    uint32_t fast_us;           // Detents this close move by max_steps
+    uint8_t max_steps;          // 1 disables the acceleration
+    int8_t direction;           // Direction of the previous detent
+    uint32_t detent_us;         // Timestamp of the previous detent
+} encoder_accel_t;
+
+void encoder_accel_init(encoder_accel_t *accel, uint32_t slow_us, uint32_t fast_us, uint8_t max_steps);
+uint8_t encoder_accel_get_steps(const encoder_accel_t *accel, uint32_t interval_us);
+int8_t encoder_accel_update(encoder_accel_t *accel, int8_t direction, uint32_t now);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
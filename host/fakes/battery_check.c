@@ -0,0 +1,8 @@
+/* Host version of the battery check library */
+
+#include "pico/stdlib.h"
+#include "battery-check.h"
+
+void battery_check_init(uint32_t interval_ms, void *callback_ok, void *callback_low) {}
+
+void battery_check_stop(void) {}
@@ -0,0 +1,29 @@
+/* Host version of the button library */
+
+#include <stdlib.h>
+#include "pico/stdlib.h"
+#include "button.h"
+
+#define BUTTONS_MAX 4
+
+static button_t buttons[BUTTONS_MAX];
+static uint8_t buttons_count;
+
+void button_system_init(void) {}
+
+button_t *create_button(int pin, void (*onchange)(button_t *)) {
+    if (buttons_count >= BUTTONS_MAX) { return NULL; }
+    button_t *button = &buttons[buttons_count++];
+    button->pin = pin;
+    button->state = true; // Released
+    button->onchange = onchange;
+    return button;
+}
+
+void fake_button_set(int pin, bool state) {
+    for (uint8_t i = 0; i < buttons_count; i++) {
+        if (buttons[i].pin != pin || buttons[i].state == state) { continue; }
+        buttons[i].state = state;
+        buttons[i].onchange(&buttons[i]);
+    }
+}
@@ -0,0 +1,27 @@
+/* Host version of the rotary encoder library */
+
+#include "pico/stdlib.h"
+#include "encoder.h"
+
+static rotary_encoder_t encoder;
+
+void encoder_system_init(void) {}
+
+void encoder_poll_all_events(void) {}
+
+rotary_encoder_t *create_encoder(int pin_a, int pin_b, void (*onchange)(rotary_encoder_t *)) {
+    encoder.pin_a = pin_a;
+    encoder.pin_b = pin_b;
+    encoder.position = 0;
+    encoder.onchange = onchange;
+    return &encoder;
+}
+
+// Each detent is four quadrature steps, each one reported to the callback
+void fake_encoder_turn(int detents) {
+    int direction = (detents > 0 ? 1 : -1);
+    for (int i = 0; i < detents * direction * ENCODER_STEPS_PER_DETENT; i++) {
+        encoder.position += direction;
+        if (encoder.onchange != NULL) { encoder.onchange(&encoder); }
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef HOST_MPU6050_H
+#define HOST_MPU6050_H
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Host version of https://github.com/Harbys/pico-mpu6050, with the sensor
+// simulated through the I2C shim
+#define MPU6050_ACCEL_XOUT_H    0x3B
+
+typedef enum {
+    MPU6050_RANGE_2G,
+    MPU6050_RANGE_4G,
+    MPU6050_RANGE_8G,
+    MPU6050_RANGE_16G,
+} mpu6050_range_t;
+
+typedef enum {
+    MPU6050_DHPF_RESET,
+    MPU6050_DHPF_5HZ,
+    MPU6050_DHPF_2_5HZ,
+    MPU6050_DHPF_1_25HZ,
+    MPU6050_DHPF_0_63HZ,
+    MPU6050_DHPF_HOLD,
+} mpu6050_dhpf_t;
+
+typedef enum {
+    MPU6050_DLPF_0,
+    MPU6050_DLPF_1,
+    MPU6050_DLPF_2,
+    MPU6050_DLPF_3,
+    MPU6050_DLPF_4,
+    MPU6050_DLPF_5,
+    MPU6050_DLPF_6,
+} mpu6050_dlpf_t;
+
+struct i2c_information {
+    i2c_inst_t *instance;
+    uint8_t address;
+};
+
+struct mpu6050_vector16 {
+    int16_t x;
+    int16_t y;
+    int16_t z;
+};
+
+typedef struct mpu6050 {
+    struct i2c_information i2c;
+    struct mpu6050_vector16 ra;
+} mpu6050_t;
+
+mpu6050_t mpu6050_init(i2c_inst_t *i2c_instance, uint8_t address);
+bool mpu6050_begin(mpu6050_t *self);
+void mpu6050_set_range(mpu6050_t *self, mpu6050_range_t range);
+void mpu6050_set_dhpf_mode(mpu6050_t *self, mpu6050_dhpf_t mode);
+void mpu6050_set_dlpf_mode(mpu6050_t *self, mpu6050_dlpf_t mode);
+void mpu6050_set_accelerometer_measuring(mpu6050_t *self, bool enabled);
+
+// Host test control: set the raw accelerometer reading
+void fake_mpu6050_set_accel(i2c_inst_t *i2c_instance, uint8_t address, int16_t x, int16_t y, int16_t z);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
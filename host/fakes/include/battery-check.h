@@ -0,0 +1,17 @@
+#ifndef HOST_BATTERY_CHECK_H
+#define HOST_BATTERY_CHECK_H
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Host version of https://github.com/TuriSc/RP2040-Battery-Check, the battery is never low
+void battery_check_init(uint32_t interval_ms, void *callback_ok, void *callback_low);
+void battery_check_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef HOST_BSP_BOARD_API_H
+#define HOST_BSP_BOARD_API_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void board_init(void);
+void board_init_after_tusb(void) __attribute__((weak));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
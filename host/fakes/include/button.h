@@ -0,0 +1,26 @@
+#ifndef HOST_BUTTON_H
+#define HOST_BUTTON_H
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Host version of https://github.com/TuriSc/RP2040-Button
+typedef struct button {
+    uint8_t pin;
+    bool state;     // True when released, the input is pulled up
+    void (*onchange)(struct button *button_p);
+} button_t;
+
+void button_system_init(void);
+button_t *create_button(int pin, void (*onchange)(button_t *));
+
+// Host test control: press (false) or release (true) the button, as its interrupt would
+void fake_button_set(int pin, bool state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
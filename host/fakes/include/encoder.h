@@ -0,0 +1,30 @@
+#ifndef HOST_ENCODER_H
+#define HOST_ENCODER_H
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Host version of https://github.com/TuriSc/RP2040-Rotary-Encoder
+#define ENCODER_STEPS_PER_DETENT    4
+
+typedef struct rotary_encoder {
+    uint8_t pin_a;
+    uint8_t pin_b;
+    long int position;
+    void (*onchange)(struct rotary_encoder *encoder);
+} rotary_encoder_t;
+
+void encoder_system_init(void);
+void encoder_poll_all_events(void);
+rotary_encoder_t *create_encoder(int pin_a, int pin_b, void (*onchange)(rotary_encoder_t *));
+
+// Host test control: turn the encoder by a number of detents, as its interrupts would
+void fake_encoder_turn(int detents);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
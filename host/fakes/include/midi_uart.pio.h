@@ -0,0 +1,46 @@
+#ifndef HOST_MIDI_UART_PIO_H
+#define HOST_MIDI_UART_PIO_H
+
+// Host version of the header pioasm generates from midi_uart.pio.
+// The program itself does not run; its c-sdk block is kept as is.
+#include "hardware/pio.h"
+
+static const uint16_t midi_uart_tx_program_instructions[] = {
+    0x9fa0, //  0: pull   block           side 1 [7]
+    0xf727, //  1: set    x, 7            side 0 [7]
+    0x6001, //  2: out    pins, 1
+    0x0642, //  3: jmp    x--, 2                 [6]
+};
+
+static const struct pio_program midi_uart_tx_program = {
+    .instructions = midi_uart_tx_program_instructions,
+    .length = 4,
+    .origin = -1,
+};
+
+static inline pio_sm_config midi_uart_tx_program_get_default_config(uint offset) {
+    pio_sm_config c = pio_get_default_sm_config();
+    return c;
+}
+
+#include "hardware/clocks.h"
+
+static inline void midi_uart_tx_program_init(PIO pio, uint sm, uint offset, uint pin, uint baud) {
+  // Keep the line idle (high) while the PIO takes over the pin
+  pio_sm_set_pins_with_mask(pio, sm, 1u << pin, 1u << pin);
+  pio_sm_set_pindirs_with_mask(pio, sm, 1u << pin, 1u << pin);
+  pio_gpio_init(pio, pin);
+
+  pio_sm_config sm_config = midi_uart_tx_program_get_default_config(offset);
+
+  sm_config_set_out_shift(&sm_config, true, false, 32);
+  sm_config_set_out_pins(&sm_config, pin, 1);
+  sm_config_set_sideset_pins(&sm_config, pin);
+  sm_config_set_fifo_join(&sm_config, PIO_FIFO_JOIN_TX);
+  sm_config_set_clkdiv(&sm_config, (float)clock_get_hz(clk_sys) / (8 * baud));
+
+  pio_sm_init(pio, sm, offset, &sm_config);
+  pio_sm_set_enabled(pio, sm, true);
+}
+
+#endif
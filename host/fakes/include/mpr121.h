@@ -0,0 +1,31 @@
+#ifndef HOST_MPR121_H
+#define HOST_MPR121_H
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Host version of https://github.com/antgon/pico-mpr121, reading the touch
+// status registers of the simulated sensor through the I2C shim
+#define MPR121_TOUCH_STATUS_REG     0x00
+
+struct mpr121_sensor {
+    i2c_inst_t *i2c_port;
+    uint8_t i2c_addr;
+};
+
+void mpr121_init(i2c_inst_t *i2c_port, uint8_t i2c_addr, struct mpr121_sensor *sensor);
+void mpr121_set_thresholds(uint8_t touch, uint8_t release, struct mpr121_sensor *sensor);
+void mpr121_enable_electrodes(uint8_t nelec, struct mpr121_sensor *sensor);
+void mpr121_is_touched(uint8_t electrode, bool *is_touched, struct mpr121_sensor *sensor);
+
+// Host test control: set the electrodes touched, one bit each
+void fake_mpr121_set_touched(uint16_t touched);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
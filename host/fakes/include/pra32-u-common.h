@@ -0,0 +1,7 @@
+#ifndef HOST_PRA32_U_COMMON_H
+#define HOST_PRA32_U_COMMON_H
+#include <stdint.h>
+
+// Host stand-in for https://github.com/risgk/digital-synth-pra32-u, see pra32-u-synth.h
+
+#endif
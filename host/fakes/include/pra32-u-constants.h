@@ -0,0 +1,52 @@
+#ifndef HOST_PRA32_U_CONSTANTS_H
+#define HOST_PRA32_U_CONSTANTS_H
+
+// Control numbers of the synth parameters
+#define OSC_1_WAVE          14
+#define OSC_1_SHAPE         15
+#define OSC_1_MORPH         16
+#define MIXER_SUB_OSC       17
+#define OSC_2_WAVE          18
+#define OSC_2_COARSE        19
+#define OSC_2_PITCH         20
+#define MIXER_OSC_MIX       21
+#define FILTER_CUTOFF       22
+#define FILTER_RESO         23
+#define FILTER_EG_AMT       24
+#define FILTER_KEY_TRK      25
+#define EG_ATTACK           26
+#define EG_DECAY            27
+#define EG_SUSTAIN          28
+#define EG_RELEASE          29
+#define EG_OSC_AMT          30
+#define EG_OSC_DST          31
+#define VOICE_MODE          33
+#define PORTAMENTO          34
+#define LFO_WAVE            35
+#define LFO_RATE            36
+#define LFO_DEPTH           37
+#define LFO_FADE_TIME       38
+#define LFO_OSC_AMT         39
+#define LFO_OSC_DST         40
+#define LFO_FILTER_AMT      41
+#define AMP_GAIN            42
+#define AMP_ATTACK          43
+#define AMP_DECAY           44
+#define AMP_SUSTAIN         45
+#define AMP_RELEASE         46
+#define FILTER_MODE         47
+#define EG_AMP_MOD          48
+#define REL_EQ_DECAY        49
+#define P_BEND_RANGE        50
+#define BTH_FILTER_AMT      51
+#define BTH_AMP_MOD         52
+#define EG_VEL_SENS         53
+#define AMP_VEL_SENS        54
+#define CHORUS_MIX          55
+#define CHORUS_RATE         56
+#define CHORUS_DEPTH        57
+#define DELAY_FEEDBACK      58
+#define DELAY_TIME          59
+#define DELAY_MODE          60
+
+#endif
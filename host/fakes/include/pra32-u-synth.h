@@ -0,0 +1,79 @@
+#ifndef HOST_PRA32_U_SYNTH_H
+#define HOST_PRA32_U_SYNTH_H
+#include <stdint.h>
+#include "pra32-u-constants.h"
+
+// Host stand-in for the PRA32-U synth engine, whose sources are not part of
+// the host build. It has the same interface and four voices (one in the mono
+// voice modes), and renders plain saw or pulse waves through a one-pole
+// low-pass filter and an ADSR envelope: enough to hear clicks, steps and
+// hanging notes, not to reproduce the real sound.
+// Every call is reported to an optional hook, with the core it came from.
+
+typedef enum fake_synth_call {
+    FAKE_SYNTH_NOTE_ON,
+    FAKE_SYNTH_NOTE_OFF,
+    FAKE_SYNTH_ALL_NOTES_OFF,
+    FAKE_SYNTH_CONTROL_CHANGE,
+    FAKE_SYNTH_PROGRAM_CHANGE,
+    FAKE_SYNTH_PITCH_BEND,
+} fake_synth_call_t;
+
+typedef struct fake_synth_event {
+    fake_synth_call_t call;
+    uint8_t data1;
+    uint8_t data2;
+    uint64_t sample;    // Samples rendered before the call
+    bool from_core1;
+} fake_synth_event_t;
+
+#define FAKE_SYNTH_VOICES   4
+
+class PRA32_U_Synth {
+public:
+    void initialize();
+    void note_on(uint8_t note_number, uint8_t velocity);
+    void note_off(uint8_t note_number);
+    void all_notes_off();
+    void all_sound_off();
+    void reset_all_controllers();
+    void control_change(uint8_t control_number, uint8_t value);
+    void program_change(uint8_t program_number);
+    void pitch_bend(uint8_t lsb, uint8_t msb);
+    uint8_t current_controller_value(uint8_t control_number);
+    int16_t process(int16_t right_input, int16_t& right_level);
+    void secondary_core_process();
+
+    // Host test interface
+    void fake_set_hook(void (*hook)(const fake_synth_event_t *event));
+    bool fake_is_note_held(uint8_t note_number);   // Gated by a note on, not released yet
+    uint8_t fake_get_held_notes();
+    uint64_t fake_get_samples();
+    uint32_t fake_get_calls_from_core0();           // Sound-changing calls made outside of core1
+
+private:
+    typedef struct voice {
+        uint8_t note;
+        bool gate;
+        float level;        // Envelope level
+        bool decaying;      // Past the attack
+        float phase;
+        float filter;
+        uint8_t velocity;
+        uint32_t age;
+    } voice_t;
+
+    void report(fake_synth_call_t call, uint8_t data1, uint8_t data2);
+    float render_voice(voice_t *voice);
+
+    uint8_t controllers[128];
+    bool held[128];
+    uint16_t bend;
+    voice_t voices[FAKE_SYNTH_VOICES];
+    uint32_t voice_age;
+    uint64_t samples;
+    uint32_t calls_from_core0;
+    void (*hook)(const fake_synth_event_t *event);
+};
+
+#endif
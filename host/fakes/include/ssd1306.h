@@ -0,0 +1,53 @@
+#ifndef HOST_SSD1306_H
+#define HOST_SSD1306_H
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Host version of https://github.com/TuriSc/pico-ssd1306: drawing goes to the
+// frame buffer, and showing it sends the same number of bytes on the I2C shim.
+// Text is drawn as filled cells rather than glyphs.
+typedef struct {
+    uint8_t width;
+    uint8_t height;
+    uint8_t pages;
+    uint8_t address;
+    i2c_inst_t *i2c_i;
+    bool external_vcc;
+    uint8_t *buffer;
+    size_t bufsize;
+} ssd1306_t;
+
+bool ssd1306_init(ssd1306_t *p, uint16_t width, uint16_t height, uint8_t address, i2c_inst_t *i2c_instance);
+void ssd1306_deinit(ssd1306_t *p);
+void ssd1306_poweroff(ssd1306_t *p);
+void ssd1306_poweron(ssd1306_t *p);
+void ssd1306_contrast(ssd1306_t *p, uint8_t val);
+void ssd1306_invert(ssd1306_t *p, uint8_t inv);
+void ssd1306_rotate(ssd1306_t *p, bool rotate);
+void ssd1306_reset(ssd1306_t *p);
+void ssd1306_show(ssd1306_t *p);
+void ssd1306_clear(ssd1306_t *p);
+void ssd1306_clear_pixel(ssd1306_t *p, uint32_t x, uint32_t y);
+void ssd1306_draw_pixel(ssd1306_t *p, uint32_t x, uint32_t y);
+void ssd1306_draw_square(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+void ssd1306_clear_square(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+void ssd1306_draw_empty_square(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+void ssd1306_draw_char_with_font(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t scale, const uint8_t *font, char c);
+void ssd1306_draw_string_with_font(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t scale, const uint8_t *font, const char *s);
+void ssd1306_draw_string(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t scale, const char *s);
+void ssd1306_bmp_show_image_with_offset(ssd1306_t *p, const uint8_t *data, const long size, uint32_t x_offset, uint32_t y_offset);
+void ssd1306_bmp_show_image(ssd1306_t *p, const uint8_t *data, const long size);
+
+// Host test controls
+uint32_t fake_ssd1306_get_shows(void);
+uint8_t fake_ssd1306_get_contrast(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef HOST_TUSB_H
+#define HOST_TUSB_H
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Host version of the TinyUSB Midi device class. Written packets go through a
+// TX FIFO as small as the device one, emptied into a log by tud_task().
+#define BOARD_TUD_RHPORT        0
+#define FAKE_USB_FIFO_PACKETS   16 // 64 bytes
+
+bool tud_init(uint8_t rhport);
+void tud_task(void);
+bool tud_mounted(void);
+bool tud_midi_mounted(void);
+bool tud_midi_packet_write(const uint8_t packet[4]);
+bool tud_midi_packet_read(uint8_t packet[4]);
+uint32_t tud_midi_available(void);
+
+void tud_mount_cb(void) __attribute__((weak));
+
+// Host test controls
+void fake_usb_set_mounted(bool mounted);
+bool fake_usb_receive(const uint8_t packet[4]);
+size_t fake_usb_take_sent(uint8_t (*packets)[4], size_t max);
+void fake_usb_set_host_stalled(bool stalled); // The host stops reading, the TX FIFO fills up
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
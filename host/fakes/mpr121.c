@@ -0,0 +1,34 @@
+/* Host version of the MPR121 capacitive touch sensor library */
+
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+#include "shim.h"
+#include "mpr121.h"
+
+static struct mpr121_sensor *sensor_instance;
+
+void mpr121_init(i2c_inst_t *i2c_port, uint8_t i2c_addr, struct mpr121_sensor *sensor) {
+    sensor->i2c_port = i2c_port;
+    sensor->i2c_addr = i2c_addr;
+    sensor_instance = sensor;
+}
+
+void mpr121_set_thresholds(uint8_t touch, uint8_t release, struct mpr121_sensor *sensor) {}
+
+void mpr121_enable_electrodes(uint8_t nelec, struct mpr121_sensor *sensor) {}
+
+// Like the library, read both touch status registers for each electrode
+void mpr121_is_touched(uint8_t electrode, bool *is_touched, struct mpr121_sensor *sensor) {
+    uint8_t reg = MPR121_TOUCH_STATUS_REG;
+    uint8_t status[2];
+    i2c_write_blocking(sensor->i2c_port, sensor->i2c_addr, &reg, 1, true);
+    i2c_read_blocking(sensor->i2c_port, sensor->i2c_addr, status, 2, false);
+    uint16_t touched = status[0] | (status[1] << 8);
+    *is_touched = (touched >> electrode) & 1;
+}
+
+void fake_mpr121_set_touched(uint16_t touched) {
+    uint8_t status[2] = { touched & 0xFF, (touched >> 8) & 0x0F };
+    shim_i2c_set_registers(sensor_instance->i2c_port, sensor_instance->i2c_addr,
+                           MPR121_TOUCH_STATUS_REG, status, 2);
+}
@@ -0,0 +1,31 @@
+/* Host version of the MPU6050 accelerometer library */
+
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+#include "shim.h"
+#include "MPU6050.h"
+
+mpu6050_t mpu6050_init(i2c_inst_t *i2c_instance, uint8_t address) {
+    mpu6050_t self = { { i2c_instance, address }, { 0, 0, 0 } };
+    return self;
+}
+
+bool mpu6050_begin(mpu6050_t *self) {
+    uint8_t wake[2] = { 0x6B, 0x00 }; // PWR_MGMT_1, out of sleep
+    return i2c_write_blocking(self->i2c.instance, self->i2c.address, wake, 2, false) == 2;
+}
+
+void mpu6050_set_range(mpu6050_t *self, mpu6050_range_t range) {}
+void mpu6050_set_dhpf_mode(mpu6050_t *self, mpu6050_dhpf_t mode) {}
+void mpu6050_set_dlpf_mode(mpu6050_t *self, mpu6050_dlpf_t mode) {}
+void mpu6050_set_accelerometer_measuring(mpu6050_t *self, bool enabled) {}
+
+// The registers hold each axis big-endian, like the sensor
+void fake_mpu6050_set_accel(i2c_inst_t *i2c_instance, uint8_t address, int16_t x, int16_t y, int16_t z) {
+    uint8_t data[6] = {
+        (uint8_t)(x >> 8), (uint8_t)x,
+        (uint8_t)(y >> 8), (uint8_t)y,
+        (uint8_t)(z >> 8), (uint8_t)z,
+    };
+    shim_i2c_set_registers(i2c_instance, address, MPU6050_ACCEL_XOUT_H, data, 6);
+}
@@ -0,0 +1,176 @@
+/* Host stand-in for the PRA32-U synth engine */
+
+#include <math.h>
+#include <string.h>
+#include "shim.h"
+#include "pra32-u-synth.h"
+
+#define SAMPLE_RATE     48000.0f
+#define FULL_SCALE      8000.0f // Per voice, so that four voices do not clip
+
+void PRA32_U_Synth::initialize() {
+    memset(held, 0, sizeof(held));
+    memset(voices, 0, sizeof(voices));
+    samples = 0;
+    voice_age = 0;
+    program_change(0);
+}
+
+void PRA32_U_Synth::report(fake_synth_call_t call, uint8_t data1, uint8_t data2) {
+    bool from_core1 = shim_on_core1();
+    if (!from_core1) { calls_from_core0++; }
+    if (hook == NULL) { return; }
+    fake_synth_event_t event = { call, data1, data2, samples, from_core1 };
+    hook(&event);
+}
+
+void PRA32_U_Synth::note_on(uint8_t note_number, uint8_t velocity) {
+    report(FAKE_SYNTH_NOTE_ON, note_number, velocity);
+    held[note_number & 0x7F] = true;
+
+    // A note already sounding is retriggered, otherwise the oldest voice is taken
+    uint8_t count = (controllers[VOICE_MODE] >= 2 ? 1 : FAKE_SYNTH_VOICES);
+    voice_t *voice = &voices[0];
+    for (uint8_t i = 0; i < count; i++) {
+        if (voices[i].note == note_number && voices[i].level > 0.0f) {
+            voice = &voices[i];
+            break;
+        }
+        if (voices[i].age < voice->age) { voice = &voices[i]; }
+    }
+    voice->note = note_number;
+    voice->velocity = velocity;
+    voice->gate = true;
+    voice->decaying = false;
+    voice->age = ++voice_age;
+}
+
+void PRA32_U_Synth::note_off(uint8_t note_number) {
+    report(FAKE_SYNTH_NOTE_OFF, note_number, 0);
+    held[note_number & 0x7F] = false;
+    for (uint8_t i = 0; i < FAKE_SYNTH_VOICES; i++) {
+        if (voices[i].note == note_number) { voices[i].gate = false; }
+    }
+}
+
+void PRA32_U_Synth::all_notes_off() {
+    report(FAKE_SYNTH_ALL_NOTES_OFF, 0, 0);
+    memset(held, 0, sizeof(held));
+    for (uint8_t i = 0; i < FAKE_SYNTH_VOICES; i++) {
+        voices[i].gate = false;
+    }
+}
+
+void PRA32_U_Synth::all_sound_off() {
+    all_notes_off();
+    for (uint8_t i = 0; i < FAKE_SYNTH_VOICES; i++) {
+        voices[i].level = 0.0f;
+    }
+}
+
+void PRA32_U_Synth::reset_all_controllers() {
+    bend = 0x2000;
+}
+
+void PRA32_U_Synth::control_change(uint8_t control_number, uint8_t value) {
+    report(FAKE_SYNTH_CONTROL_CHANGE, control_number, value);
+    controllers[control_number & 0x7F] = value & 0x7F;
+}
+
+// The programs are made up, but distinct and stable
+void PRA32_U_Synth::program_change(uint8_t program_number) {
+    report(FAKE_SYNTH_PROGRAM_CHANGE, program_number, 0);
+    for (uint8_t i = 0; i < 128; i++) {
+        controllers[i] = (uint8_t)((program_number * 37 + i * 11) & 0x7F);
+    }
+    controllers[VOICE_MODE] = 0;
+    controllers[P_BEND_RANGE] = 2;
+    controllers[AMP_GAIN] = 80 + program_number * 4;
+    controllers[AMP_SUSTAIN] = 96;
+    controllers[REL_EQ_DECAY] = 0;
+    bend = 0x2000;
+}
+
+void PRA32_U_Synth::pitch_bend(uint8_t lsb, uint8_t msb) {
+    report(FAKE_SYNTH_PITCH_BEND, lsb, msb);
+    bend = (uint16_t)((msb & 0x7F) << 7 | (lsb & 0x7F));
+}
+
+uint8_t PRA32_U_Synth::current_controller_value(uint8_t control_number) {
+    return controllers[control_number & 0x7F];
+}
+
+// Envelope times grow exponentially with the parameter, from about 1 ms to 2 s
+static inline float get_envelope_rate(uint8_t value) {
+    float seconds = 0.001f * powf(2.0f, value / 11.6f);
+    return 1.0f / (seconds * SAMPLE_RATE);
+}
+
+float PRA32_U_Synth::render_voice(voice_t *voice) {
+    if (voice->gate) {
+        if (!voice->decaying) {
+            voice->level += get_envelope_rate(controllers[AMP_ATTACK]);
+            if (voice->level >= 1.0f) {
+                voice->level = 1.0f;
+                voice->decaying = true;
+            }
+        } else {
+            float sustain = controllers[AMP_SUSTAIN] / 127.0f;
+            voice->level += (sustain - voice->level) * get_envelope_rate(controllers[AMP_DECAY]);
+        }
+    } else if (voice->level > 0.0f) {
+        uint8_t release = controllers[REL_EQ_DECAY] ? controllers[AMP_DECAY] : controllers[AMP_RELEASE];
+        voice->level -= voice->level * get_envelope_rate(release) + 1e-6f;
+        if (voice->level < 0.0f) { voice->level = 0.0f; }
+    }
+    if (voice->level <= 0.0f) { return 0.0f; }
+
+    float semitones = voice->note - 69 + (bend - 0x2000) / 8192.0f * controllers[P_BEND_RANGE];
+    voice->phase += 440.0f * powf(2.0f, semitones / 12.0f) / SAMPLE_RATE;
+    voice->phase -= floorf(voice->phase);
+    float wave = (controllers[OSC_1_WAVE] & 1) ? (voice->phase < 0.5f ? 1.0f : -1.0f)
+                                               : 2.0f * voice->phase - 1.0f;
+
+    float cutoff_hz = 50.0f * powf(2.0f, controllers[FILTER_CUTOFF] * 8.6f / 127.0f);
+    voice->filter += (wave - voice->filter) * (1.0f - expf(-6.2832f * cutoff_hz / SAMPLE_RATE));
+    return voice->filter * voice->level * voice->velocity / 127.0f;
+}
+
+int16_t PRA32_U_Synth::process(int16_t right_input, int16_t& right_level) {
+    float sum = 0.0f;
+    for (uint8_t i = 0; i < FAKE_SYNTH_VOICES; i++) {
+        sum += render_voice(&voices[i]);
+    }
+    float output = sum * FULL_SCALE * controllers[AMP_GAIN] / 127.0f;
+    if (output > 32767.0f) { output = 32767.0f; }
+    if (output < -32768.0f) { output = -32768.0f; }
+    samples++;
+    right_level = (int16_t)output;
+    return (int16_t)output;
+}
+
+void PRA32_U_Synth::secondary_core_process() {}
+
+void PRA32_U_Synth::fake_set_hook(void (*event_hook)(const fake_synth_event_t *event)) {
+    hook = event_hook;
+}
+
+bool PRA32_U_Synth::fake_is_note_held(uint8_t note_number) {
+    return held[note_number & 0x7F];
+}
+
+uint8_t PRA32_U_Synth::fake_get_held_notes() {
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < 128; i++) {
+        if (held[i]) { count++; }
+    }
+    return count;
+}
+
+uint64_t PRA32_U_Synth::fake_get_samples() {
+    return samples;
+}
+
+uint32_t PRA32_U_Synth::fake_get_calls_from_core0() {
+    return calls_from_core0;
+}
@@ -0,0 +1,144 @@
+/* Host version of the SSD1306 display library */
+
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+#include "ssd1306.h"
+
+#define CHAR_WIDTH  6
+#define CHAR_HEIGHT 8
+
+static uint32_t shows;
+static uint8_t contrast;
+
+static void write_command(ssd1306_t *p, uint8_t command) {
+    uint8_t data[2] = { 0x00, command };
+    i2c_write_blocking(p->i2c_i, p->address, data, 2, false);
+}
+
+bool ssd1306_init(ssd1306_t *p, uint16_t width, uint16_t height, uint8_t address, i2c_inst_t *i2c_instance) {
+    p->width = width;
+    p->height = height;
+    p->pages = height / 8;
+    p->address = address;
+    p->i2c_i = i2c_instance;
+    p->bufsize = p->pages * p->width;
+    p->buffer = calloc(p->bufsize + 1, 1); // The first byte is the data control byte
+    if (p->buffer == NULL) { return false; }
+    p->buffer++;
+    write_command(p, 0xAF); // Display on
+    return true;
+}
+
+void ssd1306_deinit(ssd1306_t *p) {
+    free(p->buffer - 1);
+}
+
+void ssd1306_poweroff(ssd1306_t *p) {
+    write_command(p, 0xAE);
+}
+
+void ssd1306_poweron(ssd1306_t *p) {
+    write_command(p, 0xAF);
+}
+
+void ssd1306_contrast(ssd1306_t *p, uint8_t val) {
+    write_command(p, 0x81);
+    write_command(p, val);
+    contrast = val;
+}
+
+void ssd1306_invert(ssd1306_t *p, uint8_t inv) {
+    write_command(p, 0xA6 | (inv & 1));
+}
+
+void ssd1306_rotate(ssd1306_t *p, bool rotate) {
+    write_command(p, rotate ? 0xC0 : 0xC8);
+}
+
+void ssd1306_reset(ssd1306_t *p) {
+    write_command(p, 0xAF);
+}
+
+// The whole frame buffer goes out at once, like in the library
+void ssd1306_show(ssd1306_t *p) {
+    p->buffer[-1] = 0x40;
+    i2c_write_blocking(p->i2c_i, p->address, p->buffer - 1, p->bufsize + 1, false);
+    shows++;
+}
+
+void ssd1306_clear(ssd1306_t *p) {
+    memset(p->buffer, 0, p->bufsize);
+}
+
+void ssd1306_clear_pixel(ssd1306_t *p, uint32_t x, uint32_t y) {
+    if (x >= p->width || y >= p->height) { return; }
+    p->buffer[x + p->width * (y >> 3)] &= ~(1 << (y & 0x07));
+}
+
+void ssd1306_draw_pixel(ssd1306_t *p, uint32_t x, uint32_t y) {
+    if (x >= p->width || y >= p->height) { return; }
+    p->buffer[x + p->width * (y >> 3)] |= 1 << (y & 0x07);
+}
+
+void ssd1306_draw_square(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+    for (uint32_t i = 0; i < width; i++) {
+        for (uint32_t j = 0; j < height; j++) {
+            ssd1306_draw_pixel(p, x + i, y + j);
+        }
+    }
+}
+
+void ssd1306_clear_square(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+    for (uint32_t i = 0; i < width; i++) {
+        for (uint32_t j = 0; j < height; j++) {
+            ssd1306_clear_pixel(p, x + i, y + j);
+        }
+    }
+}
+
+void ssd1306_draw_empty_square(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+    for (uint32_t i = 0; i <= width; i++) {
+        ssd1306_draw_pixel(p, x + i, y);
+        ssd1306_draw_pixel(p, x + i, y + height);
+    }
+    for (uint32_t j = 0; j <= height; j++) {
+        ssd1306_draw_pixel(p, x, y + j);
+        ssd1306_draw_pixel(p, x + width, y + j);
+    }
+}
+
+void ssd1306_draw_char_with_font(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t scale, const uint8_t *font, char c) {
+    if (c == ' ') { return; }
+    ssd1306_draw_square(p, x, y, (CHAR_WIDTH - 1) * scale, (CHAR_HEIGHT - 1) * scale);
+}
+
+void ssd1306_draw_string_with_font(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t scale, const uint8_t *font, const char *s) {
+    for (uint32_t x_n = x; *s; x_n += CHAR_WIDTH * scale) {
+        ssd1306_draw_char_with_font(p, x_n, y, scale, font, *(s++));
+    }
+}
+
+void ssd1306_draw_string(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t scale, const char *s) {
+    ssd1306_draw_string_with_font(p, x, y, scale, NULL, s);
+}
+
+void ssd1306_bmp_show_image_with_offset(ssd1306_t *p, const uint8_t *data, const long size, uint32_t x_offset, uint32_t y_offset) {
+    if (size < 54) { return; } // Not even a bitmap header
+    uint32_t width = data[18] | data[19] << 8;
+    uint32_t height = data[22] | data[23] << 8;
+    ssd1306_draw_empty_square(p, x_offset, y_offset, width - 1, height - 1);
+}
+
+void ssd1306_bmp_show_image(ssd1306_t *p, const uint8_t *data, const long size) {
+    ssd1306_bmp_show_image_with_offset(p, data, size, 0, 0);
+}
+
+uint32_t fake_ssd1306_get_shows(void) {
+    return shows;
+}
+
+uint8_t fake_ssd1306_get_contrast(void) {
+    return contrast;
+}
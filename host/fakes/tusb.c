@@ -0,0 +1,85 @@
+/* Host version of the TinyUSB Midi device */
+
+#include <string.h>
+#include "pico/stdlib.h"
+#include "bsp/board_api.h"
+#include "tusb.h"
+
+#define RX_PACKETS      256
+#define SENT_PACKETS    16384
+
+static bool mounted = true;
+static bool mount_reported;
+static bool host_stalled;
+static uint8_t tx_fifo[FAKE_USB_FIFO_PACKETS][4];
+static uint8_t tx_length;
+static uint8_t rx_packets[RX_PACKETS][4];
+static uint16_t rx_head, rx_tail;
+static uint8_t sent[SENT_PACKETS][4];
+static size_t sent_length;
+
+void board_init(void) {}
+
+bool tud_init(uint8_t rhport) {
+    return true;
+}
+
+// The host reads the whole TX FIFO on each frame
+void tud_task(void) {
+    if (mounted && !mount_reported) {
+        mount_reported = true;
+        if (tud_mount_cb) { tud_mount_cb(); }
+    }
+    if (host_stalled) { return; }
+    for (uint8_t i = 0; i < tx_length && sent_length < SENT_PACKETS; i++) {
+        memcpy(sent[sent_length++], tx_fifo[i], 4);
+    }
+    tx_length = 0;
+}
+
+bool tud_mounted(void) {
+    return mounted;
+}
+
+bool tud_midi_mounted(void) {
+    return mounted;
+}
+
+bool tud_midi_packet_write(const uint8_t packet[4]) {
+    if (!mounted || tx_length >= FAKE_USB_FIFO_PACKETS) { return false; }
+    memcpy(tx_fifo[tx_length++], packet, 4);
+    return true;
+}
+
+bool tud_midi_packet_read(uint8_t packet[4]) {
+    if (rx_tail == rx_head) { return false; }
+    memcpy(packet, rx_packets[rx_tail++ % RX_PACKETS], 4);
+    return true;
+}
+
+uint32_t tud_midi_available(void) {
+    return (uint16_t)(rx_head - rx_tail) * 4;
+}
+
+void fake_usb_set_mounted(bool is_mounted) {
+    mounted = is_mounted;
+    if (!mounted) { mount_reported = false; }
+}
+
+bool fake_usb_receive(const uint8_t packet[4]) {
+    if ((uint16_t)(rx_head - rx_tail) >= RX_PACKETS) { return false; }
+    memcpy(rx_packets[rx_head++ % RX_PACKETS], packet, 4);
+    return true;
+}
+
+size_t fake_usb_take_sent(uint8_t (*packets)[4], size_t max) {
+    size_t length = (sent_length < max ? sent_length : max);
+    memcpy(packets, sent, length * 4);
+    memmove(sent, sent[length], (sent_length - length) * 4);
+    sent_length -= length;
+    return length;
+}
+
+void fake_usb_set_host_stalled(bool stalled) {
+    host_stalled = stalled;
+}
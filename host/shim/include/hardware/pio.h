@@ -0,0 +1,69 @@
+#ifndef HOST_HARDWARE_PIO_H
+#define HOST_HARDWARE_PIO_H
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// State machines do not run: the shim only keeps their clock divider, so that
+// DMA transfers paced by their FIFO take as long as on the device
+#define NUM_PIO_STATE_MACHINES  4
+
+typedef struct pio_hw {
+    volatile uint32_t txf[NUM_PIO_STATE_MACHINES];
+    uint8_t index;
+    uint8_t claimed;
+    float clkdiv[NUM_PIO_STATE_MACHINES];
+    uint8_t cycles_per_word[NUM_PIO_STATE_MACHINES];
+} pio_hw_t;
+
+typedef pio_hw_t *PIO;
+extern pio_hw_t pio0_hw, pio1_hw;
+#define pio0 (&pio0_hw)
+#define pio1 (&pio1_hw)
+
+typedef struct pio_program {
+    const uint16_t *instructions;
+    uint8_t length;
+    int8_t origin;
+} pio_program_t;
+
+typedef struct {
+    float clkdiv;
+    uint8_t out_shift_count;
+} pio_sm_config;
+
+enum pio_fifo_join {
+    PIO_FIFO_JOIN_NONE = 0,
+    PIO_FIFO_JOIN_TX = 1,
+    PIO_FIFO_JOIN_RX = 2,
+};
+
+static inline pio_sm_config pio_get_default_sm_config(void) {
+    pio_sm_config c = { 1.0f, 32 };
+    return c;
+}
+
+uint pio_add_program(PIO pio, const pio_program_t *program);
+uint pio_claim_unused_sm(PIO pio, bool required);
+uint pio_get_dreq(PIO pio, uint sm, bool is_tx);
+void pio_gpio_init(PIO pio, uint pin);
+void pio_sm_set_pins_with_mask(PIO pio, uint sm, uint32_t pin_values, uint32_t pin_mask);
+void pio_sm_set_pindirs_with_mask(PIO pio, uint sm, uint32_t pin_dirs, uint32_t pin_mask);
+void pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config);
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled);
+
+static inline void sm_config_set_out_shift(pio_sm_config *c, bool shift_right, bool autopull, uint pull_threshold) {}
+static inline void sm_config_set_out_pins(pio_sm_config *c, uint out_base, uint out_count) {}
+static inline void sm_config_set_sideset_pins(pio_sm_config *c, uint sideset_base) {}
+static inline void sm_config_set_sideset(pio_sm_config *c, uint bit_count, bool optional, bool pindirs) {}
+static inline void sm_config_set_wrap(pio_sm_config *c, uint wrap_target, uint wrap) {}
+static inline void sm_config_set_fifo_join(pio_sm_config *c, enum pio_fifo_join join) {}
+static inline void sm_config_set_clkdiv(pio_sm_config *c, float div) { c->clkdiv = div; }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef HOST_PICO_BINARY_INFO_H
+#define HOST_PICO_BINARY_INFO_H
+
+// Binary information only exists in the device image
+#define bi_decl(_decl)
+#define bi_program_name(name)
+#define bi_program_description(description)
+#define bi_program_version_string(version)
+#define bi_program_url(url)
+#define bi_1pin_with_name(pin, name)
+#define bi_3pins_with_names(pin0, name0, pin1, name1, pin2, name2)
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef HOST_PICO_MULTICORE_H
+#define HOST_PICO_MULTICORE_H
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Core1 runs as a coroutine of core0, resumed by the simulated clock
+// whenever an audio buffer is due
+void multicore_launch_core1(void (*entry)(void));
+void multicore_reset_core1(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
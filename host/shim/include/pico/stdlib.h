@@ -0,0 +1,57 @@
+#ifndef HOST_PICO_STDLIB_H
+#define HOST_PICO_STDLIB_H
+
+// Host stand-in for the Pico SDK standard library: the declarations the firmware
+// uses, implemented on a simulated clock by shim.c
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "hardware/gpio.h"
+#include "hardware/sync.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef unsigned int uint;
+typedef int32_t alarm_id_t;
+typedef int64_t (*alarm_callback_t)(alarm_id_t id, void *user_data);
+typedef uint64_t absolute_time_t;
+
+#define __not_in_flash_func(func_name)      func_name
+#define __time_critical_func(func_name)     func_name
+#define __mem_fence_acquire()               __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define __mem_fence_release()               __atomic_thread_fence(__ATOMIC_RELEASE)
+
+#define PICO_DEFAULT_LED_PIN    25
+#define PICO_ERROR_TIMEOUT      (-1)
+#define PICO_FLASH_SIZE_BYTES   (2 * 1024 * 1024)
+
+// Flash is a RAM array, read in place like through XIP
+extern uint8_t shim_flash[PICO_FLASH_SIZE_BYTES];
+#define XIP_BASE                ((uintptr_t)shim_flash)
+
+uint32_t time_us_32(void);
+uint64_t time_us_64(void);
+void sleep_us(uint64_t us);
+void sleep_ms(uint32_t ms);
+void busy_wait_us(uint64_t us);
+void busy_wait_ms(uint32_t ms);
+absolute_time_t make_timeout_time_us(uint64_t us);
+bool best_effort_wfe_or_timeout(absolute_time_t timeout_timestamp);
+
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t callback, void *user_data, bool fire_if_past);
+alarm_id_t add_alarm_in_ms(uint32_t ms, alarm_callback_t callback, void *user_data, bool fire_if_past);
+bool cancel_alarm(alarm_id_t alarm_id);
+
+bool stdio_init_all(void);
+int getchar_timeout_us(uint32_t timeout_us);
+bool set_sys_clock_khz(uint32_t freq_khz, bool required);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
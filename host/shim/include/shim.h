@@ -0,0 +1,54 @@
+#ifndef HOST_SHIM_H
+#define HOST_SHIM_H
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Test controls of the host shim. Time only moves when the firmware waits
+// (sleeps, busy waits, scheduler idle) or when a test advances it: alarms
+// fire and audio buffers are rendered by core1 at their exact simulated time,
+// so every run of the same test produces the same events.
+
+// Clock
+void shim_advance_us(uint64_t us);
+void shim_advance_to_us(uint64_t time_us);
+
+// Running the whole firmware: the entry point runs until shim_stop() is called,
+// usually from the idle hook, which is called each time core0 goes idle
+typedef void (*shim_idle_hook_t)(uint64_t now_us);
+void shim_set_idle_hook(shim_idle_hook_t hook);
+void shim_run(int (*entry)(void));
+void shim_stop(void);
+
+// Core1 and audio. The hook gets every buffer as it starts playing.
+typedef void (*shim_audio_hook_t)(const int16_t *samples, uint frames);
+bool shim_on_core1(void);
+void shim_set_audio_hook(shim_audio_hook_t hook);
+uint32_t shim_audio_buffers_played(void);
+
+// I2C devices
+void shim_i2c_set_registers(i2c_inst_t *i2c, uint8_t addr, uint8_t reg, const uint8_t *data, size_t len);
+void shim_i2c_get_registers(i2c_inst_t *i2c, uint8_t addr, uint8_t reg, uint8_t *data, size_t len);
+uint32_t shim_i2c_get_bytes(i2c_inst_t *i2c); // Bytes transferred on the bus, both ways
+
+// Flash
+uint32_t shim_flash_get_erases(void);
+uint32_t shim_flash_get_program_errors(void); // Bits that programming could not set, for lack of an erase
+
+// Serial console input, for getchar_timeout_us()
+void shim_stdin_push(const char *text);
+
+// Bytes sent by DMA transfers, in order, removed from the log
+size_t shim_dma_take_output(uint8_t *data, size_t max);
+
+// Interrupts disabled by save_and_disable_interrupts(), for checking that they are restored
+uint32_t shim_get_interrupts_disabled(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
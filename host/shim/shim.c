@@ -0,0 +1,578 @@
+/* Host implementation of the Pico SDK functions used by the firmware */
+
+#define _XOPEN_SOURCE 700 // For ucontext
+#include <assert.h>
+#include <setjmp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "hardware/clocks.h"
+#include "hardware/adc.h"
+#include "hardware/dma.h"
+#include "hardware/flash.h"
+#include "hardware/i2c.h"
+#include "hardware/pio.h"
+#include "hardware/structs/systick.h"
+#include "sound_i2s.h"
+#include "shim.h"
+
+/* Simulated clock and alarms */
+
+#define ALARMS_MAX  16
+
+typedef struct {
+    alarm_id_t id;              // 0 when the slot is free
+    uint64_t time_us;
+    alarm_callback_t callback;
+    void *user_data;
+} shim_alarm_t;
+
+static uint64_t now_us;
+static shim_alarm_t alarms[ALARMS_MAX];
+static alarm_id_t next_alarm_id = 1;
+
+static void audio_tick(void);
+static uint64_t next_audio_us(void);
+
+static shim_alarm_t* next_alarm(void) {
+    shim_alarm_t *next = NULL;
+    for (int i = 0; i < ALARMS_MAX; i++) {
+        if (alarms[i].id == 0) { continue; }
+        if (next == NULL || alarms[i].time_us < next->time_us) { next = &alarms[i]; }
+    }
+    return next;
+}
+
+static void fire_alarm(shim_alarm_t *alarm) {
+    shim_alarm_t fired = *alarm;
+    alarm->id = 0;
+    int64_t reschedule = fired.callback(fired.id, fired.user_data);
+    if (reschedule == 0) { return; }
+    // Negative values count from the previous target time, positive ones from now
+    uint64_t time_us = (reschedule < 0 ? fired.time_us - reschedule : now_us + reschedule);
+    for (int i = 0; i < ALARMS_MAX; i++) {
+        if (alarms[i].id != 0) { continue; }
+        alarms[i] = fired;
+        alarms[i].time_us = time_us;
+        return;
+    }
+}
+
+// Move the clock forward, handling the alarms and audio buffers due on the way in order
+void shim_advance_to_us(uint64_t time_us) {
+    while (true) {
+        shim_alarm_t *alarm = next_alarm();
+        uint64_t audio_us = next_audio_us();
+        uint64_t alarm_us = (alarm != NULL ? alarm->time_us : UINT64_MAX);
+        uint64_t event_us = (alarm_us < audio_us ? alarm_us : audio_us);
+        if (event_us > time_us) { break; }
+        if (event_us > now_us) { now_us = event_us; }
+        if (alarm_us <= audio_us) {
+            fire_alarm(alarm);
+        } else {
+            audio_tick();
+        }
+    }
+    if (time_us > now_us) { now_us = time_us; }
+}
+
+void shim_advance_us(uint64_t us) {
+    shim_advance_to_us(now_us + us);
+}
+
+uint32_t time_us_32(void) {
+    return (uint32_t)now_us;
+}
+
+uint64_t time_us_64(void) {
+    return now_us;
+}
+
+void sleep_us(uint64_t us) {
+    shim_advance_us(us);
+}
+
+void sleep_ms(uint32_t ms) {
+    shim_advance_us((uint64_t)ms * 1000);
+}
+
+void busy_wait_us(uint64_t us) {
+    shim_advance_us(us);
+}
+
+void busy_wait_ms(uint32_t ms) {
+    shim_advance_us((uint64_t)ms * 1000);
+}
+
+absolute_time_t make_timeout_time_us(uint64_t us) {
+    return now_us + us;
+}
+
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t callback, void *user_data, bool fire_if_past) {
+    for (int i = 0; i < ALARMS_MAX; i++) {
+        if (alarms[i].id != 0) { continue; }
+        alarms[i].id = next_alarm_id++;
+        alarms[i].time_us = now_us + us;
+        alarms[i].callback = callback;
+        alarms[i].user_data = user_data;
+        return alarms[i].id;
+    }
+    return -1; // No alarm slots available
+}
+
+alarm_id_t add_alarm_in_ms(uint32_t ms, alarm_callback_t callback, void *user_data, bool fire_if_past) {
+    return add_alarm_in_us((uint64_t)ms * 1000, callback, user_data, fire_if_past);
+}
+
+bool cancel_alarm(alarm_id_t alarm_id) {
+    for (int i = 0; i < ALARMS_MAX; i++) {
+        if (alarms[i].id == alarm_id) {
+            alarms[i].id = 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Firmware runs */
+
+static shim_idle_hook_t idle_hook;
+static jmp_buf stop_jump;
+
+void shim_set_idle_hook(shim_idle_hook_t hook) {
+    idle_hook = hook;
+}
+
+// The core sleeps until the timeout: the clock jumps there, then the test gets control
+bool best_effort_wfe_or_timeout(absolute_time_t timeout_timestamp) {
+    shim_advance_to_us(timeout_timestamp);
+    if (idle_hook != NULL) { idle_hook(now_us); }
+    return true;
+}
+
+void shim_run(int (*entry)(void)) {
+    if (setjmp(stop_jump) == 0) { entry(); }
+}
+
+void shim_stop(void) {
+    assert(!shim_on_core1());
+    longjmp(stop_jump, 1);
+}
+
+/* Core1, as a coroutine of core0 */
+
+#define CORE1_STACK_SIZE    (256 * 1024)
+
+static ucontext_t core0_context;
+static ucontext_t core1_context;
+static void (*core1_entry)(void);
+static bool core1_launched;
+static bool core1_active; // Core1 is the one running
+static uint8_t core1_stack[CORE1_STACK_SIZE];
+
+static void core1_trampoline(void) {
+    core1_entry();
+    core1_launched = false; // Returned, core1 stops
+}
+
+// Let core1 run until it waits for the next audio buffer
+static void resume_core1(void) {
+    if (!core1_launched || core1_active) { return; }
+    core1_active = true;
+    swapcontext(&core0_context, &core1_context);
+    core1_active = false;
+}
+
+static void core1_wait(void) {
+    swapcontext(&core1_context, &core0_context);
+}
+
+bool shim_on_core1(void) {
+    return core1_active;
+}
+
+void multicore_launch_core1(void (*entry)(void)) {
+    assert(!core1_active);
+    core1_entry = entry;
+    getcontext(&core1_context);
+    core1_context.uc_stack.ss_sp = core1_stack;
+    core1_context.uc_stack.ss_size = sizeof(core1_stack);
+    core1_context.uc_link = &core0_context;
+    makecontext(&core1_context, core1_trampoline, 0);
+    core1_launched = true;
+    resume_core1();
+}
+
+// Core1 stops wherever it was waiting, and starts over from its entry when launched again
+void multicore_reset_core1(void) {
+    assert(!core1_active);
+    core1_launched = false;
+}
+
+/* Audio output */
+
+static struct sound_i2s_config audio_config;
+static int16_t *audio_buffers[2];
+static uint64_t audio_start_us;
+static uint32_t audio_played;   // Buffers that have started playing
+static uint32_t audio_fetched;  // Value of audio_played when core1 last got a buffer
+static shim_audio_hook_t audio_hook;
+volatile unsigned int sound_i2s_num_buffers_played;
+
+int sound_i2s_init(const struct sound_i2s_config *cfg) {
+    audio_config = *cfg;
+    for (int i = 0; i < 2; i++) {
+        audio_buffers[i] = calloc(cfg->samples_per_buffer * 2, sizeof(int16_t));
+    }
+    audio_start_us = now_us;
+    audio_played = 0;
+    audio_fetched = UINT32_MAX;
+    return 0;
+}
+
+static uint64_t next_audio_us(void) {
+    if (audio_buffers[0] == NULL) { return UINT64_MAX; }
+    uint64_t samples = (uint64_t)(audio_played + 1) * audio_config.samples_per_buffer;
+    return audio_start_us + samples * 1000000 / audio_config.sample_rate;
+}
+
+// The buffer core1 filled starts playing, and core1 gets the other one to fill
+static void audio_tick(void) {
+    audio_played++;
+    sound_i2s_num_buffers_played = audio_played;
+    if (audio_hook != NULL) {
+        audio_hook(audio_buffers[audio_played & 1], audio_config.samples_per_buffer);
+    }
+    resume_core1();
+}
+
+int16_t *sound_i2s_get_next_buffer(void) {
+    // Core1 has nothing to do until the next buffer starts playing
+    while (core1_active && audio_fetched == audio_played) { core1_wait(); }
+    audio_fetched = audio_played;
+    return audio_buffers[1 - (audio_played & 1)];
+}
+
+int16_t *sound_i2s_get_buffer(int buffer_num) {
+    return audio_buffers[buffer_num];
+}
+
+void shim_set_audio_hook(shim_audio_hook_t hook) {
+    audio_hook = hook;
+}
+
+uint32_t shim_audio_buffers_played(void) {
+    return audio_played;
+}
+
+/* Interrupts and events */
+
+static uint32_t interrupts_disabled;
+
+uint32_t save_and_disable_interrupts(void) {
+    return interrupts_disabled++;
+}
+
+void restore_interrupts(uint32_t status) {
+    interrupts_disabled = status;
+}
+
+uint32_t shim_get_interrupts_disabled(void) {
+    return interrupts_disabled;
+}
+
+void __wfe(void) {}
+void __sev(void) {}
+
+/* Clocks, stdio, GPIO and ADC */
+
+static uint32_t sys_clock_khz = 125000;
+static systick_hw_t systick;
+systick_hw_t *systick_hw = &systick;
+
+bool set_sys_clock_khz(uint32_t freq_khz, bool required) {
+    sys_clock_khz = freq_khz;
+    return true;
+}
+
+uint32_t clock_get_hz(enum clock_index clk_index) {
+    return (clk_index == clk_sys ? sys_clock_khz * 1000 : 12000000);
+}
+
+#define STDIN_BUFFER_SIZE   256
+
+static char stdin_buffer[STDIN_BUFFER_SIZE];
+static size_t stdin_head, stdin_tail;
+
+bool stdio_init_all(void) {
+    return true;
+}
+
+void shim_stdin_push(const char *text) {
+    for (; *text; text++) {
+        stdin_buffer[stdin_head++ % STDIN_BUFFER_SIZE] = *text;
+    }
+}
+
+int getchar_timeout_us(uint32_t timeout_us) {
+    if (stdin_tail == stdin_head) { return PICO_ERROR_TIMEOUT; }
+    return stdin_buffer[stdin_tail++ % STDIN_BUFFER_SIZE];
+}
+
+#define NUM_GPIOS   48
+
+static bool gpio_levels[NUM_GPIOS];
+static bool gpio_outputs[NUM_GPIOS];
+
+void gpio_init(unsigned int gpio) {
+    gpio_levels[gpio] = false;
+    gpio_outputs[gpio] = false;
+}
+
+void gpio_set_dir(unsigned int gpio, bool out) {
+    gpio_outputs[gpio] = out;
+}
+
+void gpio_put(unsigned int gpio, bool value) {
+    gpio_levels[gpio] = value;
+}
+
+bool gpio_get(unsigned int gpio) {
+    return gpio_levels[gpio];
+}
+
+void gpio_set_function(unsigned int gpio, enum gpio_function fn) {}
+
+void gpio_pull_up(unsigned int gpio) {
+    if (!gpio_outputs[gpio]) { gpio_levels[gpio] = true; }
+}
+
+void adc_init(void) {}
+void adc_gpio_init(uint gpio) {}
+void adc_select_input(uint input) {}
+
+uint16_t adc_read(void) {
+    return 0x0FFF; // Full scale, the battery is never low
+}
+
+/* I2C */
+
+#define I2C_DEVICES     128
+#define I2C_REGISTERS   256
+
+typedef struct {
+    uint8_t registers[I2C_REGISTERS];
+    uint8_t pointer;
+} i2c_device_t;
+
+i2c_inst_t i2c0_inst = { 0, 0 };
+i2c_inst_t i2c1_inst = { 1, 0 };
+static i2c_device_t i2c_devices[2][I2C_DEVICES];
+static uint32_t i2c_bytes[2];
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate) {
+    i2c->baudrate = baudrate;
+    return baudrate;
+}
+
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop) {
+    i2c_device_t *device = &i2c_devices[i2c->index][addr & 0x7F];
+    i2c_bytes[i2c->index] += len;
+    if (len == 0) { return 0; }
+    device->pointer = src[0];
+    for (size_t i = 1; i < len; i++) {
+        device->registers[device->pointer++] = src[i];
+    }
+    return (int)len;
+}
+
+int i2c_read_blocking(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop) {
+    i2c_device_t *device = &i2c_devices[i2c->index][addr & 0x7F];
+    i2c_bytes[i2c->index] += len;
+    for (size_t i = 0; i < len; i++) {
+        dst[i] = device->registers[device->pointer++];
+    }
+    return (int)len;
+}
+
+int i2c_write_timeout_us(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop, uint timeout_us) {
+    return i2c_write_blocking(i2c, addr, src, len, nostop);
+}
+
+int i2c_read_timeout_us(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop, uint timeout_us) {
+    return i2c_read_blocking(i2c, addr, dst, len, nostop);
+}
+
+void shim_i2c_set_registers(i2c_inst_t *i2c, uint8_t addr, uint8_t reg, const uint8_t *data, size_t len) {
+    i2c_device_t *device = &i2c_devices[i2c->index][addr & 0x7F];
+    for (size_t i = 0; i < len; i++) {
+        device->registers[(uint8_t)(reg + i)] = data[i];
+    }
+}
+
+void shim_i2c_get_registers(i2c_inst_t *i2c, uint8_t addr, uint8_t reg, uint8_t *data, size_t len) {
+    i2c_device_t *device = &i2c_devices[i2c->index][addr & 0x7F];
+    for (size_t i = 0; i < len; i++) {
+        data[i] = device->registers[(uint8_t)(reg + i)];
+    }
+}
+
+uint32_t shim_i2c_get_bytes(i2c_inst_t *i2c) {
+    return i2c_bytes[i2c->index];
+}
+
+/* Flash */
+
+uint8_t shim_flash[PICO_FLASH_SIZE_BYTES];
+static uint32_t flash_erases;
+static uint32_t flash_program_errors;
+
+__attribute__((constructor)) static void flash_init(void) {
+    memset(shim_flash, 0xFF, sizeof(shim_flash)); // Erased
+}
+
+void flash_range_erase(uint32_t flash_offs, size_t count) {
+    assert(flash_offs % FLASH_SECTOR_SIZE == 0 && count % FLASH_SECTOR_SIZE == 0);
+    assert(flash_offs + count <= PICO_FLASH_SIZE_BYTES);
+    assert(interrupts_disabled > 0 || core1_launched == false); // Nothing may run from flash meanwhile
+    memset(&shim_flash[flash_offs], 0xFF, count);
+    flash_erases++;
+}
+
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count) {
+    assert(flash_offs % FLASH_PAGE_SIZE == 0 && count % FLASH_PAGE_SIZE == 0);
+    assert(flash_offs + count <= PICO_FLASH_SIZE_BYTES);
+    for (size_t i = 0; i < count; i++) {
+        uint8_t programmed = shim_flash[flash_offs + i] & data[i];
+        if (programmed != data[i]) { flash_program_errors++; }
+        shim_flash[flash_offs + i] = programmed;
+    }
+}
+
+uint32_t shim_flash_get_erases(void) {
+    return flash_erases;
+}
+
+uint32_t shim_flash_get_program_errors(void) {
+    return flash_program_errors;
+}
+
+/* PIO and DMA */
+
+pio_hw_t pio0_hw = { .index = 0 };
+pio_hw_t pio1_hw = { .index = 1 };
+
+uint pio_add_program(PIO pio, const pio_program_t *program) {
+    return 0;
+}
+
+uint pio_claim_unused_sm(PIO pio, bool required) {
+    for (uint sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++) {
+        if (!(pio->claimed & (1u << sm))) {
+            pio->claimed |= (1u << sm);
+            return sm;
+        }
+    }
+    assert(!required);
+    return (uint)-1;
+}
+
+// Same numbering as the RP2040 DREQ table
+uint pio_get_dreq(PIO pio, uint sm, bool is_tx) {
+    return pio->index * 8 + sm + (is_tx ? 0 : 4);
+}
+
+void pio_gpio_init(PIO pio, uint pin) {}
+void pio_sm_set_pins_with_mask(PIO pio, uint sm, uint32_t pin_values, uint32_t pin_mask) {}
+void pio_sm_set_pindirs_with_mask(PIO pio, uint sm, uint32_t pin_dirs, uint32_t pin_mask) {}
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled) {}
+
+void pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config) {
+    pio->clkdiv[sm] = config->clkdiv;
+}
+
+#define DMA_OUTPUT_SIZE 65536
+
+typedef struct {
+    dma_channel_config config;
+    uint64_t busy_until_us;
+} dma_channel_t;
+
+static dma_channel_t dma_channels[NUM_DMA_CHANNELS];
+static uint16_t dma_claimed;
+static uint8_t dma_output[DMA_OUTPUT_SIZE];
+static size_t dma_output_length;
+
+int dma_claim_unused_channel(bool required) {
+    for (int channel = 0; channel < NUM_DMA_CHANNELS; channel++) {
+        if (!(dma_claimed & (1u << channel))) {
+            dma_claimed |= (1u << channel);
+            return channel;
+        }
+    }
+    assert(!required);
+    return -1;
+}
+
+dma_channel_config dma_channel_get_default_config(uint channel) {
+    dma_channel_config c = { DMA_SIZE_32, true, false, 0x3F };
+    return c;
+}
+
+void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size) {
+    c->size = size;
+}
+
+void channel_config_set_read_increment(dma_channel_config *c, bool incr) {
+    c->read_increment = incr;
+}
+
+void channel_config_set_write_increment(dma_channel_config *c, bool incr) {
+    c->write_increment = incr;
+}
+
+void channel_config_set_dreq(dma_channel_config *c, uint dreq) {
+    c->dreq = dreq;
+}
+
+// Time for a PIO state machine to consume a byte: ten bits of eight cycles each,
+// which is the frame of the only program fed by DMA, the Midi UART
+static uint64_t get_transfer_us(uint dreq) {
+    if (dreq >= 16) { return 0; } // Not paced by a PIO
+    PIO pio = (dreq < 8 ? pio0 : pio1);
+    float cycles = 10 * 8 * pio->clkdiv[dreq & 0x03];
+    return (uint64_t)(cycles * 1000000.0f / clock_get_hz(clk_sys));
+}
+
+static void start_transfer(uint channel, const volatile void *read_addr, uint32_t transfer_count) {
+    dma_channel_t *dma = &dma_channels[channel];
+    assert(dma->config.size == DMA_SIZE_8);
+    for (uint32_t i = 0; i < transfer_count && dma_output_length < DMA_OUTPUT_SIZE; i++) {
+        dma_output[dma_output_length++] = ((const volatile uint8_t *)read_addr)[i];
+    }
+    dma->busy_until_us = now_us + transfer_count * get_transfer_us(dma->config.dreq);
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, uint transfer_count, bool trigger) {
+    dma_channels[channel].config = *config;
+    if (trigger) { start_transfer(channel, read_addr, transfer_count); }
+}
+
+void dma_channel_transfer_from_buffer_now(uint channel, const volatile void *read_addr, uint32_t transfer_count) {
+    start_transfer(channel, read_addr, transfer_count);
+}
+
+bool dma_channel_is_busy(uint channel) {
+    return now_us < dma_channels[channel].busy_until_us;
+}
+
+size_t shim_dma_take_output(uint8_t *data, size_t max) {
+    size_t length = (dma_output_length < max ? dma_output_length : max);
+    memcpy(data, dma_output, length);
+    memmove(dma_output, &dma_output[length], dma_output_length - length);
+    dma_output_length -= length;
+    return length;
+}
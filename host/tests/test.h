@@ -0,0 +1,28 @@
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+#include <stdio.h>
+
+// Minimal checks for the host tests: failures are printed and counted,
+// and the test program returns non-zero if there were any
+static int test_failures;
+
+#define CHECK(condition) do { \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        test_failures++; \
+    } \
+} while (0)
+
+#define CHECK_EQ(actual, expected) do { \
+    long long actual_ = (long long)(actual); \
+    long long expected_ = (long long)(expected); \
+    if (actual_ != expected_) { \
+        fprintf(stderr, "%s:%d: check failed: %s == %s (%lld != %lld)\n", \
+                __FILE__, __LINE__, #actual, #expected, actual_, expected_); \
+        test_failures++; \
+    } \
+} while (0)
+
+#define TEST_RESULT() (test_failures > 0 ? 1 : 0)
+
+#endif
@@ -0,0 +1,110 @@
+/* Timing of the arpeggiator steps, while the main loop is held up by long tasks */
+
+#define main dodepan_main
+#include "main.cpp"
+#undef main
+
+#include "shim.h"
+#include "mpr121.h"
+#include "MPU6050.h"
+#include "test.h"
+
+#define HOLD_US         2000000 // Three pads held, arpeggiated upwards
+#define RELEASE_US      4000000
+#define STOP_US         4200000
+#define ARP_RATE        5       // 1/32
+#define STEPS_PER_BEAT  8
+#define BUSY_PERIOD_US  50000   // The main loop is held up this often,
+#define BUSY_US         15000   // for this long, as by a display transfer, within NOTE_LOOKAHEAD_US
+#define MAX_JITTER_US   100
+
+#define STEP_SAMPLES    ((uint64_t)SOUND_OUTPUT_FREQUENCY * 60 / TEMPO_BPM / STEPS_PER_BEAT)
+#define SAMPLES_TO_US(samples)  ((int64_t)(samples) * 1000000 / SOUND_OUTPUT_FREQUENCY)
+
+// Samples the synth started and ended the steps at
+#define STEPS_MAX   64
+
+static uint64_t on_samples[STEPS_MAX];
+static uint8_t on_notes[STEPS_MAX];
+static uint32_t steps;
+static uint64_t off_samples[STEPS_MAX];
+static uint32_t note_offs;
+
+static void on_synth_event(const fake_synth_event_t *event) {
+    uint32_t now = time_us_32();
+    if (now < HOLD_US || now >= STOP_US) { return; }
+    if (event->call == FAKE_SYNTH_NOTE_ON && steps < STEPS_MAX) {
+        on_notes[steps] = event->data1;
+        on_samples[steps++] = event->sample;
+    } else if (event->call == FAKE_SYNTH_NOTE_OFF && note_offs < STEPS_MAX) {
+        off_samples[note_offs++] = event->sample;
+    }
+}
+
+static inline int64_t get_error_us(uint64_t sample, int64_t expected) {
+    int64_t error_us = SAMPLES_TO_US((int64_t)sample - expected);
+    return (error_us < 0 ? -error_us : error_us);
+}
+
+static void on_idle(uint64_t now) {
+    static int step;
+    static uint64_t busy_us = HOLD_US;
+    if (step == 0 && now >= HOLD_US) {
+        set_arp_pattern(ARP_UP);
+        set_arp_rate(ARP_RATE);
+        fake_mpr121_set_touched(1 << 0 | 1 << 2 | 1 << 4);
+        step++;
+    } else if (step == 1 && now >= RELEASE_US) {
+        fake_mpr121_set_touched(0);
+        step++;
+    } else if (step == 2 && now >= STOP_US) {
+        shim_stop();
+    }
+    if (step == 1 && now >= busy_us) {
+        busy_us += BUSY_PERIOD_US;
+        shim_advance_us(BUSY_US);
+    }
+}
+
+int main() {
+    fake_mpu6050_set_accel(MPU6050_I2C_PORT, MPU6050_ADDRESS, 0, 0, 16384); // Lying flat
+    g_synth.fake_set_hook(on_synth_event);
+    shim_set_idle_hook(on_idle);
+    shim_run(dodepan_main);
+
+    // The first step plays as soon as it can, with the next buffer. The steps after it
+    // are on a grid that starts one step before the second one.
+    CHECK(steps > 2);
+    int64_t grid_start = (int64_t)(on_samples[1] - STEP_SAMPLES);
+    int64_t first_latency_us = SAMPLES_TO_US((int64_t)on_samples[0] - grid_start);
+    int64_t max_jitter_us = 0;      // Of the note ons, from the step grid
+    int64_t max_gate_error_us = 0;  // Of the note offs, from the end of the gate
+    uint32_t steps_out_of_order = 0;
+    int64_t gate_samples = STEP_SAMPLES * get_arp_gate() / ARP_GATE_MAX;
+    for (uint32_t i = 0; i < steps; i++) {
+        int64_t due = grid_start + i * STEP_SAMPLES;
+        int64_t error_us = get_error_us(on_samples[i], due);
+        if (i > 0 && error_us > max_jitter_us) { max_jitter_us = error_us; }
+        error_us = get_error_us(off_samples[i], due + gate_samples);
+        if (i < note_offs && error_us > max_gate_error_us) { max_gate_error_us = error_us; }
+        // Up through the three pads, then from the bottom again
+        if (i > 0 && (i % 3 == 0 ? on_notes[i] >= on_notes[i - 1] : on_notes[i] <= on_notes[i - 1])) {
+            steps_out_of_order++;
+        }
+    }
+
+    printf("arpeggiator: %lu steps, note ons within %lld us of the grid, note offs within %lld us of the gate, "
+           "first step %lld us late\n", (unsigned long)steps, (long long)max_jitter_us, (long long)max_gate_error_us,
+           (long long)first_latency_us);
+    int64_t step_us = SAMPLES_TO_US(STEP_SAMPLES);
+    uint32_t expected_steps = (uint32_t)((RELEASE_US - HOLD_US) / step_us);
+    uint32_t debounce_steps = (uint32_t)(MPR121_DEBOUNCE_MS * 1000 / step_us) + 1; // Of the release
+    CHECK(steps >= expected_steps && steps <= expected_steps + debounce_steps);
+    CHECK(first_latency_us < SAMPLES_TO_US(2 * AUDIO_BUFFER_LENGTH)); // Rendered with the next buffer
+    CHECK_EQ(steps_out_of_order, 0);
+    CHECK(max_jitter_us < MAX_JITTER_US);
+    CHECK(max_gate_error_us < MAX_JITTER_US);
+    CHECK_EQ(note_offs, steps);
+    CHECK_EQ(g_synth.fake_get_held_notes(), 0);
+    return TEST_RESULT();
+}
@@ -0,0 +1,267 @@
+/* The whole firmware on the host: boot, play, hear it and see it on USB */
+
+#define main dodepan_main
+#include "main.cpp"
+#undef main
+
+#include "shim.h"
+#include "mpr121.h"
+#include "MPU6050.h"
+#include "test.h"
+
+#define PAD_ON_US   2000000
+#define PAD_OFF_US  2300000
+#define SHARED_US   2400000
+#define MIDI_IN_US  2450000
+#define TRACKS_US   2470000
+#define SAVE_US     2500000
+#define TUNING_US   (SAVE_US + FLASH_WRITE_DELAY_S * 1000000 + 100000)
+#define STOP_US     (SAVE_US + FLASH_WRITE_DELAY_S * 1000000 + 500000)
+
+/* Midi sent over USB, with the time it was taken from the device */
+
+#define SENT_MAX    256
+
+static uint8_t sent[SENT_MAX][4];
+static uint32_t sent_us[SENT_MAX];
+static size_t sent_count;
+
+static void collect_sent() {
+    while (sent_count < SENT_MAX && fake_usb_take_sent(&sent[sent_count], 1) == 1) {
+        sent_us[sent_count++] = time_us_32();
+    }
+}
+
+#if defined (USE_MIDI_DIN)
+/* Midi sent on the serial output, as bytes */
+
+#define SERIAL_MAX  1024
+
+static uint8_t serial[SERIAL_MAX];
+static size_t serial_length;
+
+static void collect_serial() {
+    serial_length += shim_dma_take_output(&serial[serial_length], SERIAL_MAX - serial_length);
+}
+
+// Whether a note on message was sent with its status byte, on any channel
+static bool find_serial_note_on(uint8_t note) {
+    for (size_t i = 0; i + 2 < serial_length; i++) {
+        if ((serial[i] & 0xF0) == 0x90 && serial[i + 1] == note && serial[i + 2] > 0) { return true; }
+    }
+    return false;
+}
+#endif
+
+// Count the messages with this status and note between two times.
+// In MPE mode, notes go out on member channels: only the status type is compared then.
+static int count_sent(uint8_t status, uint8_t note, uint32_t from_us, uint32_t to_us) {
+#if defined (MIDI_MPE)
+    const uint8_t status_mask = 0xF0;
+#else
+    const uint8_t status_mask = 0xFF;
+#endif
+    int count = 0;
+    for (size_t i = 0; i < sent_count; i++) {
+        if (sent_us[i] < from_us || sent_us[i] >= to_us) { continue; }
+        if ((sent[i][1] & status_mask) == (status & status_mask) && sent[i][2] == note) { count++; }
+    }
+    return count;
+}
+
+/* Scenario */
+
+static uint8_t pad_note;
+static bool pad_held_by_synth;
+static int32_t peak_while_held;
+static uint32_t erases_before_due;
+static uint32_t synth_calls_from_core0;
+static bool shared_note_kept;
+static bool shared_note_ended;
+static bool midi_note_played;
+static uint8_t midi_control_value;
+static bool track_note_kept;
+static bool track_note_ended;
+static int8_t tuned_cents;
+static uint16_t tuned_bend;
+static uint16_t untuned_bend;
+
+// Pitch bend applied by core1, tilt and tuning together
+static uint16_t synth_bend = 0x2000;
+
+static void on_synth_event(const fake_synth_event_t *event) {
+    if (event->call == FAKE_SYNTH_PITCH_BEND) { synth_bend = event->data2 << 7 | event->data1; }
+}
+
+static void on_audio(const int16_t *samples, uint frames) {
+    if (time_us_32() < PAD_ON_US + 20000 || time_us_32() > PAD_OFF_US) { return; }
+    for (uint i = 0; i < frames * 2; i++) {
+        int32_t level = samples[i] < 0 ? -samples[i] : samples[i];
+        if (level > peak_while_held) { peak_while_held = level; }
+    }
+}
+
+static void on_idle(uint64_t now) {
+    static int step;
+    collect_sent();
+#if defined (USE_MIDI_DIN)
+    collect_serial();
+#endif
+#if defined (INPUT_TRACE)
+    static bool recording;
+    if (!recording) {
+        shim_stdin_push("r"); // Same as on the serial console
+        recording = true;
+    }
+#endif
+    if (step == 0 && now >= PAD_ON_US) {
+        fake_mpr121_set_touched(1 << 0);
+        synth_calls_from_core0 = g_synth.fake_get_calls_from_core0();
+        step++;
+    } else if (step == 1 && now >= PAD_OFF_US) {
+        pad_note = get_note_by_id(0);
+        pad_held_by_synth = g_synth.fake_is_note_held(pad_note);
+        fake_mpr121_set_touched(0);
+        step++;
+    } else if (step == 2 && now >= SHARED_US) {
+        // A pad and an arpeggiator step on the same note: the step ends first
+        note_on(0, 100);
+        synth_queue_push(now + 1000, SYNTH_NOTE_ON, pad_note, 100);
+        synth_queue_push(now + 5000, SYNTH_NOTE_OFF, pad_note, 0);
+        step++;
+    } else if (step == 3 && now >= SHARED_US + 20000) {
+        shared_note_kept = g_synth.fake_is_note_held(pad_note);
+        note_off(0);
+        step++;
+    } else if (step == 4 && now >= SHARED_US + 40000) {
+        shared_note_ended = !g_synth.fake_is_note_held(pad_note);
+        step++;
+    } else if (step == 5 && now >= MIDI_IN_US) {
+        const uint8_t note_on[4] = {0x09, 0x90 | MIDI_IN_CHANNEL, 72, 100};
+        const uint8_t control_change[4] = {0x0B, 0xB0 | MIDI_IN_CHANNEL, AMP_ATTACK, 5};
+        fake_usb_receive(note_on);
+        fake_usb_receive(control_change);
+        step++;
+    } else if (step == 6 && now >= MIDI_IN_US + 10000) {
+        midi_note_played = g_synth.fake_is_note_held(72);
+        midi_control_value = g_synth.current_controller_value(AMP_ATTACK);
+        const uint8_t note_off[4] = {0x08, 0x80 | MIDI_IN_CHANNEL, 72, 0};
+        fake_usb_receive(note_off);
+        step++;
+    } else if (step == 7 && now >= TRACKS_US) {
+        // The same pad on the first channel and on a looper track: one voice, two Midi notes
+        note_on(0, 100);
+        looper_note_on(1, 0, 100);
+        note_off(0);
+        step++;
+    } else if (step == 8 && now >= TRACKS_US + 10000) {
+        track_note_kept = g_synth.fake_is_note_held(pad_note);
+        looper_note_off(1, 0);
+        step++;
+    } else if (step == 9 && now >= TRACKS_US + 20000) {
+        track_note_ended = !g_synth.fake_is_note_held(pad_note);
+        step++;
+    } else if (step == 10 && now >= SAVE_US) {
+        request_flash_write(); // From the main loop, like the user interface does
+        // Presets loaded over SysEx into both sectors of the bank wait for the same write
+        uint8_t params[PROGRAM_PARAMS_NUM] = {};
+        params[0] = 5;
+        CHECK(sysex_object_write(SYSEX_PRESET, 0, 0, params, PROGRAM_PARAMS_NUM, PROGRAM_PARAMS_NUM));
+        CHECK(sysex_object_write(SYSEX_PRESET, NUM_PRESET_SLOTS - 1, 0, params, PROGRAM_PARAMS_NUM, PROGRAM_PARAMS_NUM));
+        step++;
+    } else if (step == 11 && now >= SAVE_US + FLASH_WRITE_DELAY_S * 1000000 - 1000) {
+        erases_before_due = shim_flash_get_erases();
+        step++;
+    } else if (step == 12 && now >= TUNING_US) {
+        // A note tuned sharp bends the synth
+        set_tuning(1); // Just intonation
+        tuned_cents = get_cents_by_id(1);
+        note_on(1, 100);
+        step++;
+    } else if (step == 13 && now >= TUNING_US + 20000) {
+        tuned_bend = synth_bend;
+        note_off(1);
+        // With bending disabled by the preset, the tuning doesn't bend it anymore
+        synth_queue_push(now, SYNTH_CONTROL_CHANGE, P_BEND_RANGE, 0);
+        step++;
+    } else if (step == 14 && now >= TUNING_US + 40000) {
+        untuned_bend = synth_bend;
+        set_tuning(0);
+        step++;
+    } else if (step == 15 && now >= STOP_US) {
+        shim_stop();
+    }
+}
+
+int main() {
+    fake_mpu6050_set_accel(MPU6050_I2C_PORT, MPU6050_ADDRESS, 0, 0, 16384); // Lying flat
+    shim_set_audio_hook(on_audio);
+    g_synth.fake_set_hook(on_synth_event);
+    shim_set_idle_hook(on_idle);
+    shim_run(dodepan_main);
+
+    CHECK_EQ(get_context(), CTX_SELECTION); // Past the intro
+    CHECK(shim_audio_buffers_played() > (STOP_US - 1100000) / 1400);
+    CHECK_EQ(g_synth.fake_get_calls_from_core0(), synth_calls_from_core0); // Played by core1 only
+
+    // A pad
+    CHECK(pad_held_by_synth);
+    CHECK(peak_while_held > 1000);
+    CHECK_EQ(count_sent(0x90, pad_note, PAD_ON_US, PAD_OFF_US), 1);
+    CHECK_EQ(count_sent(0x80, pad_note, PAD_OFF_US, SHARED_US), 1);
+
+    // A pad and an arpeggiator step share the voice
+    CHECK(shared_note_kept);
+    CHECK(shared_note_ended);
+
+    // Midi input
+    CHECK(midi_note_played);
+    CHECK_EQ(midi_control_value, 5);
+    CHECK(!g_synth.fake_is_note_held(72));
+
+    // A pad and a looper track share the voice, but not the Midi channel
+    CHECK(track_note_kept);
+    CHECK(track_note_ended);
+#if !defined (MIDI_MPE)
+    CHECK_EQ(count_sent(0x90, pad_note, TRACKS_US, TRACKS_US + 10000), 1);
+    CHECK_EQ(count_sent(0x91, pad_note, TRACKS_US, TRACKS_US + 10000), 1);
+    CHECK_EQ(count_sent(0x80, pad_note, TRACKS_US, TRACKS_US + 10000), 1);
+    CHECK_EQ(count_sent(0x81, pad_note, TRACKS_US, TRACKS_US + 10000), 0);
+    CHECK_EQ(count_sent(0x81, pad_note, TRACKS_US + 10000, SAVE_US), 1);
+#else
+    CHECK_EQ(count_sent(0x90, pad_note, TRACKS_US, SAVE_US), 2);
+    CHECK_EQ(count_sent(0x80, pad_note, TRACKS_US, SAVE_US), 2);
+#endif
+
+    // The tuning of the latest note, converted with the bend range of the preset by core1
+    CHECK(tuned_cents > 0);
+    CHECK_EQ(tuned_bend, 0x2000 + tuned_cents * 0x2000 / (2 * 100));
+    CHECK_EQ(untuned_bend, 0x2000);
+
+    // The settings and the two preset bank sectors are written once, by the main loop, after the delay
+    CHECK_EQ(erases_before_due, 0);
+    CHECK_EQ(shim_flash_get_erases(), 1 + PRESET_BANK_SECTORS);
+    CHECK_EQ(preset_bank_get(0)[0], 5);
+    CHECK_EQ(preset_bank_get(NUM_PRESET_SLOTS - 1)[0], 5);
+    CHECK_EQ(((const uint8_t *)(XIP_BASE + FLASH_TARGET_OFFSET))[MAGIC_NUMBER_LENGTH + 6], FLASH_DATA_VERSION);
+
+#if defined (INPUT_TRACE)
+    // The pad is in the input trace, and its note in the Midi output logged with it
+    const trace_output_t *outputs;
+    uint16_t output_count = input_trace_get_outputs(&outputs);
+    bool pad_note_logged = false;
+    for (uint16_t i = 0; i < output_count; i++) {
+        if ((outputs[i].data[0] & 0xF0) == 0x90 && outputs[i].data[1] == pad_note) { pad_note_logged = true; }
+    }
+    CHECK(pad_note_logged);
+#endif
+#if defined (USE_MIDI_DIN)
+    // The serial output gets the same notes as USB
+    CHECK(find_serial_note_on(pad_note));
+#endif
+#if defined (USE_PROFILER)
+    // The main loop is measured. The shim has no SysTick, so only the loop count is meaningful.
+    CHECK(profiler_get_loop_rate() > 0);
+#endif
+    return TEST_RESULT();
+}
@@ -0,0 +1,136 @@
+/* Overdubbing a looper track with a chord, while another track plays */
+
+#define main dodepan_main
+#include "main.cpp"
+#undef main
+
+#include "shim.h"
+#include "mpr121.h"
+#include "MPU6050.h"
+#include "test.h"
+
+#define PLAY_US         2000000 // The second track plays a note held for most of the loop
+#define FIRST_PAD_US    2200000 // Starts the overdub of the first track
+#define SECOND_PAD_US   2250000 // Played along with the first pad
+#define CHECK_US        2350000
+#define RELEASE_US      2400000
+#define REPLAY_US       3000000 // The overdub plays back from the next pass
+#define STOP_US         3600000
+#define LOOP_US         1000000
+#define TRACK_ID        4
+#define FIRST_PAD_ID    0
+#define SECOND_PAD_ID   2
+
+/* Midi sent over USB, with the time it was taken from the device */
+
+#define SENT_MAX    256
+
+static uint8_t sent[SENT_MAX][4];
+static uint32_t sent_us[SENT_MAX];
+static size_t sent_count;
+
+static void collect_sent() {
+    while (sent_count < SENT_MAX && fake_usb_take_sent(&sent[sent_count], 1) == 1) {
+        sent_us[sent_count++] = time_us_32();
+    }
+}
+
+#if !defined (MIDI_MPE)
+static int count_sent(uint8_t status, uint8_t note, uint32_t from_us, uint32_t to_us) {
+    int count = 0;
+    for (size_t i = 0; i < sent_count; i++) {
+        if (sent_us[i] < from_us || sent_us[i] >= to_us) { continue; }
+        if (sent[i][1] == status && sent[i][2] == note) { count++; }
+    }
+    return count;
+}
+#endif
+
+/* Scenario */
+
+static bool loop_kept_playing;
+static bool track_note_held;
+static bool first_pad_held;
+static bool second_pad_held;
+static bool first_pad_replayed;
+static bool second_pad_replayed;
+
+// The second track holds a note from the start of the loop to 900 ms, as loaded from a SysEx dump
+static void load_track() {
+    const uint8_t dump[LOOPER_DUMP_HEADER_SIZE + 2 * LOOPER_DUMP_EVENT_SIZE] = {
+        LOOP_US & 0xFF, (LOOP_US >> 8) & 0xFF, (LOOP_US >> 16) & 0xFF, 0, 2, 0, 0, 0,
+        0, 0, 0, 0, TRACK_ID, 100, LOOPER_NOTE_ON,
+        0xA0, 0xBB, 0x0D, 0, TRACK_ID, 0, LOOPER_NOTE_OFF, // At 900 ms
+    };
+    CHECK(looper_load(1, 0, dump, sizeof(dump), sizeof(dump)));
+}
+
+static void on_idle(uint64_t now) {
+    static int step;
+    collect_sent();
+    if (step == 0 && now >= PLAY_US) {
+        looper_enable();
+        load_track();
+        looper_select_track(0);
+        set_context(CTX_LOOPER);
+        looper_start_playback();
+        step++;
+    } else if (step == 1 && now >= FIRST_PAD_US) {
+        fake_mpr121_set_touched(1 << FIRST_PAD_ID);
+        step++;
+    } else if (step == 2 && now >= SECOND_PAD_US) {
+        fake_mpr121_set_touched(1 << FIRST_PAD_ID | 1 << SECOND_PAD_ID);
+        step++;
+    } else if (step == 3 && now >= CHECK_US) {
+        loop_kept_playing = looper_keeps_playing();
+        track_note_held = g_synth.fake_is_note_held(get_note_by_id(TRACK_ID));
+        first_pad_held = g_synth.fake_is_note_held(get_note_by_id(FIRST_PAD_ID));
+        second_pad_held = g_synth.fake_is_note_held(get_note_by_id(SECOND_PAD_ID));
+        step++;
+    } else if (step == 4 && now >= RELEASE_US) {
+        fake_mpr121_set_touched(0);
+        step++;
+    } else if (step == 5 && now >= REPLAY_US + CHECK_US - PLAY_US) {
+        first_pad_replayed = g_synth.fake_is_note_held(get_note_by_id(FIRST_PAD_ID));
+        second_pad_replayed = g_synth.fake_is_note_held(get_note_by_id(SECOND_PAD_ID));
+        step++;
+    } else if (step == 6 && now >= STOP_US) {
+        looper_stop();
+        step++;
+    } else if (step == 7 && now >= STOP_US + 100000) {
+        shim_stop();
+    }
+}
+
+int main() {
+    fake_mpu6050_set_accel(MPU6050_I2C_PORT, MPU6050_ADDRESS, 0, 0, 16384); // Lying flat
+    shim_set_idle_hook(on_idle);
+    shim_run(dodepan_main);
+
+    // Both pads sound over the other track, none of them cut by the next
+    CHECK(loop_kept_playing);
+    CHECK(track_note_held);
+    CHECK(first_pad_held);
+    CHECK(second_pad_held);
+
+    // Recorded together, they play back together on the next pass
+    CHECK(first_pad_replayed);
+    CHECK(second_pad_replayed);
+    CHECK_EQ(g_synth.fake_get_held_notes(), 0);
+
+#if !defined (MIDI_MPE)
+    // Midi receivers get no note off until the pads are released, or the loop ends the track note
+    uint8_t track_note = get_note_by_id(TRACK_ID);
+    uint8_t first_note = get_note_by_id(FIRST_PAD_ID);
+    uint8_t second_note = get_note_by_id(SECOND_PAD_ID);
+    CHECK_EQ(count_sent(0x91, track_note, PLAY_US, FIRST_PAD_US), 1);
+    CHECK_EQ(count_sent(0x81, track_note, FIRST_PAD_US, RELEASE_US), 0);
+    CHECK_EQ(count_sent(0x90, first_note, FIRST_PAD_US, RELEASE_US), 1);
+    CHECK_EQ(count_sent(0x80, first_note, FIRST_PAD_US, RELEASE_US), 0);
+    CHECK_EQ(count_sent(0x90, second_note, FIRST_PAD_US, RELEASE_US), 1);
+    CHECK_EQ(count_sent(0x80, second_note, FIRST_PAD_US, RELEASE_US), 0);
+    CHECK_EQ(count_sent(0x80, first_note, RELEASE_US, REPLAY_US), 1);
+    CHECK_EQ(count_sent(0x80, second_note, RELEASE_US, REPLAY_US), 1);
+#endif
+    return TEST_RESULT();
+}
@@ -0,0 +1,539 @@
+/* The Midi modules: output limiter, input parser, clock follower, SysEx, MPE channels, output queue and serial output */
+
+#include <math.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "shim.h"
+#include "MPU6050.h"
+#include "config.h"
+#include "imu.h"
+#include "midi_limiter.h"
+#include "midi_in.h"
+#include "midi_clock.h"
+#include "sysex.h"
+#include "midi_queue.h"
+#include "midi_uart.h"
+#include "mpe.h"
+#include "tusb.h"
+#include "test.h"
+
+/* Callbacks of the modules under test */
+
+typedef enum received_type {
+    RECEIVED_NOTE_ON,
+    RECEIVED_NOTE_OFF,
+    RECEIVED_CONTROL_CHANGE,
+    RECEIVED_PROGRAM_CHANGE,
+    RECEIVED_PITCH_BEND,
+    RECEIVED_CLOCK,
+    RECEIVED_START,
+    RECEIVED_CONTINUE,
+    RECEIVED_STOP,
+} received_type_t;
+
+typedef struct received {
+    received_type_t type;
+    uint8_t data1;
+    uint8_t data2;
+} received_t;
+
+#define RECEIVED_MAX    64
+
+static received_t received[RECEIVED_MAX];
+static size_t received_count;
+
+static void receive(received_type_t type, uint8_t data1, uint8_t data2) {
+    if (received_count >= RECEIVED_MAX) { return; }
+    received[received_count++] = (received_t){ type, data1, data2 };
+}
+
+void midi_in_note_on(uint8_t note, uint8_t velocity) { receive(RECEIVED_NOTE_ON, note, velocity); }
+void midi_in_note_off(uint8_t note) { receive(RECEIVED_NOTE_OFF, note, 0); }
+void midi_in_control_change(uint8_t control_number, uint8_t value) { receive(RECEIVED_CONTROL_CHANGE, control_number, value); }
+void midi_in_program_change(uint8_t program) { receive(RECEIVED_PROGRAM_CHANGE, program, 0); }
+void midi_in_pitch_bend(uint8_t lsb, uint8_t msb) { receive(RECEIVED_PITCH_BEND, lsb, msb); }
+void midi_in_clock() { receive(RECEIVED_CLOCK, 0, 0); }
+void midi_in_start() { receive(RECEIVED_START, 0, 0); }
+void midi_in_continue() { receive(RECEIVED_CONTINUE, 0, 0); }
+void midi_in_stop() { receive(RECEIVED_STOP, 0, 0); }
+
+// The objects of the SysEx dumps, in memory
+#define OBJECT_TYPES        3
+#define OBJECTS_PER_TYPE    4
+#define OBJECT_SIZE_MAX     4096
+#define PRESET_SIZE         43      // As the program parameters of PRA32-U
+
+static uint8_t objects[OBJECT_TYPES][OBJECTS_PER_TYPE][OBJECT_SIZE_MAX];
+static uint16_t object_sizes[OBJECT_TYPES][OBJECTS_PER_TYPE];
+
+uint8_t sysex_object_count(uint8_t type) {
+    return (type >= SYSEX_PRESET && type <= SYSEX_LOOP ? OBJECTS_PER_TYPE : 0);
+}
+
+uint16_t sysex_object_size(uint8_t type, uint8_t index) {
+    return object_sizes[type - SYSEX_PRESET][index];
+}
+
+void sysex_object_read(uint8_t type, uint8_t index, uint16_t offset, uint8_t *data, uint8_t length) {
+    memcpy(data, &objects[type - SYSEX_PRESET][index][offset], length);
+}
+
+bool sysex_object_write(uint8_t type, uint8_t index, uint16_t offset,
+                        const uint8_t *data, uint8_t length, uint16_t size) {
+    if (sysex_object_count(type) == 0 || index >= OBJECTS_PER_TYPE || size > OBJECT_SIZE_MAX) { return false; }
+    memcpy(&objects[type - SYSEX_PRESET][index][offset], data, length);
+    object_sizes[type - SYSEX_PRESET][index] = size;
+    return true;
+}
+
+/* Output limiter */
+
+// Tilt of the device over time, as the pitch bend axis of the accelerometer sees it.
+// Readings get some noise, as from a device held in the hand.
+typedef struct tilt_segment {
+    uint32_t length_us;
+    float from_degrees;
+    float to_degrees;
+    int16_t noise;              // Largest raw deviation of a reading
+} tilt_segment_t;
+
+static const tilt_segment_t tilt_trace[] = {
+    { 1000000,  0.0f,  0.0f, 100 },    // Held still
+    { 2000000,  0.0f, 30.0f, 100 },    // Slow tilt
+    { 500000,  30.0f, 30.0f, 100 },    // Held still
+    { 100000,  30.0f, 60.0f, 0 },      // Quick flick
+    { 100000,  60.0f, 10.0f, 0 },
+    { 1000000, 10.0f, 10.0f, 0 },      // At rest
+};
+
+#define NUM_TILT_SEGMENTS   (sizeof(tilt_trace) / sizeof(tilt_trace[0]))
+
+static uint32_t noise_seed = 1;
+
+static int16_t get_noise(int16_t amplitude) {
+    noise_seed = noise_seed * 1103515245 + 12345;
+    if (amplitude == 0) { return 0; }
+    return (int16_t)((noise_seed >> 16) % (2 * amplitude + 1)) - amplitude;
+}
+
+static void test_limiter_tilt_trace() {
+    Imu_data data;
+    midi_limiter_t limiter;
+    uint32_t now = 0;
+    uint32_t last_sent_us = 0;
+    bool has_sent = false;
+    uint32_t shortest_interval_us = UINT32_MAX;
+    uint32_t messages[NUM_TILT_SEGMENTS] = {0};
+    uint32_t readings = 0;
+    bool initialized = false;
+
+    for (size_t s = 0; s < NUM_TILT_SEGMENTS; s++) {
+        const tilt_segment_t *segment = &tilt_trace[s];
+        for (uint32_t t = 0; t < segment->length_us; t += IMU_PERIOD_US, now += IMU_PERIOD_US) {
+            float degrees = segment->from_degrees + (segment->to_degrees - segment->from_degrees) * t / segment->length_us;
+            float radians = degrees * (float)M_PI / 180.0f;
+            // The bend axis is the y axis of the module, see config.h
+            struct mpu6050_vector16 accel = {
+                0, (int16_t)(-16384 * sinf(radians)) + get_noise(segment->noise), (int16_t)(16384 * cosf(radians))
+            };
+            imu_process(&accel, &data);
+            readings++;
+            if (!initialized) {
+                midi_limiter_init(&limiter, data.deviation_x, MIDI_BEND_THRESHOLD, MIDI_MIN_INTERVAL_US, MIDI_SETTLE_US);
+                initialized = true;
+            }
+            if (!midi_limiter_update(&limiter, data.deviation_x, now)) { continue; }
+            if (has_sent && now - last_sent_us < shortest_interval_us) { shortest_interval_us = now - last_sent_us; }
+            has_sent = true;
+            last_sent_us = now;
+            messages[s]++;
+        }
+    }
+
+    uint32_t total = 0;
+    for (size_t s = 0; s < NUM_TILT_SEGMENTS; s++) { total += messages[s]; }
+    printf("limiter: %lu messages for %lu readings (still %lu, slow %lu, flick %lu+%lu, rest %lu)\n",
+           (unsigned long)total, (unsigned long)readings, (unsigned long)messages[0], (unsigned long)messages[1],
+           (unsigned long)messages[3], (unsigned long)messages[4], (unsigned long)messages[5]);
+
+    CHECK(shortest_interval_us >= MIDI_MIN_INTERVAL_US);
+    CHECK(messages[0] <= 1);            // Sensor noise is not sent
+    CHECK(messages[1] > 10);            // A slow tilt is followed
+    CHECK(messages[3] + messages[4] > 10); // And so is a quick one
+    CHECK(total < readings / 4);
+    CHECK_EQ(limiter.sent, data.deviation_x); // The resting value always goes out
+}
+
+/* Input parser */
+
+static void test_input_stream() {
+    const uint8_t ch = MIDI_IN_CHANNEL;
+    const uint8_t stream[][4] = {
+        {0x09, 0x90 | ch, 60, 100},
+        {0x09, 0x90 | ch, 60, 0},           // Note on with zero velocity
+        {0x08, 0x80 | ch, 62, 64},
+        {0x0B, 0xB0 | ch, 74, 10},
+        {0x0C, 0xC0 | ch, 5, 0},
+        {0x0E, 0xE0 | ch, 0x12, 0x40},
+        {0x19, 0x90 | ch, 64, 90},          // On another cable
+        {0x09, 0x90 | ((ch + 1) & 0x0F), 60, 100}, // On another channel
+        {0x0B, 0x90 | ch, 60, 100},         // Code index not matching the status
+        {0x0A, 0xA0 | ch, 60, 20},          // Polyphonic pressure, not supported
+        {0x0F, 0xFA, 0, 0},
+        {0x0F, 0xF8, 0, 0},
+        {0x0F, 0xFC, 0, 0},
+        {0x0F, 0xFB, 0, 0},
+    };
+    const received_t expected[] = {
+        {RECEIVED_NOTE_ON, 60, 100},
+        {RECEIVED_NOTE_OFF, 60, 0},
+        {RECEIVED_NOTE_OFF, 62, 0},
+        {RECEIVED_CONTROL_CHANGE, 74, 10},
+        {RECEIVED_PROGRAM_CHANGE, 5, 0},
+        {RECEIVED_PITCH_BEND, 0x12, 0x40},
+        {RECEIVED_NOTE_ON, 64, 90},
+        {RECEIVED_START, 0, 0},
+        {RECEIVED_CLOCK, 0, 0},
+        {RECEIVED_STOP, 0, 0},
+        {RECEIVED_CONTINUE, 0, 0},
+    };
+    const size_t expected_count = sizeof(expected) / sizeof(expected[0]);
+
+    received_count = 0;
+    for (size_t i = 0; i < sizeof(stream) / sizeof(stream[0]); i++) {
+        fake_usb_receive(stream[i]);
+    }
+    while (tud_midi_available() > 0) { midi_in_task(); }
+    CHECK_EQ(received_count, expected_count);
+    for (size_t i = 0; i < expected_count && i < received_count; i++) {
+        CHECK_EQ(received[i].type, expected[i].type);
+        CHECK_EQ(received[i].data1, expected[i].data1);
+        CHECK_EQ(received[i].data2, expected[i].data2);
+    }
+
+    // A burst is read over several tasks, so that the touch scan is not held back
+    received_count = 0;
+    const uint8_t note_on[4] = {0x09, 0x90 | ch, 60, 100};
+    for (int i = 0; i < MIDI_IN_PACKETS_PER_TASK + 4; i++) {
+        fake_usb_receive(note_on);
+    }
+    midi_in_task();
+    CHECK_EQ(received_count, MIDI_IN_PACKETS_PER_TASK);
+    midi_in_task();
+    CHECK_EQ(received_count, MIDI_IN_PACKETS_PER_TASK + 4);
+}
+
+/* Clock follower */
+
+#define CLOCK_JITTER_US     1000 // USB delivers the ticks on 1 ms frames
+#define CLOCK_TICKS         (16 * MIDI_CLOCK_PPQN)
+#define CLOCK_SAMPLES_MAX   (CLOCK_TICKS * 32) // Song positions sampled, every 1 ms
+
+// Follow a clock with its ticks delivered up to CLOCK_JITTER_US late. Once locked,
+// the song position lags by the mean delay: return it, and the largest deviation
+// from it, which is what the jitter leaves of the phase error. In microseconds.
+static void follow_clock(double bpm, uint32_t start_us, uint32_t ticks, double *lag_us, double *deviation_us) {
+    static double errors[CLOCK_SAMPLES_MAX];
+    double period_us = 60e6 / bpm / MIDI_CLOCK_PPQN;
+    uint32_t lock_ticks = 2 * MIDI_CLOCK_PPQN;
+    uint32_t last_time = 0;
+    bool monotonic = true;
+    size_t count = 0;
+
+    midi_clock_start();
+    for (uint32_t tick = 0; tick < ticks; tick++) {
+        uint32_t tick_us = start_us + (uint32_t)(tick * period_us) + (uint32_t)(get_noise(CLOCK_JITTER_US / 2) + CLOCK_JITTER_US / 2);
+        midi_clock_tick(tick_us);
+        if (tick < lock_ticks) { continue; }
+        // Sample the song position every 1 ms until the next tick is due
+        for (uint32_t now = tick_us; now < start_us + (uint32_t)((tick + 1) * period_us); now += 1000) {
+            uint32_t time = midi_clock_get_time(now);
+            if (time < last_time) { monotonic = false; }
+            last_time = time;
+            double expected = (now - start_us) / period_us * MIDI_CLOCK_TICK_UNITS;
+            if (count < sizeof(errors) / sizeof(errors[0])) {
+                errors[count++] = (expected - time) * period_us / MIDI_CLOCK_TICK_UNITS;
+            }
+        }
+    }
+    CHECK(monotonic);
+
+    double sum = 0.0;
+    for (size_t i = 0; i < count; i++) { sum += errors[i]; }
+    *lag_us = sum / count;
+    *deviation_us = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        if (fabs(errors[i] - *lag_us) > *deviation_us) { *deviation_us = fabs(errors[i] - *lag_us); }
+    }
+    double period_error = fabs(midi_clock_get_period_us() - period_us) / period_us;
+    CHECK(period_error < 0.01);
+}
+
+static void test_clock_jitter() {
+    double lag_us, deviation_us;
+    uint32_t start_us = 1000000;
+
+    follow_clock(120.0, start_us, CLOCK_TICKS, &lag_us, &deviation_us);
+    printf("clock at 120 BPM: lag %.0f us, phase error within %.0f us, with %d us of jitter\n",
+           lag_us, deviation_us, CLOCK_JITTER_US);
+    CHECK(lag_us < CLOCK_JITTER_US);
+    CHECK(deviation_us < CLOCK_JITTER_US * 3 / 4);
+    CHECK_EQ(midi_clock_get_beat_us() / 1000, 500);
+
+    // Locking again after a tempo change
+    start_us += 20000000;
+    follow_clock(140.0, start_us, CLOCK_TICKS, &lag_us, &deviation_us);
+    printf("clock at 140 BPM: lag %.0f us, phase error within %.0f us\n", lag_us, deviation_us);
+    CHECK(lag_us < CLOCK_JITTER_US);
+    CHECK(deviation_us < CLOCK_JITTER_US * 3 / 4);
+
+    midi_clock_stop();
+    CHECK(!midi_clock_is_running());
+    CHECK_EQ(midi_clock_get_beat_us(), 60000000 / TEMPO_BPM);
+}
+
+/* SysEx */
+
+#define SYSEX_PACKETS_MAX   4096
+
+static uint8_t sysex_packets[SYSEX_PACKETS_MAX][4];
+static size_t sysex_packet_count;
+
+// Run the dump and the output queue until the device has nothing more to send
+static void collect_sysex_output() {
+    size_t idle = 0;
+    while (idle < 4 && sysex_packet_count < SYSEX_PACKETS_MAX) {
+        sysex_task();
+        midi_queue_flush();
+        tud_task();
+        size_t taken = fake_usb_take_sent(&sysex_packets[sysex_packet_count], SYSEX_PACKETS_MAX - sysex_packet_count);
+        sysex_packet_count += taken;
+        idle = (taken == 0 ? idle + 1 : 0);
+    }
+}
+
+// Send packets to the device as a host would, waiting for the reply to each frame
+static void send_sysex_packets(const uint8_t (*packets)[4], size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        fake_usb_receive(packets[i]);
+        midi_in_task();
+        uint8_t cin = packets[i][0] & 0x0F;
+        if (cin >= 0x05 && cin <= 0x07) { collect_sysex_output(); } // The frame ended
+    }
+}
+
+static void send_sysex_request(uint8_t command, uint8_t type, uint8_t index) {
+    uint8_t sum = command + type + index;
+    const uint8_t packets[][4] = {
+        {0x04, 0xF0, SYSEX_MANUFACTURER_ID, SYSEX_DEVICE_ID},
+        {0x04, command, type, index},
+        {0x06, (uint8_t)(-sum) & 0x7F, 0xF7, 0},
+    };
+    send_sysex_packets(packets, 3);
+}
+
+// Count the frames sent with this command
+static size_t count_sysex_frames(uint8_t command) {
+    size_t count = 0;
+    for (size_t i = 1; i < sysex_packet_count; i++) {
+        // The command follows the header, at the start of the second packet of a frame
+        if (sysex_packets[i - 1][1] == 0xF0 && sysex_packets[i][1] == command) { count++; }
+    }
+    return count;
+}
+
+static void test_sysex_round_trip() {
+    static uint8_t original[OBJECT_TYPES][OBJECTS_PER_TYPE][OBJECT_SIZE_MAX];
+    static uint16_t original_sizes[OBJECT_TYPES][OBJECTS_PER_TYPE];
+    const uint16_t loop_size = 3000;
+
+    // A few presets, and a multi-kilobyte loop, with all the byte values
+    for (uint8_t i = 0; i < 2; i++) {
+        for (uint16_t j = 0; j < PRESET_SIZE; j++) { objects[0][i][j] = (uint8_t)(j * 7 + i); }
+        object_sizes[0][i] = PRESET_SIZE;
+    }
+    for (uint16_t j = 0; j < loop_size; j++) { objects[2][0][j] = (uint8_t)get_noise(128); }
+    object_sizes[2][0] = loop_size;
+    memcpy(original, objects, sizeof(objects));
+    memcpy(original_sizes, object_sizes, sizeof(object_sizes));
+
+    // Dump them
+    sysex_packet_count = 0;
+    send_sysex_request(SYSEX_REQUEST_ALL, SYSEX_PRESET, 0);
+    send_sysex_request(SYSEX_REQUEST, SYSEX_LOOP, 0);
+    size_t dump_frames = count_sysex_frames(SYSEX_DATA);
+    size_t data_size = 2 * PRESET_SIZE + loop_size;
+    CHECK_EQ(dump_frames, 2 + (loop_size + SYSEX_CHUNK_SIZE - 1) / SYSEX_CHUNK_SIZE);
+    printf("sysex: %lu bytes dumped in %lu frames, %lu USB packets (%.2f bytes per data byte)\n",
+           (unsigned long)data_size, (unsigned long)dump_frames, (unsigned long)sysex_packet_count,
+           sysex_packet_count * 3.0 / data_size);
+
+    // Load them back, from the dump as the device sent it
+    static uint8_t dump[SYSEX_PACKETS_MAX][4];
+    size_t dump_count = sysex_packet_count;
+    memcpy(dump, sysex_packets, sizeof(dump[0]) * dump_count);
+    memset(objects, 0, sizeof(objects));
+    memset(object_sizes, 0, sizeof(object_sizes));
+    sysex_packet_count = 0;
+    send_sysex_packets(dump, dump_count);
+    CHECK_EQ(count_sysex_frames(SYSEX_ACK), dump_frames);
+    CHECK_EQ(count_sysex_frames(SYSEX_NAK), 0);
+    CHECK(memcmp(objects, original, sizeof(objects)) == 0);
+    CHECK(memcmp(object_sizes, original_sizes, sizeof(object_sizes)) == 0);
+
+    // A corrupted chunk is rejected
+    dump[5][2] ^= 0x01;
+    sysex_packet_count = 0;
+    send_sysex_packets(dump, dump_count);
+    CHECK(count_sysex_frames(SYSEX_NAK) >= 1);
+}
+
+/* MPE member channels */
+
+static void test_mpe_allocation() {
+    bool stolen;
+    mpe_init();
+
+    // Each note gets its own member channel, in rotation after the manager channel
+    CHECK_EQ(mpe_allocate(10, 0x2000, 0, &stolen), MPE_MANAGER_CHANNEL + 1);
+    CHECK(!stolen);
+    CHECK_EQ(mpe_allocate(11, 0x2000, 0, &stolen), MPE_MANAGER_CHANNEL + 2);
+    CHECK_EQ(mpe_get_channel(10), MPE_MANAGER_CHANNEL + 1);
+
+    // A released channel is only reused once the rotation comes back to it
+    CHECK_EQ(mpe_release(10), MPE_MANAGER_CHANNEL + 1);
+    CHECK_EQ(mpe_get_channel(10), MPE_NO_CHANNEL);
+    CHECK_EQ(mpe_release(10), MPE_NO_CHANNEL);
+    CHECK_EQ(mpe_allocate(12, 0x2000, 0, &stolen), MPE_MANAGER_CHANNEL + 3);
+
+    // A key still holding a channel takes it over
+    CHECK_EQ(mpe_allocate(11, 0x2000, 0, &stolen), MPE_MANAGER_CHANNEL + 2);
+    CHECK(stolen);
+
+    // Once all the members are busy, the next one in rotation is stolen
+    for (uint16_t key = 13; key < 13 + MPE_MEMBER_CHANNELS - 2; key++) {
+        CHECK(mpe_allocate(key, 0x2000, 0, &stolen) != MPE_NO_CHANNEL);
+        CHECK(!stolen);
+    }
+    int8_t channel = mpe_allocate(100, 0x2000, 0, &stolen);
+    CHECK(stolen);
+    CHECK_EQ(mpe_get_member_key(channel - MPE_MANAGER_CHANNEL - 1), 100);
+    CHECK_EQ(mpe_allocate(MPE_NO_KEY, 0x2000, 0, &stolen), MPE_NO_CHANNEL);
+
+    // A note is bent by its tuning and by the tilt since it started, within the Midi range
+    mpe_init();
+    channel = mpe_allocate(20, 0x2100, 50, &stolen);
+    uint8_t member = channel - MPE_MANAGER_CHANNEL - 1;
+    int16_t tuning = 50 * 0x2000 / (MPE_BEND_RANGE * 100);
+    CHECK_EQ(mpe_get_bend(member, 0x2100), 0x2000 + tuning);
+    CHECK_EQ(mpe_get_bend(member, 0x2200), 0x2100 + tuning);
+    CHECK_EQ(mpe_get_bend(member, 0x3FFF), 0x3FFF);
+    channel = mpe_allocate(21, 0x3FFF, -50, &stolen);
+    CHECK_EQ(mpe_get_bend(channel - MPE_MANAGER_CHANNEL - 1, 0), 0);
+}
+
+/* Output queue */
+
+#define QUEUE_PACKETS_MAX   256
+
+static void test_queue_note_off_priority() {
+    static uint8_t packets[QUEUE_PACKETS_MAX][4];
+    size_t packet_count = 0;
+    midi_queue_clear();
+
+    // The host stops reading while controllers pile up: distinct controllers,
+    // and ordered ones until they are refused
+    uint8_t controllers = MIDI_QUEUE_CONTROLLERS_MAX - 1;
+    for (uint8_t i = 0; i < controllers; i++) { CHECK(midi_queue_push(0, 0xB0, i, 1)); }
+    uint16_t ordered = 0;
+    while (midi_queue_push_ordered(0, 0xB1, 7, ordered & 0x7F)) { ordered++; }
+    CHECK_EQ(ordered, MIDI_QUEUE_EVENTS_MAX - MIDI_QUEUE_NOTE_OFFS_RESERVED);
+    CHECK(!midi_queue_push(0, 0x90, 60, 100)); // No room left for a note on
+
+    // Note offs still go in, first to the reserved slots, then in place of the ordered
+    // controllers, which are coalesced with the other controllers instead
+    uint32_t dropped = midi_queue_get_stats()->dropped;
+    for (uint8_t i = 0; i < MIDI_QUEUE_EVENTS_MAX; i++) {
+        CHECK(midi_queue_push(0, (i & 1) ? 0x80 : 0x90, i, 0));
+    }
+    CHECK(!midi_queue_push(0, 0x80, 127, 0)); // Only once the queue holds nothing but note offs
+    CHECK_EQ(midi_queue_get_stats()->dropped, dropped + 1);
+
+    // Every note off goes out, before the controllers
+    for (int i = 0; i < 64 && packet_count < QUEUE_PACKETS_MAX; i++) {
+        midi_queue_flush();
+        tud_task();
+        packet_count += fake_usb_take_sent(&packets[packet_count], QUEUE_PACKETS_MAX - packet_count);
+    }
+    size_t note_offs = 0;
+    for (size_t i = 0; i < packet_count; i++) {
+        bool note_off = ((packets[i][1] & 0xF0) == 0x80 || packets[i][1] == 0x90);
+        if (note_off) {
+            CHECK_EQ(packets[i][2], note_offs);
+            note_offs++;
+        } else {
+            CHECK_EQ(note_offs, MIDI_QUEUE_EVENTS_MAX); // A controller after the note offs
+        }
+    }
+    CHECK_EQ(note_offs, MIDI_QUEUE_EVENTS_MAX);
+    CHECK_EQ(packet_count, MIDI_QUEUE_EVENTS_MAX + controllers + 1);
+    CHECK_EQ(packets[packet_count - 1][1], 0xB1);
+    CHECK_EQ(packets[packet_count - 1][3], (ordered - 1) & 0x7F); // The last value
+}
+
+/* Serial output */
+
+#define UART_BYTE_US    (10 * 1000000 / MIDI_UART_BAUD) // Start, eight data and stop bits
+
+static void test_uart_stream() {
+    uint8_t output[64];
+    midi_uart_init(0, 0);
+
+    // Running status, kept across note offs sent as note ons and across real-time messages
+    CHECK(midi_uart_write(0x90, 60, 100));
+    shim_advance_us(3 * UART_BYTE_US + 1);
+    CHECK(midi_uart_write(0x90, 64, 100));
+    CHECK(midi_uart_write(0xF8, 0, 0));
+    CHECK(midi_uart_write(0x80, 60, 0));
+    CHECK(midi_uart_write(0x80, 64, 64)); // A release velocity needs the note off status
+    CHECK(midi_uart_write(0xC0, 5, 0));
+    CHECK(midi_uart_write(0xC0, 6, 0));
+    CHECK(!midi_uart_write(0xF0, 0, 0)); // System exclusive does not go through here
+    shim_advance_us(20 * UART_BYTE_US);
+    midi_uart_task();
+    const uint8_t expected[] = {
+        0x90, 60, 100,
+        64, 100, 0xF8, 60, 0,
+        0x80, 64, 64,
+        0xC0, 5, 6,
+    };
+    CHECK_EQ(shim_dma_take_output(output, sizeof(output)), sizeof(expected));
+    CHECK(memcmp(output, expected, sizeof(expected)) == 0);
+
+    // Writes never wait for the line: a chord is buffered while the first note is sent
+    shim_advance_us(20 * UART_BYTE_US);
+    midi_uart_task();
+    for (uint8_t i = 0; i < 4; i++) { CHECK(midi_uart_write(0x91, 60 + i * 4, 100)); }
+    CHECK_EQ(shim_dma_take_output(output, sizeof(output)), 3);
+    shim_advance_us(3 * UART_BYTE_US + 1);
+    midi_uart_task();
+    CHECK_EQ(shim_dma_take_output(output, sizeof(output)), 6); // The other three in one transfer
+
+    // Once both buffers are full, messages are dropped and counted
+    uint32_t written = 0;
+    while (midi_uart_write(0x92, written & 0x7F, 1 + (written & 0x3F))) { written++; }
+    CHECK_EQ(written, 1 + (MIDI_UART_BUFFER_SIZE - 3) / 2); // One status byte, then two bytes per note
+    CHECK_EQ(midi_uart_get_dropped(), 1);
+    printf("uart: %d us per byte, %lu notes buffered during a transfer\n", UART_BYTE_US, (unsigned long)written);
+}
+
+int main() {
+    test_limiter_tilt_trace();
+    test_input_stream();
+    test_clock_jitter();
+    test_sysex_round_trip();
+    test_queue_note_off_priority();
+    test_mpe_allocation();
+    test_uart_stream();
+    return TEST_RESULT();
+}
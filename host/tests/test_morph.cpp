@@ -0,0 +1,81 @@
+/* Benchmark of the control change traffic of tilt morphing */
+
+#define main dodepan_main
+#include "main.cpp"
+#undef main
+
+#include <math.h>
+#include "shim.h"
+#include "MPU6050.h"
+#include "test.h"
+
+#define SETUP_US        2000000
+#define STILL_US        2200000 // The device lies still from here
+#define SWEEP_US        3000000 // Tilted back and forth from here
+#define SWEEP_PERIOD_US 500000
+#define STOP_US         5000000
+
+#define MAX_COMMITS_PER_S   (1000000 / MORPH_INTERVAL_US)
+
+static uint32_t still_changes;
+static uint32_t sweep_changes;
+static uint32_t sweep_commits;  // Buffers with morphed parameters
+static uint32_t largest_commit;
+static uint32_t commit_changes;
+static uint64_t commit_sample = UINT64_MAX;
+
+static void on_synth_event(const fake_synth_event_t *event) {
+    if (event->call != FAKE_SYNTH_CONTROL_CHANGE) { return; }
+    uint32_t now = time_us_32();
+    if (now >= STILL_US && now < SWEEP_US) { still_changes++; }
+    if (now < SWEEP_US || now >= STOP_US) { return; }
+    sweep_changes++;
+    if (event->sample != commit_sample) {
+        commit_sample = event->sample;
+        commit_changes = 0;
+        sweep_commits++;
+    }
+    if (++commit_changes > largest_commit) { largest_commit = commit_changes; }
+}
+
+static void on_idle(uint64_t now) {
+    static bool set_up;
+    if (!set_up && now >= SETUP_US) {
+        // Morph the Dodepan preset into a user preset that differs in every parameter
+        uint8_t params[PROGRAM_PARAMS_NUM];
+        for (uint8_t i = 0; i < PROGRAM_PARAMS_NUM; i++) {
+            params[i] = (dodepan_preset[i] + 64) & 0x7F;
+        }
+        CHECK(preset_bank_store(0, params, PROGRAM_PARAMS_NUM));
+        set_morph_slot(0);
+        update_morph();
+        note_on(0, 100);
+        set_up = true;
+    }
+    if (now >= SWEEP_US && now < STOP_US) {
+        double angle = 1.2 * sin(2.0 * M_PI * (now - SWEEP_US) / SWEEP_PERIOD_US);
+        fake_mpu6050_set_accel(MPU6050_I2C_PORT, MPU6050_ADDRESS, (int16_t)(16384 * sin(angle)), 0,
+                               (int16_t)(16384 * cos(angle))); // The module is mounted rotated, see config.h
+    }
+    if (now >= STOP_US) {
+        shim_stop();
+    }
+}
+
+int main() {
+    fake_mpu6050_set_accel(MPU6050_I2C_PORT, MPU6050_ADDRESS, 0, 0, 16384); // Lying flat
+    g_synth.fake_set_hook(on_synth_event);
+    shim_set_idle_hook(on_idle);
+    shim_run(dodepan_main);
+
+    double seconds = (STOP_US - SWEEP_US) / 1e6;
+    printf("sweeping: %.0f control changes/s, in %.0f commits/s, at most %lu at once\n",
+           sweep_changes / seconds, sweep_commits / seconds, (unsigned long)largest_commit);
+    CHECK(morph_is_active());
+    CHECK_EQ(still_changes, 0); // Nothing is sent while the tilt does not change
+    CHECK(sweep_changes > 0);
+    CHECK(sweep_commits <= MAX_COMMITS_PER_S * seconds + 1);
+    CHECK(largest_commit <= PROGRAM_PARAMS_NUM);
+    CHECK(sweep_changes <= (uint32_t)(MAX_COMMITS_PER_S * seconds * PROGRAM_PARAMS_NUM));
+    return TEST_RESULT();
+}
@@ -0,0 +1,119 @@
+/* Preset switches under a held note: applied at once by core1, without clicks */
+
+#define main dodepan_main
+#include "main.cpp"
+#undef main
+
+#include "shim.h"
+#include "MPU6050.h"
+#include "test.h"
+
+#define NOTE_ON_US      2000000
+#define STEADY_US       2100000 // Past the attack
+#define PROGRAM_US      2300000 // To a PRA32-U preset, with a program change
+#define PARAMS_US       2600000 // Back to the Dodepan preset, with all its parameters
+#define SWITCH_US       100000  // Time for a switch to be applied
+#define STOP_US         2700000
+
+// A click is a step between two consecutive samples. Steps are measured at the
+// switches, and compared with the largest step of the held note itself.
+typedef struct switch_step {
+    uint64_t sample;            // Sample the switch was applied at, 0 until then
+    int32_t step;               // Step into that sample, -1 until measured
+} switch_step_t;
+
+static switch_step_t program_switch = { 0, -1 };
+static switch_step_t params_switch = { 0, -1 };
+static int32_t steady_max_step;
+
+static inline int32_t get_step(int16_t from, int16_t to) {
+    int32_t step = to - from;
+    return (step < 0 ? -step : step);
+}
+
+static void measure_switch(switch_step_t *s, const int16_t *samples, uint frames, uint64_t first, int16_t last) {
+    if (s->sample == 0 || s->step >= 0 || s->sample < first || s->sample >= first + frames) { return; }
+    uint i = (uint)(s->sample - first);
+    s->step = get_step(i > 0 ? samples[(i - 1) * 2] : last, samples[i * 2]);
+}
+
+// Each buffer starts playing once core1 has rendered it, and before it renders the next one
+static void on_audio(const int16_t *samples, uint frames) {
+    static int16_t last_sample;
+    uint64_t first = g_synth.fake_get_samples() - frames;
+    uint32_t now = time_us_32();
+    if (now >= STEADY_US && now < PROGRAM_US) {
+        for (uint i = 0; i < frames; i++) {
+            int32_t step = get_step(i > 0 ? samples[(i - 1) * 2] : last_sample, samples[i * 2]);
+            if (step > steady_max_step) { steady_max_step = step; }
+        }
+    }
+    measure_switch(&program_switch, samples, frames, first, last_sample);
+    measure_switch(&params_switch, samples, frames, first, last_sample);
+    last_sample = samples[(frames - 1) * 2];
+}
+
+// Synth calls of the switches
+static uint32_t params_changes;
+static uint32_t params_changes_at_switch;
+static uint32_t params_changes_from_core0;
+static uint32_t params_changes_off_boundary;
+static uint32_t program_changes;
+
+static void on_synth_event(const fake_synth_event_t *event) {
+    uint32_t now = time_us_32();
+    if (event->call == FAKE_SYNTH_PROGRAM_CHANGE && now >= PROGRAM_US && now < PARAMS_US) {
+        if (program_changes++ == 0) { program_switch.sample = event->sample; }
+    }
+    if (event->call != FAKE_SYNTH_CONTROL_CHANGE || now < PARAMS_US || now >= PARAMS_US + SWITCH_US) { return; }
+    if (event->data1 == FILTER_CUTOFF) { return; } // Also driven by the tilt
+    if (params_changes++ == 0) { params_switch.sample = event->sample; }
+    if (event->sample == params_switch.sample) { params_changes_at_switch++; }
+    if (!event->from_core1) { params_changes_from_core0++; }
+    if (event->sample % AUDIO_BUFFER_LENGTH != 0) { params_changes_off_boundary++; }
+}
+
+static void on_idle(uint64_t now) {
+    static int step;
+    if (step == 0 && now >= NOTE_ON_US) {
+        note_on(0, 100);
+        step++;
+    } else if (step == 1 && now >= PROGRAM_US) {
+        set_instrument(1);
+        update_instrument();
+        step++;
+    } else if (step == 2 && now >= PARAMS_US) {
+        set_instrument(0);
+        update_instrument();
+        step++;
+    } else if (step == 3 && now >= STOP_US) {
+        shim_stop();
+    }
+}
+
+int main() {
+    fake_mpu6050_set_accel(MPU6050_I2C_PORT, MPU6050_ADDRESS, 0, 0, 16384); // Lying flat
+    g_synth.fake_set_hook(on_synth_event);
+    shim_set_audio_hook(on_audio);
+    shim_set_idle_hook(on_idle);
+    shim_run(dodepan_main);
+
+    // Each switch is applied by core1 at once, at a buffer boundary
+    CHECK_EQ(program_changes, 1);
+    CHECK(params_changes >= PROGRAM_PARAMS_NUM - 1);
+    CHECK_EQ(params_changes_at_switch, params_changes);
+    CHECK_EQ(params_changes_from_core0, 0);
+    CHECK_EQ(params_changes_off_boundary, 0);
+
+    // The switches do not click: the output is faded out before them and in after them
+    printf("largest step of the note %ld, at the switches %ld and %ld\n", (long)steady_max_step,
+           (long)program_switch.step, (long)params_switch.step);
+    CHECK(steady_max_step > 1000);
+    CHECK(program_switch.step >= 0);
+    CHECK(params_switch.step >= 0);
+#if defined (PRESET_SWITCH_FADE)
+    CHECK(program_switch.step < steady_max_step / 16);
+    CHECK(params_switch.step < steady_max_step / 16);
+#endif
+    return TEST_RESULT();
+}
@@ -0,0 +1,187 @@
+/* Dispatch of the chord mode and of the looper tracks to the synth and to Midi: chords on all
+ * the voices, more notes than voices, and four tracks with their own instrument and volume.
+ * The synth is the host fake: its render time says nothing of the core1 budget of the device,
+ * which is measured there with the profiler. */
+
+#define main dodepan_main
+#include "main.cpp"
+#undef main
+
+#include "shim.h"
+#include "mpr121.h"
+#include "MPU6050.h"
+#include "test.h"
+
+#define CHORD_ON_US     2000000 // A seventh chord, on all the voices
+#define CHORD_OFF_US    2300000
+#define CHORDS_ON_US    2500000 // Two seventh chords, more notes than voices
+#define CHORDS_OFF_US   2800000
+#define TRACKS_ON_US    3200000 // Four looper tracks, one note each
+#define TRACKS_OFF_US   4200000
+#define STOP_US         4600000
+#define LOOP_US         500000
+
+/* Midi sent over USB, with the time it was taken from the device */
+
+#define SENT_MAX    256
+
+static uint8_t sent[SENT_MAX][4];
+static uint32_t sent_us[SENT_MAX];
+static size_t sent_count;
+
+static void collect_sent() {
+    while (sent_count < SENT_MAX && fake_usb_take_sent(&sent[sent_count], 1) == 1) {
+        sent_us[sent_count++] = time_us_32();
+    }
+}
+
+/* Audio */
+
+typedef struct render_window {
+    uint32_t from_us;
+    uint32_t to_us;
+    uint32_t buffers;
+    int32_t peak;
+    uint8_t held_notes;         // Most notes gated in the synth at once
+} render_window_t;
+
+static render_window_t windows[] = {
+    { CHORD_ON_US - 200000, CHORD_ON_US },      // Silence
+    { CHORD_ON_US + 20000, CHORD_OFF_US },      // One chord
+    { CHORDS_ON_US + 20000, CHORDS_OFF_US },    // Two chords
+    { TRACKS_ON_US + 20000, TRACKS_OFF_US },    // Four tracks
+    { STOP_US - 100000, STOP_US },              // Released
+};
+#define WINDOWS (sizeof(windows) / sizeof(windows[0]))
+
+static void on_audio(const int16_t *samples, uint frames) {
+    uint32_t now = time_us_32();
+    for (size_t w = 0; w < WINDOWS; w++) {
+        render_window_t *window = &windows[w];
+        if (now < window->from_us || now >= window->to_us) { continue; }
+        window->buffers++;
+        uint8_t held_notes = g_synth.fake_get_held_notes();
+        if (held_notes > window->held_notes) { window->held_notes = held_notes; }
+        for (uint i = 0; i < frames * 2; i++) {
+            int32_t level = samples[i] < 0 ? -samples[i] : samples[i];
+            if (level > window->peak) { window->peak = level; }
+        }
+    }
+}
+
+/* Synth calls of the first chord */
+
+static uint32_t chord_notes;
+static uint64_t chord_sample = UINT64_MAX;
+static uint32_t chord_notes_apart;
+static uint32_t chord_notes_from_core0;
+
+static void on_synth_event(const fake_synth_event_t *event) {
+    uint32_t now = time_us_32();
+    if (event->call != FAKE_SYNTH_NOTE_ON || now < CHORD_ON_US || now >= CHORD_OFF_US) { return; }
+    if (chord_notes++ == 0) { chord_sample = event->sample; }
+    if (event->sample != chord_sample) { chord_notes_apart++; }
+    if (!event->from_core1) { chord_notes_from_core0++; }
+}
+
+// Load the tracks as from a SysEx dump: each one holds a note for most of the loop,
+// with its own instrument and volume
+static void load_tracks() {
+    uint8_t dump[LOOPER_DUMP_HEADER_SIZE + 2 * LOOPER_DUMP_EVENT_SIZE] = {
+        LOOP_US & 0xFF, (LOOP_US >> 8) & 0xFF, (LOOP_US >> 16) & 0xFF, 0, 2, 0, 0, 0,
+        0, 0, 0, 0, 0, 100, LOOPER_NOTE_ON,
+        0x80, 0x1A, 0x06, 0, 0, 0, LOOPER_NOTE_OFF, // At 400 ms
+    };
+    for (uint8_t t = 0; t < LOOPER_TRACKS; t++) {
+        dump[LOOPER_DUMP_HEADER_SIZE + 4] = t * 2;
+        dump[LOOPER_DUMP_HEADER_SIZE + LOOPER_DUMP_EVENT_SIZE + 4] = t * 2;
+        CHECK(looper_load(t, 0, dump, sizeof(dump), sizeof(dump)));
+        looper_set_track_instrument(t, t);
+        looper_set_track_volume(t, LOOPER_TRACK_VOLUME_MAX - t);
+    }
+}
+
+static void on_idle(uint64_t now) {
+    static int step;
+    collect_sent();
+    if (step == 0 && now >= CHORD_ON_US) {
+        set_chord_mode(CHORD_SEVENTH);
+        fake_mpr121_set_touched(1 << 0);
+        step++;
+    } else if (step == 1 && now >= CHORD_OFF_US) {
+        fake_mpr121_set_touched(0);
+        step++;
+    } else if (step == 2 && now >= CHORDS_ON_US) {
+        fake_mpr121_set_touched(1 << 0 | 1 << 2);
+        step++;
+    } else if (step == 3 && now >= CHORDS_OFF_US) {
+        fake_mpr121_set_touched(0);
+        step++;
+    } else if (step == 4 && now >= TRACKS_ON_US) {
+        set_chord_mode(CHORD_OFF);
+        looper_enable();
+        load_tracks();
+        looper_start_playback();
+        step++;
+    } else if (step == 5 && now >= TRACKS_OFF_US) {
+        looper_stop();
+        step++;
+    } else if (step == 6 && now >= STOP_US) {
+        shim_stop();
+    }
+}
+
+int main() {
+    fake_mpu6050_set_accel(MPU6050_I2C_PORT, MPU6050_ADDRESS, 0, 0, 16384); // Lying flat
+    g_synth.fake_set_hook(on_synth_event);
+    shim_set_audio_hook(on_audio);
+    shim_set_idle_hook(on_idle);
+    shim_run(dodepan_main);
+
+    for (size_t w = 0; w < WINDOWS; w++) {
+        CHECK(windows[w].buffers > 0);
+    }
+    CHECK_EQ(windows[0].held_notes, 0);
+
+    // A chord is dispatched at once: its notes start on the same sample,
+    // and go out to Midi together
+    CHECK_EQ(chord_notes, 4);
+    CHECK_EQ(chord_notes_apart, 0);
+    CHECK_EQ(chord_notes_from_core0, 0);
+    int chord_messages = 0;
+    uint32_t chord_sent_us = 0;
+    for (size_t i = 0; i < sent_count; i++) {
+        if (sent_us[i] < CHORD_ON_US || sent_us[i] >= CHORD_OFF_US || (sent[i][1] & 0xF0) != 0x90) { continue; }
+        if (chord_messages++ == 0) { chord_sent_us = sent_us[i]; }
+        CHECK_EQ(sent_us[i], chord_sent_us);
+    }
+    CHECK_EQ(chord_messages, 4);
+
+    // More notes than voices: they all reach the synth, which keeps sounding
+    CHECK_EQ(windows[1].held_notes, 4);
+    CHECK(windows[2].held_notes > FAKE_SYNTH_VOICES);
+    CHECK(windows[2].peak > 1000);
+
+    // The tracks share the voices of the synth, and each one has its Midi channel and instrument
+    CHECK(windows[3].peak > 1000);
+    CHECK_EQ(windows[3].held_notes, LOOPER_TRACKS);
+#if !defined (MIDI_MPE)
+    for (uint8_t t = 0; t < LOOPER_TRACKS; t++) {
+        int notes = 0;
+        int programs = 0;
+        for (size_t i = 0; i < sent_count; i++) {
+            if (sent_us[i] < TRACKS_ON_US || sent_us[i] >= TRACKS_OFF_US) { continue; }
+            if (sent[i][1] == (0x90 | t)) { notes++; }
+            if (sent[i][1] == (0xC0 | t) && sent[i][2] == t) { programs++; }
+        }
+        CHECK_EQ(notes, (TRACKS_OFF_US - TRACKS_ON_US) / LOOP_US);
+        CHECK(programs >= 1);
+    }
+#endif
+
+    // Nothing hangs after the release
+    CHECK_EQ(windows[4].held_notes, 0);
+    CHECK_EQ(g_synth.fake_get_held_notes(), 0);
+    CHECK(windows[4].peak < windows[3].peak / 4); // Fading out with the release
+    return TEST_RESULT();
+}
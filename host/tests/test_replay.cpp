@@ -0,0 +1,117 @@
+/* Replay of a recorded input trace, compared with the output of a known good run.
+ * Usage: test_replay <trace file> <expected output file>
+ * The trace is in the format printed by the d command of the input trace.
+ * The output is written to replay.out: after a change that is meant to alter
+ * it, check it and copy it over the expected output file. */
+
+#define INPUT_TRACE
+#define main dodepan_main
+#include "main.cpp"
+#undef main
+
+#include <string>
+#include "shim.h"
+#include "MPU6050.h"
+#include "test.h"
+
+#define REPLAY_US   2000000 // Past the intro
+#define TAIL_US     500000  // Kept running after the end of the replay, for the releases
+
+static const char *trace_path;
+static bool trace_loaded;
+static std::string synth_output;
+static uint64_t replay_sample;
+static bool replay_started;
+static uint64_t replay_done_us;
+
+static void on_synth_event(const fake_synth_event_t *event) {
+    if (!replay_started) { return; }
+    char line[64];
+    snprintf(line, sizeof(line), "synth %llu %d %02x %02x\n",
+             (unsigned long long)(event->sample - replay_sample), (int)event->call, event->data1, event->data2);
+    synth_output += line;
+}
+
+static bool load_trace(const char *path);
+
+static void on_idle(uint64_t now) {
+    if (!replay_started) {
+        if (now < REPLAY_US) { return; }
+        trace_loaded = load_trace(trace_path);
+        shim_stdin_push("p"); // Same as on the serial console
+        replay_sample = g_synth.fake_get_samples();
+        replay_started = true;
+    } else if (replay_done_us == 0) {
+        if (input_trace_is_replaying() || now < REPLAY_US + TOUCH_PERIOD_US) { return; }
+        replay_done_us = now;
+    } else if (now >= replay_done_us + TAIL_US) {
+        shim_stop();
+    }
+}
+
+static bool load_trace(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) { return false; }
+    char line[64];
+    unsigned long timestamp, data;
+    unsigned source;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (sscanf(line, "in %lu %u %lx", &timestamp, &source, &data) != 3) { continue; }
+        CHECK(input_trace_add(timestamp, (trace_source_t)source, data));
+    }
+    fclose(file);
+    return true;
+}
+
+static std::string read_file(const char *path) {
+    std::string text;
+    FILE *file = fopen(path, "r");
+    if (file == NULL) { return text; }
+    char buffer[256];
+    size_t length;
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0) { text.append(buffer, length); }
+    fclose(file);
+    return text;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <trace file> <expected output file>\n", argv[0]);
+        return 2;
+    }
+    fake_mpu6050_set_accel(MPU6050_I2C_PORT, MPU6050_ADDRESS, 0, 0, 16384); // Lying flat
+    g_synth.fake_set_hook(on_synth_event);
+    trace_path = argv[1];
+    shim_set_idle_hook(on_idle);
+    shim_run(dodepan_main);
+    CHECK(trace_loaded);
+
+    std::string output;
+    const trace_output_t *outputs;
+    uint16_t count = input_trace_get_outputs(&outputs);
+    for (uint16_t i = 0; i < count; i++) {
+        char line[64];
+        snprintf(line, sizeof(line), "out %lu %02x %02x %02x\n", (unsigned long)outputs[i].timestamp,
+                 outputs[i].data[0], outputs[i].data[1], outputs[i].data[2]);
+        output += line;
+    }
+    output += synth_output;
+    FILE *file = fopen("replay.out", "w");
+    CHECK(file != NULL);
+    if (file != NULL) {
+        fputs(output.c_str(), file);
+        fclose(file);
+    }
+
+    CHECK(count > 0);
+    std::string expected = read_file(argv[2]);
+    if (output != expected) {
+        size_t line = 1;
+        for (size_t i = 0; i < output.size() && i < expected.size() && output[i] == expected[i]; i++) {
+            if (output[i] == '\n') { line++; }
+        }
+        fprintf(stderr, "replay.out differs from %s from line %zu\n", argv[2], line);
+        test_failures++;
+    }
+    return TEST_RESULT();
+}
@@ -0,0 +1,669 @@
+/* The host shim, and the modules built on it: touch, IMU, encoder, state, looper, input trace, display and profiler */
+
+#include <math.h>
+#include <string.h>
+#include <time.h>
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+#include "shim.h"
+#include "mpr121.h"
+#include "MPU6050.h"
+#include "config.h"
+#include "state.h"
+#include "scales.h"
+#include "touch.h"
+#include "imu.h"
+#include "encoder_accel.h"
+#include "looper.h"
+#include "seq.h"
+#include "display.h"
+#include "preset_bank.h"
+#include "synth_queue.h"
+#include "input_trace.h"
+#include "profiler.h"
+#include "hardware/clocks.h"
+#include "hardware/structs/systick.h"
+#include "test.h"
+
+/* Callbacks of the modules under test */
+
+uint8_t **user_scales;
+
+static int touched_on[12];
+static int touched_off[12];
+
+void touch_on(uint8_t id) { touched_on[id]++; }
+void touch_off(uint8_t id) { touched_off[id]++; }
+
+static int looper_notes_on;
+static int looper_notes_off;
+static uint8_t looper_last_id;
+
+// Notes held by the looper, with the time they started, to find the hanging ones
+static uint8_t looper_held[NUM_NOTE_IDS];
+static uint32_t looper_held_since[NUM_NOTE_IDS];
+static uint32_t looper_unmatched_offs;  // Note offs of notes not held
+static uint32_t looper_longest_note_us;
+
+static void update_longest_notes() {
+    for (uint8_t id = 0; id < NUM_NOTE_IDS; id++) {
+        uint32_t held_us = time_us_32() - looper_held_since[id];
+        if (looper_held[id] > 0 && held_us > looper_longest_note_us) { looper_longest_note_us = held_us; }
+    }
+}
+
+void all_notes_off() {
+    update_longest_notes();
+    memset(looper_held, 0, sizeof(looper_held));
+}
+
+void looper_note_on(uint8_t track, uint8_t id, uint8_t velocity) {
+    looper_notes_on++;
+    looper_last_id = id;
+    if (looper_held[id]++ == 0) { looper_held_since[id] = time_us_32(); }
+}
+
+void looper_note_off(uint8_t track, uint8_t id) {
+    looper_notes_off++;
+    if (looper_held[id] == 0) {
+        looper_unmatched_offs++;
+        return;
+    }
+    uint32_t held_us = time_us_32() - looper_held_since[id];
+    if (held_us > looper_longest_note_us) { looper_longest_note_us = held_us; }
+    looper_held[id]--;
+}
+void looper_track_notes_off(uint8_t track) { all_notes_off(); } // Held here for all the tracks together
+void looper_track_start(uint8_t track, uint8_t instrument) {}
+void looper_tilt(looper_event_type_t type, uint16_t value) {}
+void send_midi_realtime(uint8_t status) {}
+void seq_output(const scheduled_note_t *event) {}
+void seq_automate(uint8_t cutoff) {}
+
+static uint32_t applied_data[8];
+static uint32_t applied_us[8];
+static int applied;
+
+void input_trace_apply(trace_source_t source, uint32_t data) {
+    if (applied < 8) {
+        applied_data[applied] = ((uint32_t)source << INPUT_TRACE_SOURCE_SHIFT) | data;
+        applied_us[applied] = time_us_32();
+    }
+    applied++;
+}
+
+/* Tests */
+
+static int alarm_fired;
+static uint32_t alarm_time;
+
+static int64_t on_alarm(alarm_id_t id, void *user_data) {
+    alarm_fired++;
+    alarm_time = time_us_32();
+    return 0;
+}
+
+static int64_t on_repeating_alarm(alarm_id_t id, void *user_data) {
+    alarm_fired++;
+    return (alarm_fired < 3 ? -1000 : 0); // Twice more, 1 ms apart
+}
+
+static void test_clock_and_alarms() {
+    uint32_t start = time_us_32();
+    add_alarm_in_ms(10, on_alarm, NULL, true);
+    alarm_id_t cancelled = add_alarm_in_ms(5, on_alarm, NULL, true);
+    CHECK(cancel_alarm(cancelled));
+    shim_advance_us(9999);
+    CHECK_EQ(alarm_fired, 0);
+    shim_advance_us(1);
+    CHECK_EQ(alarm_fired, 1);
+    CHECK_EQ(alarm_time - start, 10000);
+
+    alarm_fired = 0;
+    add_alarm_in_us(500, on_repeating_alarm, NULL, true);
+    sleep_ms(10);
+    CHECK_EQ(alarm_fired, 3);
+}
+
+static void test_touch() {
+    mpr121_i2c_init();
+    shim_advance_to_us(1000000); // Past the calibration time
+
+    fake_mpr121_set_touched(1 << 3);
+    mpr121_task();
+    CHECK_EQ(touched_on[3], 1);
+
+    // The release only comes out of the debouncing after MPR121_DEBOUNCE_MS of readings
+    fake_mpr121_set_touched(0);
+    int readings = 0;
+    while (touched_off[3] == 0 && readings < 1000) {
+        mpr121_task();
+        readings++;
+    }
+    CHECK_EQ(touched_off[3], 1);
+    CHECK_EQ(readings, MPR121_DEBOUNCE_MS * 1000 / TOUCH_PERIOD_US);
+}
+
+static void test_imu() {
+    Imu_data data;
+    imu_init();
+
+    fake_mpu6050_set_accel(MPU6050_I2C_PORT, MPU6050_ADDRESS, 0, 0, 16384); // Lying flat
+    imu_task(&data);
+    CHECK(data.deviation_x > 0x2000 - 0x100 && data.deviation_x < 0x2000 + 0x100);
+    uint8_t flat_y = data.deviation_y;
+
+    fake_mpu6050_set_accel(MPU6050_I2C_PORT, MPU6050_ADDRESS, 8000, 0, 14000); // Tilted
+    imu_task(&data);
+    CHECK(data.deviation_y != flat_y);
+}
+
+static void test_encoder_accel() {
+    encoder_accel_t accel;
+    encoder_accel_init(&accel, ENCODER_ACCEL_SLOW_US, ENCODER_ACCEL_FAST_US, ENCODER_ACCEL_MAX_STEPS);
+
+    // The curve goes from one step to the maximum, never down, slowly at first
+    CHECK_EQ(encoder_accel_get_steps(&accel, ENCODER_ACCEL_SLOW_US), 1);
+    CHECK_EQ(encoder_accel_get_steps(&accel, ENCODER_ACCEL_FAST_US), ENCODER_ACCEL_MAX_STEPS);
+    CHECK_EQ(encoder_accel_get_steps(&accel, 0), ENCODER_ACCEL_MAX_STEPS);
+    uint8_t last_steps = 1;
+    for (uint32_t interval = ENCODER_ACCEL_SLOW_US; interval >= ENCODER_ACCEL_FAST_US; interval -= 100) {
+        uint8_t steps = encoder_accel_get_steps(&accel, interval);
+        CHECK(steps >= last_steps);
+        last_steps = steps;
+    }
+    uint8_t middle = encoder_accel_get_steps(&accel, (ENCODER_ACCEL_SLOW_US + ENCODER_ACCEL_FAST_US) / 2);
+    CHECK(middle < 1 + ENCODER_ACCEL_MAX_STEPS / 2);
+
+    // A fast sweep covers the range of a parameter in a fraction of the detents,
+    // slow turns and reversals still move by one step
+    int steps = 0;
+    int detents = 0;
+    uint32_t now = 1000000;
+    encoder_accel_update(&accel, 1, now);
+    while (steps < 127) {
+        now += ENCODER_ACCEL_FAST_US;
+        steps += encoder_accel_update(&accel, 1, now);
+        detents++;
+    }
+    CHECK(detents <= 127 / ENCODER_ACCEL_MAX_STEPS + 1);
+    CHECK_EQ(encoder_accel_update(&accel, -1, now + ENCODER_ACCEL_FAST_US), -1);
+    CHECK_EQ(encoder_accel_update(&accel, -1, now + ENCODER_ACCEL_FAST_US + ENCODER_ACCEL_SLOW_US), -1);
+
+    // Disabled
+    encoder_accel_init(&accel, ENCODER_ACCEL_SLOW_US, ENCODER_ACCEL_FAST_US, 1);
+    CHECK_EQ(encoder_accel_get_steps(&accel, 0), 1);
+}
+
+static void test_state() {
+    static uint8_t scale_slots[NUM_SCALE_SLOTS][12];
+    static uint8_t *scale_pointers[NUM_SCALE_SLOTS];
+    for (uint8_t i = 0; i < NUM_SCALE_SLOTS; i++) { scale_pointers[i] = scale_slots[i]; }
+    user_scales = scale_pointers;
+
+    set_key(60);
+    set_tuning(0);
+    set_and_extend_scale(0); // Major
+    CHECK_EQ(get_note_by_id(0), 60);
+    CHECK_EQ(get_note_by_id(1), 62);
+    CHECK_EQ(get_note_by_id(2), 64);
+    set_key(62);
+    CHECK_EQ(get_note_by_id(0), 62);
+
+    // Each note of a chord is tuned after its own degree
+    uint8_t notes[CHORD_NOTES_MAX];
+    int8_t cents[CHORD_NOTES_MAX];
+    set_key(60);
+    set_tuning(1); // Just intonation
+    set_chord_mode(CHORD_TRIAD);
+    CHECK_EQ(get_chord_by_id(0, notes, cents), 3);
+    CHECK_EQ(notes[1], 64);
+    CHECK_EQ(cents[0], 0);
+    CHECK_EQ(cents[1], -14); // Major third
+    CHECK_EQ(cents[2], 2);   // Fifth
+    CHECK_EQ(get_chord_by_id(1, notes, cents), 3);
+    CHECK_EQ(cents[0], 4);   // Second
+    CHECK_EQ(cents[1], -2);  // Fourth
+    CHECK_EQ(cents[2], -16); // Sixth
+    set_chord_mode(CHORD_OFF);
+    set_tuning(0);
+}
+
+// Note of an id as it was computed on each note before the note map
+static uint8_t compute_note(uint8_t id) {
+    uint16_t note = get_key() + get_extended_scale(id % 12) + id / 12 * 12;
+    while (note > 127) { note -= 12; }
+    return (uint8_t)note;
+}
+
+static double get_seconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static void test_note_map() {
+    // The map follows every change of the key, scale and degrees
+    uint32_t mismatches = 0;
+    for (uint8_t scale = 0; scale < NUM_SCALES_BUILTIN; scale++) {
+        set_and_extend_scale(scale);
+        for (uint8_t key = 24; key <= 120; key += 7) {
+            set_key(key);
+            for (uint8_t id = 0; id < NUM_NOTE_IDS; id++) {
+                if (get_note_by_id(id) != compute_note(id)) { mismatches++; }
+            }
+        }
+    }
+    set_degree(3, 24);
+    for (uint8_t id = 0; id < NUM_NOTE_IDS; id++) {
+        if (get_note_by_id(id) != compute_note(id)) { mismatches++; }
+    }
+    CHECK_EQ(mismatches, 0);
+
+    // Benchmark of the lookup, against the computation it replaces
+    const uint32_t lookups = 10000000;
+    volatile uint32_t sink = 0;
+    double start = get_seconds();
+    for (uint32_t i = 0; i < lookups; i++) { sink += get_note_by_id(i % NUM_NOTE_IDS); }
+    double lookup_s = get_seconds() - start;
+    start = get_seconds();
+    for (uint32_t i = 0; i < lookups; i++) { sink += compute_note(i % NUM_NOTE_IDS); }
+    double compute_s = get_seconds() - start;
+    printf("note map: %.2f ns per lookup, %.2f ns computed\n", lookup_s * 1e9 / lookups, compute_s * 1e9 / lookups);
+
+    set_key(60);
+    set_and_extend_scale(0);
+}
+
+static void test_looper() {
+    looper_init(LOOPER_EVENTS_MAX);
+    looper_enable();
+    CHECK(looper_is_ready());
+
+    looper_record(5, 100, true);
+    CHECK(looper_is_recording());
+    shim_advance_us(200000);
+    looper_record(5, 0, false);
+    shim_advance_us(300000);
+    looper_onpress(); // 500 ms loop
+    CHECK(looper_is_playing());
+
+    // Two passes of the loop, one note each
+    for (int i = 0; i < 1000; i++) {
+        looper_task();
+        shim_advance_us(1000);
+    }
+    CHECK_EQ(looper_notes_on, 2);
+    CHECK_EQ(looper_notes_off, 2);
+    CHECK_EQ(looper_last_id, 5);
+
+    // Transposed by a lookup, wrapping around the pads
+    for (int i = 0; i < 8; i++) { looper_transpose_up(); }
+    for (int i = 0; i < 500; i++) {
+        looper_task();
+        shim_advance_us(1000);
+    }
+    CHECK_EQ(looper_notes_on, 3);
+    CHECK_EQ(looper_last_id, 1);
+}
+
+static void test_input_trace() {
+    const uint32_t period_us = 1000; // Of the main loop
+    input_trace_init(4, 4);
+
+    // Record a few inputs, as the firmware does after debouncing
+    shim_stdin_push("r");
+    input_trace_task();
+    shim_advance_us(10000);
+    input_trace_record(TRACE_TOUCH, 0x13);
+    shim_advance_us(250000);
+    input_trace_record(TRACE_ENCODER, 2);
+    input_trace_record(TRACE_BUTTON, 1);
+    input_trace_log_output(0x90, 60, 100);
+    input_trace_record(TRACE_TOUCH, 0x03);
+    input_trace_record(TRACE_TOUCH, 0x14); // Over the limit, ends the recording
+    input_trace_log_output(0x80, 60, 0);
+    const trace_output_t *outputs;
+    CHECK_EQ(input_trace_get_outputs(&outputs), 1);
+    CHECK_EQ(outputs[0].timestamp, 260000);
+
+    // Replay them in order, each within a period of the main loop of its time
+    shim_stdin_push("p");
+    uint32_t replay_start = time_us_32();
+    for (int i = 0; i < 400 && (i == 0 || input_trace_is_replaying()); i++) {
+        input_trace_task();
+        shim_advance_us(period_us);
+    }
+    CHECK(!input_trace_is_replaying());
+    CHECK_EQ(applied, 4);
+    CHECK_EQ(applied_data[0], ((uint32_t)TRACE_TOUCH << INPUT_TRACE_SOURCE_SHIFT) | 0x13);
+    CHECK_EQ(applied_data[1], ((uint32_t)TRACE_ENCODER << INPUT_TRACE_SOURCE_SHIFT) | 2);
+    CHECK_EQ(applied_data[3], ((uint32_t)TRACE_TOUCH << INPUT_TRACE_SOURCE_SHIFT) | 0x03);
+    CHECK(applied_us[0] - replay_start >= 10000 && applied_us[0] - replay_start < 10000 + period_us);
+    CHECK(applied_us[2] - replay_start >= 260000 && applied_us[2] - replay_start < 260000 + period_us);
+}
+
+/* A minute of tilt gestures recorded by the looper, which records tilt for about 10 s of it */
+
+typedef enum gesture {
+    GESTURE_STILL,              // Held in the hand, with sensor noise
+    GESTURE_SLOW,               // A slow swell, back and forth every 4 s
+    GESTURE_FAST,               // A wobble, twice per second
+    GESTURE_LAST,
+} gesture_t;
+
+#define GESTURE_US  60000000
+
+typedef struct gesture_recording {
+    uint16_t tilt_events;
+    uint32_t last_tilt_us;      // Time of the last tilt event in the loop
+    bool note_off_recorded;
+} gesture_recording_t;
+
+static uint32_t read_dump(uint16_t offset, uint8_t length) {
+    uint8_t bytes[4];
+    looper_dump(0, offset, bytes, length);
+    uint32_t value = 0;
+    for (uint8_t i = 0; i < length; i++) { value |= (uint32_t)bytes[i] << (i * 8); }
+    return value;
+}
+
+static gesture_recording_t record_gesture(gesture_t gesture) {
+    const double periods_s[GESTURE_LAST] = { 0.0, 4.0, 0.5 };
+    gesture_recording_t recording = { 0, 0, false };
+    looper_disable();
+    looper_enable();
+    looper_record(5, 100, true);
+    for (uint32_t t = 0; t < GESTURE_US; t += IMU_PERIOD_US) {
+        double swing = (gesture == GESTURE_STILL ? 0.0 : sin(2.0 * M_PI * t / 1e6 / periods_s[gesture]));
+        int16_t noise = (int16_t)((t / IMU_PERIOD_US * 37) % 33) - 16; // Well under the thresholds
+        looper_record_tilt(LOOPER_BEND, (uint16_t)(0x2000 + 6000 * swing + noise));
+        looper_record_tilt(LOOPER_CUTOFF, (uint16_t)(64 + 50 * swing));
+        shim_advance_us(IMU_PERIOD_US);
+    }
+    looper_record(5, 0, false);
+    looper_onpress(); // Ends the recording
+
+    uint16_t events = (looper_get_dump_size(0) - LOOPER_DUMP_HEADER_SIZE) / LOOPER_DUMP_EVENT_SIZE;
+    for (uint16_t i = 0; i < events; i++) {
+        uint16_t offset = LOOPER_DUMP_HEADER_SIZE + i * LOOPER_DUMP_EVENT_SIZE;
+        uint8_t type = read_dump(offset + 6, 1);
+        if (type == LOOPER_BEND || type == LOOPER_CUTOFF) {
+            recording.tilt_events++;
+            recording.last_tilt_us = read_dump(offset, 4);
+        } else if (type == LOOPER_NOTE_OFF) {
+            recording.note_off_recorded = true;
+        }
+    }
+    looper_disable();
+    return recording;
+}
+
+static void test_looper_tilt_memory() {
+    const uint16_t tilt_events_max = LOOPER_EVENTS_MAX / LOOPER_TRACKS * 3 / 4; // A quarter is left for the notes
+    const double lane_rate_max = 1e6 / LOOPER_TILT_INTERVAL_US; // Events per second of each lane
+    const double coverage_min = tilt_events_max / (2 * lane_rate_max); // Both lanes at their limit, about 10 s
+    const char *names[GESTURE_LAST] = { "still", "slow", "fast" };
+    gesture_recording_t recordings[GESTURE_LAST];
+    double rates[GESTURE_LAST];
+    double coverages[GESTURE_LAST];
+    for (uint8_t g = 0; g < GESTURE_LAST; g++) {
+        recordings[g] = record_gesture((gesture_t)g);
+        bool full = (recordings[g].tilt_events + 1 >= tilt_events_max); // Along with the note on
+        // Tilt is recorded up to the last tilt event when the track is full, for the whole gesture otherwise
+        coverages[g] = (full ? recordings[g].last_tilt_us / 1e6 : GESTURE_US / 1e6);
+        rates[g] = recordings[g].tilt_events / coverages[g];
+        printf("looper tilt, %-5s: %u events, tilt recorded for %.1f s of the %.0f s gesture\n", names[g],
+               recordings[g].tilt_events, coverages[g], GESTURE_US / 1e6);
+
+        // The memory is bounded, and the notes can still be recorded
+        CHECK(recordings[g].tilt_events <= tilt_events_max);
+        CHECK(recordings[g].note_off_recorded);
+        CHECK(recordings[g].tilt_events <= 2 * (coverages[g] * lane_rate_max + 1)); // Both lanes at their limit
+        CHECK(coverages[g] >= coverage_min - 0.1);
+    }
+    // Nothing but the starting values when still
+    CHECK(recordings[GESTURE_STILL].tilt_events <= 4);
+    CHECK(rates[GESTURE_SLOW] > 1.0);
+    CHECK(rates[GESTURE_FAST] >= rates[GESTURE_SLOW]);
+    // Continuous motion fills the tilt share of the track before the end of the minute
+    CHECK(coverages[GESTURE_FAST] < 2 * coverage_min);
+    CHECK(coverages[GESTURE_SLOW] < GESTURE_US / 1e6);
+}
+
+/* Looper playback at every speed, in both directions */
+
+#define HANG_LOOP_US    400000
+
+// Overlapping notes, a note played twice, a note held past the end of the
+// recording and one started before it
+static void record_hang_loop() {
+    looper_enable();
+    looper_record(7, 100, false); // Started before the recording: not recorded
+    looper_record(1, 100, true);
+    shim_advance_us(50000);
+    looper_record(2, 90, true);
+    shim_advance_us(50000);
+    looper_record(1, 0, false);
+    shim_advance_us(50000);
+    looper_record(1, 80, true);
+    shim_advance_us(50000);
+    looper_record(3, 70, true);
+    shim_advance_us(50000);
+    looper_record(1, 0, false);
+    shim_advance_us(50000);
+    looper_record(2, 0, false);
+    shim_advance_us(100000);
+    looper_onpress(); // Ends the recording and note 3 with it, plays back
+}
+
+static void run_looper_us(uint32_t duration_us) {
+    for (uint32_t t = 0; t < duration_us; t += LOOPER_PERIOD_US) {
+        looper_task();
+        shim_advance_us(LOOPER_PERIOD_US);
+    }
+}
+
+static uint8_t count_looper_held() {
+    uint8_t count = 0;
+    for (uint8_t id = 0; id < NUM_NOTE_IDS; id++) { count += looper_held[id]; }
+    return count;
+}
+
+static void test_looper_playback_modes() {
+    looper_disable();
+    record_hang_loop();
+    CHECK(looper_is_playing());
+
+    // Three passes in each mode, from the start of the loop. No note is held
+    // for longer than the loop, and the pairs of note on and off hold.
+    const uint32_t pass_us[LOOPER_SPEED_LAST] = { 2 * HANG_LOOP_US, HANG_LOOP_US, HANG_LOOP_US / 2 };
+    for (uint8_t reverse = 0; reverse < 2; reverse++) {
+        for (uint8_t speed = 0; speed < LOOPER_SPEED_LAST; speed++) {
+            looper_stop();
+            looper_set_playback((looper_speed_t)speed, reverse);
+            looper_notes_on = 0;
+            looper_notes_off = 0;
+            looper_longest_note_us = 0;
+            looper_start_playback();
+            run_looper_us(3 * pass_us[speed] + pass_us[speed] / 8);
+            update_longest_notes();
+            CHECK(looper_notes_on >= 3 * 4);
+            CHECK_EQ(looper_notes_on - looper_notes_off, count_looper_held());
+            CHECK(looper_longest_note_us < pass_us[speed]);
+            CHECK_EQ(looper_unmatched_offs, 0);
+        }
+    }
+
+    // Switching modes in the middle of notes, at odd times. The notes are ended
+    // at the switch, so the note offs ahead of it may find them ended already.
+    looper_stop();
+    looper_set_playback(LOOPER_SPEED_NORMAL, false);
+    looper_start_playback();
+    looper_longest_note_us = 0;
+    for (uint8_t i = 0; i < 40; i++) {
+        run_looper_us(37000 + (i * 23000) % 110000);
+        looper_set_playback((looper_speed_t)(i % LOOPER_SPEED_LAST), (i / LOOPER_SPEED_LAST) % 2);
+    }
+    update_longest_notes();
+    CHECK(looper_longest_note_us < 2 * HANG_LOOP_US);
+    looper_disable();
+}
+
+static void test_display() {
+    static ssd1306_t display; // The dimming alarm keeps a pointer to it
+    i2c_init(SSD1306_I2C_PORT, SSD1306_I2C_FREQ);
+    display_init(&display);
+    uint32_t shows = fake_ssd1306_get_shows();
+    uint32_t bytes = shim_i2c_get_bytes(SSD1306_I2C_PORT);
+
+    set_context(CTX_SELECTION);
+    display_draw(&display);
+    CHECK_EQ(fake_ssd1306_get_shows(), shows + 1);
+    CHECK(shim_i2c_get_bytes(SSD1306_I2C_PORT) - bytes >= SSD1306_WIDTH * SSD1306_HEIGHT / 8);
+
+    // The automatic dimming runs on an alarm
+    set_contrast(CONTRAST_AUTO);
+    display_update_contrast(&display);
+    CHECK_EQ(fake_ssd1306_get_contrast(), 255);
+    shim_advance_us(DISPLAY_DIM_DELAY * 1000000);
+    CHECK_EQ(fake_ssd1306_get_contrast(), 0);
+}
+
+static void test_synth_queue() {
+    synth_event_t event;
+    synth_queue_push(1000, SYNTH_NOTE_ON, 60, 100);
+    synth_queue_push(500, SYNTH_NOTE_ON, 62, 100); // Pushed later, due earlier
+    synth_queue_push(1000, SYNTH_NOTE_OFF, 60, 0);
+
+    CHECK(!synth_queue_pop_due(499, &event));
+    CHECK(synth_queue_pop_due(500, &event));
+    CHECK_EQ(event.data1, 62);
+    CHECK(!synth_queue_pop_due(999, &event));
+
+    // Events due at the same time keep their order
+    CHECK(synth_queue_pop_due(1000, &event));
+    CHECK_EQ(event.type, SYNTH_NOTE_ON);
+    CHECK(synth_queue_pop_due(1000, &event));
+    CHECK_EQ(event.type, SYNTH_NOTE_OFF);
+    CHECK(!synth_queue_pop_due(1000, &event));
+
+    // A full queue drops the new events, and counts them
+    for (int i = 0; i < SYNTH_QUEUE_SIZE + 1; i++) {
+        synth_queue_push(2000 + i, SYNTH_NOTE_ON, 60, 100);
+    }
+    CHECK_EQ(synth_queue_get_dropped(), 1);
+    int received = 0;
+    uint32_t last_time = 0;
+    while (synth_queue_pop_due(10000, &event)) {
+        CHECK(event.time_us >= last_time);
+        last_time = event.time_us;
+        received++;
+    }
+    CHECK_EQ(received, SYNTH_QUEUE_SIZE);
+}
+
+static void test_flash() {
+    const uint8_t *stored = (const uint8_t *)(XIP_BASE + FLASH_TARGET_OFFSET);
+    uint8_t page[FLASH_PAGE_SIZE];
+    memset(page, 0x5A, sizeof(page));
+    CHECK_EQ(stored[0], 0xFF);
+
+    flash_range_erase(FLASH_TARGET_OFFSET, FLASH_SECTOR_SIZE);
+    flash_range_program(FLASH_TARGET_OFFSET, page, FLASH_PAGE_SIZE);
+    CHECK_EQ(stored[0], 0x5A);
+    CHECK_EQ(shim_flash_get_program_errors(), 0);
+
+    // Programming again without erasing can't set the cleared bits
+    memset(page, 0xA5, sizeof(page));
+    flash_range_program(FLASH_TARGET_OFFSET, page, FLASH_PAGE_SIZE);
+    CHECK(shim_flash_get_program_errors() > 0);
+}
+
+static void test_preset_bank() {
+    uint8_t params[PRESET_RECORD_SIZE - 1];
+    const uint8_t slots_per_sector = FLASH_SECTOR_SIZE / PRESET_RECORD_SIZE;
+    preset_bank_init();
+    CHECK(!preset_bank_is_used(1));
+
+    // Stored in RAM first, readable before the flash write
+    memset(params, 7, sizeof(params));
+    CHECK(preset_bank_store(1, params, sizeof(params)));
+    CHECK(preset_bank_has_changes());
+    CHECK_EQ(preset_bank_get(1)[0], 7);
+
+    // Both sectors can be pending at once, and are written together
+    memset(params, 9, sizeof(params));
+    CHECK(preset_bank_store(slots_per_sector + 1, params, sizeof(params)));
+    CHECK_EQ(preset_bank_get(slots_per_sector + 1)[0], 9);
+    CHECK_EQ(preset_bank_get(1)[0], 7);
+    uint32_t erases = shim_flash_get_erases();
+    preset_bank_flush();
+    CHECK_EQ(shim_flash_get_erases(), erases + 2);
+    CHECK(!preset_bank_has_changes());
+    CHECK_EQ(preset_bank_get(1), (const uint8_t *)(XIP_BASE + PRESET_BANK_OFFSET + PRESET_RECORD_SIZE + 1));
+    CHECK_EQ(preset_bank_get(1)[0], 7);
+    CHECK_EQ(preset_bank_get(slots_per_sector + 1)[0], 9);
+    CHECK_EQ(shim_flash_get_program_errors(), 0);
+
+    // Nothing is written when nothing is pending
+    preset_bank_flush();
+    CHECK_EQ(shim_flash_get_erases(), erases + 2);
+    CHECK(!preset_bank_store(NUM_PRESET_SLOTS, params, sizeof(params)));
+
+    preset_bank_init(); // As after a reboot
+    CHECK(preset_bank_is_used(1));
+    CHECK(preset_bank_is_used(slots_per_sector + 1));
+}
+
+// The SysTick counter does not run on the host: the test moves it as the tasks would
+static void test_profiler() {
+    const uint32_t cycles_per_us = clock_get_hz(clk_sys) / 1000000;
+    const uint32_t loop_us = 1000;
+    const uint32_t buffer_us = AUDIO_BUFFER_LENGTH * 1000000 / SOUND_OUTPUT_FREQUENCY;
+    profiler_init();
+    systick_hw->cvr = 100; // Wraps around during the first iteration
+    uint32_t windows = 0;
+    for (uint32_t i = 0; i < 2 * PROFILER_REPORT_US / loop_us; i++) {
+        uint32_t touch_us = (i % 10 == 0 ? 300 : 100);
+        profiler_loop_begin();
+        systick_hw->cvr = (systick_hw->cvr - touch_us * cycles_per_us) & 0x00FFFFFF;
+        profiler_mark(PROF_TOUCH);
+        systick_hw->cvr = (systick_hw->cvr - 200 * cycles_per_us) & 0x00FFFFFF;
+        profiler_mark(PROF_DISPLAY);
+        profiler_render(i == 5 ? buffer_us / 2 : buffer_us / 4);
+        shim_advance_us(loop_us);
+        windows += profiler_loop_end();
+    }
+
+    // Per task, the mean and the maximum of the last window. The maxima of
+    // the first window, with the longest render, were replaced by the second one.
+    CHECK_EQ(windows, 2);
+    CHECK_EQ(profiler_get_max_us(PROF_TOUCH), 300);
+    CHECK(profiler_get_mean_us(PROF_TOUCH) >= 100 && profiler_get_mean_us(PROF_TOUCH) < 200);
+    CHECK_EQ(profiler_get_max_us(PROF_DISPLAY), 200);
+    CHECK(profiler_get_mean_us(PROF_DISPLAY) >= 199 && profiler_get_mean_us(PROF_DISPLAY) <= 200);
+    CHECK_EQ(profiler_get_max_us(PROF_LOOP), 500);
+    CHECK_EQ(profiler_get_max_us(PROF_IMU), 0);
+    CHECK(profiler_get_loop_rate() >= 999 && profiler_get_loop_rate() <= 1000);
+    CHECK_EQ(profiler_get_render_load(), buffer_us / 4 * 100 / buffer_us); // In percent of the buffer period
+}
+
+int main() {
+    test_clock_and_alarms();
+    test_touch();
+    test_imu();
+    test_encoder_accel();
+    test_state();
+    test_note_map();
+    test_looper();
+    test_looper_tilt_memory();
+    test_looper_playback_modes();
+    test_input_trace();
+    test_display();
+    test_preset_bank();
+    test_synth_queue();
+    test_flash();
+    test_profiler();
+    return TEST_RESULT();
+}
@@ -1,7 +1,6 @@
 /* IMU GY-521 - MPU6050 accelerometer and gyroscope */
 
 #include "pico/stdlib.h"
-#include "hardware/clocks.h"
 #include "MPU6050.h"
 #include <config.h>
 #include "imu.h"
@@ -16,7 +15,13 @@ mpu6050_t mpu6050;
 #define FIXED_POINT_BITS 16
 #define FIXED_POINT_SCALE (1 << FIXED_POINT_BITS)
 
-#define PEAK_HOLD_WINDOW        10
+// Accelerometer readings, at one per IMU task run
+#define PEAK_HOLD_WINDOW        ((VELOCITY_PEAK_MS * 1000 + IMU_PERIOD_US - 1) / IMU_PERIOD_US)
+#define VELOCITY_HOLD_SAMPLES   ((VELOCITY_HOLD_MS * 1000 + IMU_PERIOD_US - 1) / IMU_PERIOD_US)
+
+#if VELOCITY_HOLD_SAMPLES > 127
+#error "VELOCITY_HOLD_MS is too long for the IMU period"
+#endif
 
 typedef struct {
     int16_t peak;
@@ -70,6 +75,7 @@ inline int16_t mul_fixed(int16_t a, int16_t b) {
 }
 
 inline int16_t sqrt_fixed(int16_t x) {
+    if (x <= 0) { return 0; } // No reading, and no division by zero
     int16_t y = x;
     int32_t e = FIXED_POINT_SCALE;
     while (e > 1) {
@@ -131,9 +137,9 @@ int16_t map_14(int16_t value) {
     return (result < 0) ? 0 : (result > 16383) ? 16383 : result;
 }
 
-void imu_task(Imu_data * data) {
-    read_raw_accel_fixed(&mpu6050);
-    struct mpu6050_vector16 *accel = &mpu6050.ra;
+// Turn a raw accelerometer reading into tilt and velocity. Kept apart from the sensor
+// access, so that the same logic can be fed with recorded or generated readings.
+void imu_process(const struct mpu6050_vector16 *accel, Imu_data * data) {
 
     // Scale the raw readings.
     // 493 = (MPU6050_SCALE_250DPS * (1 << 16)) / 1
@@ -171,4 +177,9 @@ void imu_task(Imu_data * data) {
 
     // Acceleration goes to velocity
     data->acceleration = (map_7(peak_hold_get(&peak_hold) * VELOCITY_MULTIPLIER));
-}
\ No newline at end of file
+}
+
+void imu_task(Imu_data * data) {
+    read_raw_accel_fixed(&mpu6050);
+    imu_process(&mpu6050.ra, data);
+}
@@ -15,6 +15,8 @@ typedef struct {
 
 void imu_init();
 void imu_task(Imu_data * data);
+struct mpu6050_vector16;
+void imu_process(const struct mpu6050_vector16 *accel, Imu_data * data);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,42 @@
+/* Input event queue, from interrupt callbacks to the main loop */
+
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "input_queue.h"
+
+static input_event_t events[INPUT_QUEUE_SIZE];
+static volatile uint16_t head; // Written by the producers only
+static volatile uint16_t tail; // Written by the consumer only
+static uint32_t dropped;
+
+// The Cortex-M0+ has no atomic read-modify-write, so a producer reserves
+// its slot with interrupts disabled for a few instructions, in case another
+// callback preempts it. The consumer never blocks the producers.
+bool input_queue_push(input_event_type_t type, int8_t value) {
+    uint32_t ints = save_and_disable_interrupts();
+    if ((uint16_t)(head - tail) >= INPUT_QUEUE_SIZE) {
+        dropped++;
+        restore_interrupts(ints);
+        return false;
+    }
+    input_event_t *event = &events[head & (INPUT_QUEUE_SIZE - 1)];
+    event->type = type;
+    event->value = value;
+    __mem_fence_release(); // The event must be complete before it is published
+    head++;
+    restore_interrupts(ints);
+    return true;
+}
+
+bool input_queue_pop(input_event_t *event) {
+    if (tail == head) { return false; }
+    __mem_fence_acquire();
+    *event = events[tail & (INPUT_QUEUE_SIZE - 1)];
+    __mem_fence_release(); // Done reading the slot before it is handed back
+    tail++;
+    return true;
+}
+
+uint32_t input_queue_get_dropped() {
+    return dropped;
+}
@@ -0,0 +1,33 @@
+#ifndef INPUT_QUEUE_H
+#define INPUT_QUEUE_H
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define INPUT_QUEUE_SIZE    32 // Must be a power of two
+
+typedef enum input_event_type {
+    INPUT_ENCODER,          // Value is the direction, 1 or -1
+    INPUT_BUTTON,           // Value is the button state, 1 for released
+    INPUT_LONG_PRESS,       // Value is the number of the press that started the timer
+} input_event_type_t;
+
+typedef struct input_event {
+    uint8_t type;
+    int8_t value;
+} input_event_t;
+
+// Input callbacks run in interrupt context and only record what happened here.
+// The events are handled in order by the main loop, where the state can be changed
+// and the synth and display updated without racing against other handlers.
+bool input_queue_push(input_event_type_t type, int8_t value);
+bool input_queue_pop(input_event_t *event);
+uint32_t input_queue_get_dropped();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,147 @@
+/* Input recording and replay, for debugging and profiling */
+
+#include "pico/stdlib.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "input_trace.h"
+
+// Declare the static trace instance
+static struct {
+    trace_mode_t mode;
+    trace_event_t* events;
+    uint16_t events_max;
+    uint16_t length;            // Number of recorded events
+    uint16_t replay_index;      // Number of replayed events
+    uint32_t start_timestamp;
+    trace_output_t* outputs;
+    uint16_t outputs_max;
+    uint16_t outputs_length;    // Number of logged output messages
+    uint16_t outputs_lost;      // Output messages that did not fit
+} trace;
+
+void input_trace_init(uint16_t events_max, uint16_t outputs_max) {
+    trace.events = malloc(sizeof(trace_event_t) * events_max);
+    trace.events_max = events_max;
+    trace.length = 0;
+    trace.outputs = malloc(sizeof(trace_output_t) * outputs_max);
+    trace.outputs_max = outputs_max;
+    trace.outputs_length = 0;
+    trace.mode = TRACE_IDLE;
+}
+
+void input_trace_record(trace_source_t source, uint32_t data) {
+    if (trace.mode != TRACE_RECORDING) { return; }
+    if (trace.length >= trace.events_max) {
+        trace.mode = TRACE_IDLE;
+        printf("trace full\n");
+        return;
+    }
+    trace_event_t* event = &trace.events[trace.length++];
+    event->timestamp = time_us_32() - trace.start_timestamp;
+    event->data = ((uint32_t)source << INPUT_TRACE_SOURCE_SHIFT) | data;
+}
+
+// Add an event to the recording, from a trace printed by the d command for example.
+// The events must come in time order.
+bool input_trace_add(uint32_t timestamp, trace_source_t source, uint32_t data) {
+    if (trace.mode != TRACE_IDLE || trace.length >= trace.events_max) { return false; }
+    trace_event_t* event = &trace.events[trace.length++];
+    event->timestamp = timestamp;
+    event->data = ((uint32_t)source << INPUT_TRACE_SOURCE_SHIFT) | data;
+    return true;
+}
+
+// Log the Midi messages sent while tracing, so that two runs of the same trace
+// can be compared. They are kept in RAM, and only printed on request,
+// so that logging does not wait for the serial console.
+void input_trace_log_output(uint8_t b1, uint8_t b2, uint8_t b3) {
+    if (trace.mode == TRACE_IDLE) { return; }
+    if (trace.outputs_length >= trace.outputs_max) {
+        trace.outputs_lost++;
+        return;
+    }
+    trace_output_t* output = &trace.outputs[trace.outputs_length++];
+    output->timestamp = time_us_32() - trace.start_timestamp;
+    output->data[0] = b1;
+    output->data[1] = b2;
+    output->data[2] = b3;
+}
+
+uint16_t input_trace_get_outputs(const trace_output_t **outputs) {
+    *outputs = trace.outputs;
+    return trace.outputs_length;
+}
+
+bool input_trace_is_replaying() {
+    return (trace.mode == TRACE_REPLAYING);
+}
+
+static void dump() {
+    printf("trace %u\n", trace.length);
+    for (uint16_t i = 0; i < trace.length; i++) {
+        trace_event_t* event = &trace.events[i];
+        printf("in %lu %u %08lx\n", (unsigned long)event->timestamp,
+               (unsigned)(event->data >> INPUT_TRACE_SOURCE_SHIFT),
+               (unsigned long)(event->data & ((1u << INPUT_TRACE_SOURCE_SHIFT) - 1)));
+    }
+}
+
+static void dump_outputs() {
+    printf("outputs %u, lost %u\n", trace.outputs_length, trace.outputs_lost);
+    for (uint16_t i = 0; i < trace.outputs_length; i++) {
+        trace_output_t* output = &trace.outputs[i];
+        printf("out %lu %02x %02x %02x\n", (unsigned long)output->timestamp,
+               output->data[0], output->data[1], output->data[2]);
+    }
+}
+
+// Commands are single characters received on the serial console:
+// r starts recording, p replays the recording, s stops, d prints the recording,
+// o prints the Midi output of the last recording or replay
+static void handle_command(int command) {
+    switch (command) {
+        case 'r':
+            trace.length = 0;
+            trace.outputs_length = 0;
+            trace.outputs_lost = 0;
+            trace.start_timestamp = time_us_32();
+            trace.mode = TRACE_RECORDING;
+        break;
+        case 'p':
+            trace.replay_index = 0;
+            trace.outputs_length = 0;
+            trace.outputs_lost = 0;
+            trace.start_timestamp = time_us_32();
+            trace.mode = TRACE_REPLAYING;
+        break;
+        case 's':
+            trace.mode = TRACE_IDLE;
+        break;
+        case 'd':
+            dump();
+        break;
+        case 'o':
+            dump_outputs();
+        break;
+        default:
+            return;
+    }
+}
+
+// Feed the events that are due to the firmware, as if they came from the inputs
+void input_trace_task() {
+    int command = getchar_timeout_us(0);
+    if (command != PICO_ERROR_TIMEOUT) { handle_command(command); }
+
+    if (trace.mode != TRACE_REPLAYING) { return; }
+    uint32_t position = time_us_32() - trace.start_timestamp;
+    while (trace.replay_index < trace.length) {
+        trace_event_t* event = &trace.events[trace.replay_index];
+        if (event->timestamp > position) { return; }
+        trace.replay_index++;
+        input_trace_apply((trace_source_t)(event->data >> INPUT_TRACE_SOURCE_SHIFT),
+                          event->data & ((1u << INPUT_TRACE_SOURCE_SHIFT) - 1));
+    }
+    trace.mode = TRACE_IDLE;
+    printf("replay done\n");
+}
@@ -0,0 +1,50 @@
+#ifndef INPUT_TRACE_H
+#define INPUT_TRACE_H
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define INPUT_TRACE_SOURCE_SHIFT    29 // The source is stored in the top bits of the data
+
+// Inputs are recorded after debouncing and sensor processing, where the firmware
+// logic starts, so that replaying them reproduces the same sequence of events
+typedef enum trace_source {
+    TRACE_TOUCH,    // Electrode id, plus 0x10 for touch on
+    TRACE_IMU,      // Deviation x, deviation y << 14, acceleration << 21
+    TRACE_ENCODER,  // Signed number of steps
+    TRACE_BUTTON,   // Button state, 1 for released
+} trace_source_t;
+
+typedef struct trace_event {
+    uint32_t timestamp;         // Microseconds since the start of the recording
+    uint32_t data;              // Source and input data
+} trace_event_t;
+
+typedef struct trace_output {
+    uint32_t timestamp;         // Microseconds since the start of the recording or replay
+    uint8_t data[3];            // Midi message
+} trace_output_t;
+
+typedef enum trace_mode {
+    TRACE_IDLE,
+    TRACE_RECORDING,
+    TRACE_REPLAYING,
+} trace_mode_t;
+
+void input_trace_init(uint16_t events_max, uint16_t outputs_max);
+void input_trace_record(trace_source_t source, uint32_t data);
+bool input_trace_add(uint32_t timestamp, trace_source_t source, uint32_t data);
+uint16_t input_trace_get_outputs(const trace_output_t **outputs);
+void input_trace_log_output(uint8_t b1, uint8_t b2, uint8_t b3);
+bool input_trace_is_replaying();
+void input_trace_task();
+
+extern void input_trace_apply(trace_source_t source, uint32_t data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,10 +1,80 @@
 #include "pico/stdlib.h"
 #include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "midi_clock.h"
 #include "looper.h"
+#include "state.h"
 
 // Declare the static looper instance
 static looper_t looper;
 
+static void set_transpose(int8_t transpose);
+static void close_open_notes(uint32_t timestamp);
+
+// Recordings made while receiving Midi clock follow the clock position
+// instead of the system time, so that they keep in time with the tempo
+static inline uint32_t looper_time(uint32_t time_us) {
+    return (looper.synced ? midi_clock_get_time(time_us) : time_us);
+}
+
+static inline uint32_t looper_now() {
+    return looper_time(time_us_32());
+}
+
+static inline uint32_t round_to_beat(uint32_t time) {
+    return (time + MIDI_CLOCK_BEAT_UNITS / 2) / MIDI_CLOCK_BEAT_UNITS * MIDI_CLOCK_BEAT_UNITS;
+}
+
+static inline uint32_t round_up_to_beat(uint32_t time) {
+    return (time + MIDI_CLOCK_BEAT_UNITS - 1) / MIDI_CLOCK_BEAT_UNITS * MIDI_CLOCK_BEAT_UNITS;
+}
+
+// Time run through the timeline, for the time elapsed since the pass start.
+// The events keep their recorded timestamps, they are only compared to it.
+static inline uint32_t pass_time(uint32_t elapsed) {
+    switch (looper.speed) {
+        case LOOPER_SPEED_HALF:
+            return elapsed / 2;
+        case LOOPER_SPEED_DOUBLE:
+            return elapsed * 2;
+        default:
+            return elapsed;
+    }
+}
+
+// Time elapsed since the pass start, for the time run through the timeline
+static inline uint32_t pass_elapsed(uint32_t time) {
+    switch (looper.speed) {
+        case LOOPER_SPEED_HALF:
+            return time * 2;
+        case LOOPER_SPEED_DOUBLE:
+            return time / 2;
+        default:
+            return time;
+    }
+}
+
+#if defined (MIDI_CLOCK_OUT)
+// Send Midi clock for unsynced loops, assuming the loop is made of
+// the whole number of beats closest to MIDI_CLOCK_OUT_BEAT_US each
+static inline void looper_clock_out_start() {
+    uint32_t beats = (looper.loop_duration + MIDI_CLOCK_OUT_BEAT_US / 2) / MIDI_CLOCK_OUT_BEAT_US;
+    if (beats == 0) { beats = 1; }
+    looper.clock_out_ticks = beats * MIDI_CLOCK_PPQN;
+    looper.clock_out_tick = 0;
+    send_midi_realtime(0xFA); // Start
+}
+
+static inline void looper_clock_out(uint32_t position) {
+    while (looper.clock_out_tick < looper.clock_out_ticks &&
+           position >= (uint64_t)looper.clock_out_tick * looper.loop_duration / looper.clock_out_ticks) {
+        send_midi_realtime(0xF8); // Timing clock
+        looper.clock_out_tick++;
+    }
+}
+#endif
+
 // Handle button presses
 void looper_onpress() {
     switch(looper.state) {
@@ -15,7 +85,13 @@ void looper_onpress() {
         break;
         case LOOP_REC:
             // Stop recording, start playing
-            looper.loop_duration = time_us_32() - looper.rec_start_timestamp;
+            looper.loop_duration = looper_now() - looper.rec_start_timestamp;
+            if (looper.synced) {
+                // Make the loop a whole number of beats
+                looper.loop_duration = round_to_beat(looper.loop_duration);
+                if (looper.loop_duration == 0) { looper.loop_duration = MIDI_CLOCK_BEAT_UNITS; }
+            }
+            close_open_notes(looper.loop_duration);
             looper_start_playback();
         break;
         case LOOP_PLAY:
@@ -26,19 +102,66 @@ void looper_onpress() {
     }
 }
 
-// Initialize the looper
+// Track being recorded, or the one to record next
+static inline looper_track_t* recorded_track() {
+    return &looper.tracks[looper.track];
+}
+
+static void clear_tracks() {
+    for (uint8_t t = 0; t < LOOPER_TRACKS; t++) {
+        looper.tracks[t].rec_index = 0;
+        looper.tracks[t].lanes = 0;
+    }
+}
+
+// True if a track other than the given one holds events
+static bool has_other_tracks_than(uint8_t track) {
+    for (uint8_t t = 0; t < LOOPER_TRACKS; t++) {
+        if (t != track && looper.tracks[t].rec_index > 0) { return true; }
+    }
+    return false;
+}
+
+static inline bool has_other_tracks() {
+    return has_other_tracks_than(looper.track);
+}
+
+// Initialize the looper, sharing the events between the tracks
 void looper_init(uint16_t events_max) {
-    looper.events = malloc(sizeof(note_event_t) * events_max);
-    looper.rec_index = 0;
-    looper.events_max = events_max;
+    note_event_t* events = malloc(sizeof(note_event_t) * events_max);
+    looper.events_max = events_max / LOOPER_TRACKS;
+    for (uint8_t t = 0; t < LOOPER_TRACKS; t++) {
+        looper.tracks[t].events = &events[t * looper.events_max];
+        looper.tracks[t].rec_index = 0;
+        looper.tracks[t].volume = LOOPER_TRACK_VOLUME_MAX;
+    }
     looper.rec_start_timestamp = 0;
     looper.play_start_timestamp = 0;
     looper.loop_duration = 0;
     looper.has_recording = false;
+    looper.speed = LOOPER_SPEED_NORMAL;
+    set_transpose(0);
 }
 
 void looper_start_playback() {
     if(looper_has_recording()) {
+        uint32_t now = looper_now();
+        if (!looper.synced) {
+            looper.play_start_timestamp = now;
+#if defined (MIDI_CLOCK_OUT)
+            looper_clock_out_start();
+#endif
+        } else if (looper_is_recording()) {
+            // The loop follows the recording seamlessly
+            looper.play_start_timestamp = looper.rec_start_timestamp + looper.loop_duration;
+        } else {
+            // Start on the next beat
+            looper.play_start_timestamp = round_up_to_beat(now);
+        }
+        for (uint8_t t = 0; t < LOOPER_TRACKS; t++) {
+            looper.tracks[t].play_index = 0;
+            if (looper.tracks[t].rec_index > 0) { looper_track_start(t, looper.tracks[t].instrument); }
+        }
         // Start playback
         looper_set_state(LOOP_PLAY);
     } else {
@@ -47,81 +170,357 @@ void looper_start_playback() {
     }
 }
 
+// The first tilt reading of a new recording is always recorded, as the starting value
+static void start_tilt_lanes() {
+    recorded_track()->lanes = 0;
+    midi_limiter_init(&looper.lane_limiters[0], 0xFFFF, LOOPER_BEND_THRESHOLD,
+                      LOOPER_TILT_INTERVAL_US, LOOPER_TILT_SETTLE_US);
+    midi_limiter_init(&looper.lane_limiters[1], 0xFFFF, LOOPER_CUTOFF_THRESHOLD,
+                      LOOPER_TILT_INTERVAL_US, LOOPER_TILT_SETTLE_US);
+}
+
+// Position in the timeline of an event recorded at the given system time
+static uint32_t record_timestamp(uint32_t time_us) {
+    int32_t offset = (int32_t)(looper_time(time_us) - looper.rec_start_timestamp);
+    uint32_t timestamp = (offset > 0 ? offset : 0); // Notes played just before a synced loop start are moved to it
+    if (looper.overdub) {
+        // Overdubs are only recorded forward, at the playback speed
+        timestamp = pass_time(timestamp);
+        if (timestamp > looper.loop_duration) { timestamp = looper.loop_duration; }
+    }
+    return timestamp;
+}
+
+static void append_event(uint32_t timestamp, uint8_t id, uint8_t velocity, uint8_t type) {
+    looper_track_t* track = recorded_track();
+    if (track->rec_index >= looper.events_max) { return; }
+    // Keep the events in time order, even if an arpeggiator note was due before the tilt recorded last
+    if (track->rec_index > 0 && timestamp < track->events[track->rec_index - 1].timestamp) {
+        timestamp = track->events[track->rec_index - 1].timestamp;
+    }
+    note_event_t* event = &track->events[track->rec_index];
+    event->timestamp = timestamp;
+    event->id = id;
+    event->velocity = velocity;
+    event->type = type;
+    track->rec_index++;
+    // An overdub is heard live, it is played back from the next pass
+    if (looper.overdub) {
+        track->play_index = track->rec_index;
+        return;
+    }
+    // If the looper has at least two entries, turn the flag on
+    if(track->rec_index > 1) {
+        looper.has_recording = true;
+    }
+}
+
+// Notes on in the recorded track, so that every recorded note on has its note off.
+// Playing backwards turns them into note offs, and the note offs into note ons.
+static uint8_t open_notes[NUM_NOTE_IDS];
+static uint8_t open_count;
+
+static void clear_open_notes() {
+    memset(open_notes, 0, sizeof(open_notes));
+    open_count = 0;
+}
+
+static void append_note(uint32_t timestamp, uint8_t id, uint8_t velocity, bool is_on) {
+    if (is_on) {
+        // Keep room for the note off
+        if (recorded_track()->rec_index + open_count + 2 > looper.events_max) { return; }
+        open_notes[id]++;
+        open_count++;
+    } else {
+        if (open_notes[id] == 0) { return; } // Started before the recording, or not recorded
+        open_notes[id]--;
+        open_count--;
+    }
+    append_event(timestamp, id, velocity, (is_on ? LOOPER_NOTE_ON : LOOPER_NOTE_OFF));
+}
+
+// End the notes still held when the recording stops
+static void close_open_notes(uint32_t timestamp) {
+    for (uint8_t id = 0; id < NUM_NOTE_IDS; id++) {
+        while (open_notes[id] > 0) {
+            append_note(timestamp, id, 0, false);
+        }
+    }
+}
+
+static void end_overdub(uint32_t timestamp) {
+    if (!looper.overdub) { return; }
+    close_open_notes(timestamp);
+    looper.overdub = false;
+}
+
+// Record the selected track over the playback of the others, until the loop restarts
+static void start_overdub() {
+    looper_track_t* track = recorded_track();
+    looper_track_notes_off(looper.track); // The other tracks and the pads keep sounding
+    track->rec_index = 0;
+    track->play_index = 0;
+    track->instrument = get_instrument();
+    looper.overdub = true;
+    looper.rec_start_timestamp = looper.play_start_timestamp;
+    clear_open_notes();
+    start_tilt_lanes();
+}
+
 // Record a note event
 void looper_record(uint8_t id, uint8_t velocity, bool is_on) {
+    looper_record_at(id, velocity, is_on, time_us_32());
+}
+
+// Record a note event that happened at the given system time,
+// e.g. a note scheduled ahead by the arpeggiator
+void looper_record_at(uint8_t id, uint8_t velocity, bool is_on, uint32_t time_us) {
     if (looper_is_disabled()) { return; }
-    if (looper_is_playing()) {
+    if (looper_is_playing() && !looper.overdub) {
         if (!is_on) { return; } // Ignore note-off events while playing
-        // Prepare for a new recording
-        looper.has_recording = false;
-        looper_set_state(LOOP_READY);
+        if (has_other_tracks()) {
+            if (looper.reverse) { return; } // Heard live only
+            start_overdub();
+        } else {
+            // Prepare for a new recording
+            looper.has_recording = false;
+            looper_set_state(LOOP_READY);
+        }
+    } else if (looper_is_ready() && looper_has_recording() && has_other_tracks()) {
+        if (!is_on || looper.reverse) { return; }
+        // Resume the other tracks, and record this one over them
+        looper_start_playback();
+        start_overdub();
     }
     if (looper_is_ready()) {
-        looper.rec_index = 0;
-        looper.rec_start_timestamp = 0;
+        clear_tracks();
+        recorded_track()->instrument = get_instrument();
         looper.loop_duration = 0;
+        looper.synced = midi_clock_is_running();
+        clear_open_notes();
+        start_tilt_lanes();
+        looper.rec_start_timestamp = looper_time(time_us);
+        if (looper.synced) {
+            // Start the loop on the closest beat
+            looper.rec_start_timestamp = round_to_beat(looper.rec_start_timestamp);
+        }
         looper_set_state(LOOP_REC);
     }
 
-    if (looper.rec_index < looper.events_max) {
-        uint32_t now = time_us_32();
-        if(looper.rec_start_timestamp == 0) { looper.rec_start_timestamp = now; }
-        note_event_t* event = &looper.events[looper.rec_index];
-        event->timestamp = now - looper.rec_start_timestamp;
-        event->id = id;
-        event->velocity = velocity;
-        event->is_on = is_on;
-        looper.rec_index++;
-        // If the looper has at least two entries, turn the flag on
-        if(looper.rec_index > 1) {
-            looper.has_recording = true;
-        }
+    append_note(record_timestamp(time_us), id, velocity, is_on);
+}
+
+// Record the tilt applied to the synth, called on every IMU reading.
+// Significant changes are recorded at most every LOOPER_TILT_INTERVAL_US,
+// smaller ones once the tilt settles, and the last quarter of the events
+// is left for the notes, so a long gesture cannot fill up the recording.
+void looper_record_tilt(looper_event_type_t type, uint16_t value) {
+    if (!looper_is_recording() && !looper.overdub) { return; }
+    uint32_t now = time_us_32();
+    if (!midi_limiter_update(&looper.lane_limiters[type - LOOPER_BEND], value, now)) { return; }
+    looper_track_t* track = recorded_track();
+    if (track->rec_index >= looper.events_max - looper.events_max / 4) { return; }
+    append_event(record_timestamp(now), value >> 7, value & 0x7F, type);
+    track->lanes |= (1 << type);
+}
+
+// True if a note played now leaves the loop playing: it is overdubbed on the
+// selected track, or heard live over the other tracks, instead of starting a new recording
+bool looper_keeps_playing() {
+    return (looper_is_playing() && (looper.overdub || has_other_tracks()));
+}
+
+// True if the looper is playing back this tilt, instead of the device's own
+bool looper_plays_tilt(looper_event_type_t type) {
+    if (!looper_is_playing()) { return false; }
+    for (uint8_t t = 0; t < LOOPER_TRACKS; t++) {
+        if (looper.overdub && t == looper.track) { continue; } // Being recorded
+        if (looper.tracks[t].lanes & (1 << type)) { return true; }
     }
+    return false;
+}
+
+// Ids of the recorded notes after transposition, rebuilt when it changes.
+// Transposition shifts the pad and keeps the octave of the id.
+static uint8_t transposed_ids[NUM_NOTE_IDS];
 
+static void set_transpose(int8_t transpose) {
+    looper.transpose = transpose;
+    uint8_t shift = looper_get_transpose();
+    for (uint8_t id = 0; id < NUM_NOTE_IDS; id++) {
+        uint8_t pad = id % 12 + shift;
+        transposed_ids[id] = id / 12 * 12 + (pad >= 12 ? pad - 12 : pad);
+    }
 }
 
 void looper_transpose_up(){
-    looper.transpose++;
-    if(looper.transpose >= 12 ) { looper.transpose = 0; }
+    int8_t transpose = looper.transpose + 1;
+    set_transpose(transpose >= 12 ? 0 : transpose);
     all_notes_off();
 }
 
 void looper_transpose_down(){
-    looper.transpose--;
-    if(looper.transpose <= -12 ) { looper.transpose = 0; }
+    int8_t transpose = looper.transpose - 1;
+    set_transpose(transpose <= -12 ? 0 : transpose);
     all_notes_off();
 }
 
-static inline uint8_t transpose_id(uint8_t id) {
-    int16_t wrap = id + looper.transpose;
-    wrap = (wrap % 12 + 12) % 12;
-    return (uint8_t)wrap;
+static void play_event(uint8_t t, uint8_t type, uint8_t id, uint8_t velocity) {
+    looper_track_t* track = &looper.tracks[t];
+    switch (type) {
+        case LOOPER_NOTE_ON:
+            velocity = velocity * track->volume / LOOPER_TRACK_VOLUME_MAX;
+            if (velocity > 0) { looper_note_on(t, transposed_ids[id], velocity); }
+        break;
+        case LOOPER_NOTE_OFF:
+            looper_note_off(t, transposed_ids[id]);
+        break;
+        default:
+            looper_tilt((looper_event_type_t)type, (id << 7) | velocity);
+        break;
+    }
 }
 
-void looper_task() {
-    if(!looper_is_playing()) { return; }
-    uint32_t now = time_us_32();
-    if(now - looper.play_start_timestamp > looper.loop_duration){ // Loop start or restart
-        looper.play_start_timestamp = now;
-        looper.play_index = 0;
-    }
-    // Scan for recorded events to replay
-    for (uint16_t i = looper.play_index; i < looper.rec_index; i++) {
-        note_event_t* event = &looper.events[i];
-        // Check if it's time to replay the event
-        if (now >= event->timestamp + looper.play_start_timestamp) {
-            uint8_t id = transpose_id(event->id);
-            if (event->is_on) {
-                note_on(id, event->velocity);
-            } else {
-                note_off(id);
+// Closest earlier event of the same note id, or of the same tilt lane
+static const note_event_t* find_previous(const looper_track_t* track, uint16_t index) {
+    const note_event_t* event = &track->events[index];
+    bool is_note = (event->type == LOOPER_NOTE_ON || event->type == LOOPER_NOTE_OFF);
+    while (index-- > 0) {
+        const note_event_t* previous = &track->events[index];
+        if (is_note) {
+            bool previous_is_note = (previous->type == LOOPER_NOTE_ON || previous->type == LOOPER_NOTE_OFF);
+            if (previous_is_note && previous->id == event->id) { return previous; }
+        } else if (previous->type == event->type) {
+            return previous;
+        }
+    }
+    return NULL;
+}
+
+// Backwards, a note off starts the note with the velocity of its note on, and
+// the note on ends it. A note off without a note on just before it is skipped,
+// as nothing would end the note. Tilt goes back to the value before the event.
+static void play_event_reversed(uint8_t t, uint16_t index) {
+    const looper_track_t* track = &looper.tracks[t];
+    const note_event_t* event = &track->events[index];
+    const note_event_t* previous = find_previous(track, index);
+    switch (event->type) {
+        case LOOPER_NOTE_ON:
+            play_event(t, LOOPER_NOTE_OFF, event->id, 0);
+        break;
+        case LOOPER_NOTE_OFF:
+            if (previous != NULL && previous->type == LOOPER_NOTE_ON) {
+                play_event(t, LOOPER_NOTE_ON, previous->id, previous->velocity);
             }
-            // Increase the counter, to avoid processing events more than once
-            looper.play_index++;
+        break;
+        default:
+            if (previous == NULL) { previous = event; } // Keep the first value
+            play_event(t, previous->type, previous->id, previous->velocity);
+        break;
+    }
+}
+
+// Events are due once the time run through the timeline reaches them,
+// from its start or from its end when playing backwards
+static inline bool is_due(const note_event_t* event, uint32_t time) {
+    if (looper.reverse) {
+        return (time >= looper.loop_duration || event->timestamp >= looper.loop_duration - time);
+    }
+    return (event->timestamp <= time);
+}
+
+// Replay the recorded events of a track that are due. They are in time order,
+// so the notes and the tilt come out interleaved as they were played.
+// Backwards, they are read from the end of the recording.
+static void play_track(uint8_t t, uint32_t time) {
+    looper_track_t* track = &looper.tracks[t];
+    while (track->play_index < track->rec_index) {
+        uint16_t index = (looper.reverse ? track->rec_index - 1 - track->play_index : track->play_index);
+        if (!is_due(&track->events[index], time)) { break; }
+        if (looper.reverse) {
+            play_event_reversed(t, index);
+        } else {
+            note_event_t* event = &track->events[index];
+            play_event(t, event->type, event->id, event->velocity);
         }
+        // Increase the counter, to avoid processing events more than once
+        track->play_index++;
+    }
+}
 
+void looper_task() {
+    if(!looper_is_playing()) { return; }
+    uint32_t now = looper_now();
+    int32_t elapsed = (int32_t)(now - looper.play_start_timestamp);
+    if(elapsed < 0) { return; } // A synced loop is waiting for its start
+    uint32_t pass_length = pass_elapsed(looper.loop_duration);
+    if((uint32_t)elapsed > pass_length){ // Loop restart
+        // Play what is left of the pass first, so that no note is left on
+        for (uint8_t t = 0; t < LOOPER_TRACKS; t++) {
+            play_track(t, UINT32_MAX);
+        }
+        if (looper.synced) {
+            // Stay on the clock grid
+            looper.play_start_timestamp += pass_length;
+            elapsed -= pass_length;
+        } else {
+            looper.play_start_timestamp = now;
+            elapsed = 0;
         }
+        end_overdub(looper.loop_duration); // The overdubbed track plays from now on
+        for (uint8_t t = 0; t < LOOPER_TRACKS; t++) {
+            looper.tracks[t].play_index = 0;
+        }
+        looper.clock_out_tick = 0;
+    }
+    uint32_t time = pass_time(elapsed);
+    if (time > looper.loop_duration) { time = looper.loop_duration; }
+#if defined (MIDI_CLOCK_OUT)
+    if (!looper.synced) { looper_clock_out(time); }
+#endif
+    for (uint8_t t = 0; t < LOOPER_TRACKS; t++) {
+        play_track(t, time);
+    }
+}
+
+looper_speed_t looper_get_speed() {
+    return (looper_speed_t)looper.speed;
+}
+
+bool looper_is_reversed() {
+    return looper.reverse;
+}
+
+// Change the speed or the direction, going on from the same point of the timeline.
+// Notes are ended, since the ones on would not get their note off in the new direction.
+void looper_set_playback(looper_speed_t speed, bool reverse) {
+    uint32_t now = looper_now();
+    int32_t elapsed = (int32_t)(now - looper.play_start_timestamp);
+    if (!looper_is_playing() || elapsed < 0) {
+        looper.speed = speed;
+        looper.reverse = reverse;
+        return;
+    }
+    end_overdub(record_timestamp(time_us_32()));
+    all_notes_off();
 
+    uint32_t time = pass_time(elapsed);
+    if (time > looper.loop_duration) { time = looper.loop_duration; }
+    uint32_t position = (looper.reverse ? looper.loop_duration - time : time);
+
+    looper.speed = speed;
+    looper.reverse = reverse;
+    time = (reverse ? looper.loop_duration - position : position);
+    looper.play_start_timestamp = now - pass_elapsed(time);
+    // Skip the events already passed in the new direction
+    for (uint8_t t = 0; t < LOOPER_TRACKS; t++) {
+        looper_track_t* track = &looper.tracks[t];
+        track->play_index = 0;
+        for (uint16_t i = 0; i < track->rec_index; i++) {
+            uint32_t timestamp = track->events[i].timestamp;
+            if (reverse ? timestamp > position : timestamp < position) { track->play_index++; }
+        }
+    }
 }
 
 void looper_enable() {
@@ -130,19 +529,181 @@ void looper_enable() {
     }
 }
 
+static inline void looper_playback_stopped() {
+#if defined (MIDI_CLOCK_OUT)
+    if (looper_is_playing() && !looper.synced) {
+        send_midi_realtime(0xFC); // Stop
+    }
+#endif
+}
+
 void looper_stop() {
+    looper_playback_stopped();
+    end_overdub(record_timestamp(time_us_32()));
     all_notes_off();
     looper_set_state(LOOP_READY);
 }
 
 void looper_disable() {
+    looper_playback_stopped();
     all_notes_off();
     looper.has_recording = false;
-    looper.rec_index = 0;
+    looper.overdub = false;
+    clear_tracks();
     looper.loop_duration = 0;
     looper_set_state(LOOP_OFF);
 }
 
+/* Dump and load */
+// Each track is serialized as a header followed by the note events,
+// with multi-byte values stored least significant byte first.
+// The header holds the loop duration, which all the tracks share.
+
+static inline uint8_t get_dump_byte(const looper_track_t* track, uint16_t offset) {
+    if (offset < LOOPER_DUMP_HEADER_SIZE) {
+        switch (offset) {
+            case 0: case 1: case 2: case 3:
+                return (looper.loop_duration >> (offset * 8)) & 0xFF;
+            case 4: case 5:
+                return (track->rec_index >> ((offset - 4) * 8)) & 0xFF;
+            case 6:
+                return looper.synced;
+            default:
+                return 0; // Reserved
+        }
+    }
+    offset -= LOOPER_DUMP_HEADER_SIZE;
+    const note_event_t* event = &track->events[offset / LOOPER_DUMP_EVENT_SIZE];
+    uint8_t field = offset % LOOPER_DUMP_EVENT_SIZE;
+    switch (field) {
+        case 4:
+            return event->id;
+        case 5:
+            return event->velocity;
+        case 6:
+            return event->type;
+        default:
+            return (event->timestamp >> (field * 8)) & 0xFF;
+    }
+}
+
+static inline void set_dump_byte(looper_track_t* track, uint16_t offset, uint8_t value) {
+    if (offset < LOOPER_DUMP_HEADER_SIZE) {
+        switch (offset) {
+            case 0: case 1: case 2: case 3:
+                looper.loop_duration |= (uint32_t)value << (offset * 8);
+            break;
+            case 6:
+                looper.synced = value;
+            break;
+        }
+        return; // The number of events is known from the size
+    }
+    offset -= LOOPER_DUMP_HEADER_SIZE;
+    note_event_t* event = &track->events[offset / LOOPER_DUMP_EVENT_SIZE];
+    uint8_t field = offset % LOOPER_DUMP_EVENT_SIZE;
+    switch (field) {
+        case 4:
+            event->id = value & 0x7F; // Checked once the type is known
+        break;
+        case 5:
+            event->velocity = value & 0x7F;
+        break;
+        case 6:
+            event->type = (value < LOOPER_EVENT_LAST ? value : LOOPER_NOTE_OFF);
+        break;
+        default:
+            event->timestamp |= (uint32_t)value << (field * 8);
+        break;
+    }
+}
+
+// Return the size of the serialized track, or zero if it has no recording
+uint16_t looper_get_dump_size(uint8_t track) {
+    if (!looper_has_recording() || looper_is_recording()) { return 0; }
+    if (looper.overdub && track == looper.track) { return 0; }
+    if (looper.tracks[track].rec_index == 0) { return 0; }
+    return LOOPER_DUMP_HEADER_SIZE + looper.tracks[track].rec_index * LOOPER_DUMP_EVENT_SIZE;
+}
+
+void looper_dump(uint8_t track, uint16_t offset, uint8_t *data, uint8_t length) {
+    for (uint8_t i = 0; i < length; i++) {
+        data[i] = get_dump_byte(&looper.tracks[track], offset + i);
+    }
+}
+
+// Load a part of a serialized track. The first part replaces the track and
+// the loop duration; the track is only playable again once the last part is loaded.
+bool looper_load(uint8_t t, uint16_t offset, const uint8_t *data, uint8_t length, uint16_t size) {
+    if (size < LOOPER_DUMP_HEADER_SIZE || (size - LOOPER_DUMP_HEADER_SIZE) % LOOPER_DUMP_EVENT_SIZE != 0) { return false; }
+    uint16_t events = (size - LOOPER_DUMP_HEADER_SIZE) / LOOPER_DUMP_EVENT_SIZE;
+    if (events > looper.events_max || offset + length > size) { return false; }
+
+    looper_track_t* track = &looper.tracks[t];
+    if (offset == 0) {
+        if (looper_is_recording()) { clear_tracks(); } // The recording was not finished
+        if (looper_is_playing() || looper_is_recording()) { looper_stop(); }
+        looper.has_recording = false;
+        track->rec_index = 0;
+        track->lanes = 0;
+        looper.loop_duration = 0;
+        for (uint16_t i = 0; i < events; i++) {
+            track->events[i].timestamp = 0;
+        }
+    }
+    for (uint8_t i = 0; i < length; i++) {
+        set_dump_byte(track, offset + i, data[i]);
+    }
+
+    if (offset + length == size) {
+        for (uint16_t i = 0; i < events; i++) {
+            note_event_t* event = &track->events[i];
+            if (event->type == LOOPER_NOTE_ON || event->type == LOOPER_NOTE_OFF) {
+                event->id %= NUM_NOTE_IDS;
+            } else {
+                track->lanes |= (1 << event->type);
+            }
+        }
+        track->rec_index = events;
+        looper.has_recording = (events > 1 || has_other_tracks_than(t));
+        set_transpose(0);
+    }
+    return true;
+}
+
+// Follow the transport of the incoming Midi clock
+void looper_clock_start() {
+    if (!looper.synced) { return; }
+    if (looper_is_recording()) {
+        // The clock position is reset, so the recording would be out of place
+        looper.has_recording = false;
+        clear_tracks();
+        looper_set_state(LOOP_READY);
+        return;
+    }
+    if (looper_has_recording() && !looper_is_disabled()) {
+        end_overdub(record_timestamp(time_us_32()));
+        all_notes_off();
+        looper.play_start_timestamp = 0; // Start of the song
+        for (uint8_t t = 0; t < LOOPER_TRACKS; t++) {
+            looper.tracks[t].play_index = 0;
+        }
+        looper_set_state(LOOP_PLAY);
+    }
+}
+
+void looper_clock_continue() {
+    if (looper.synced && looper_is_ready()) {
+        looper_start_playback();
+    }
+}
+
+void looper_clock_stop() {
+    if (looper.synced && looper_is_playing()) {
+        looper_stop();
+    }
+}
+
 void looper_set_state(looper_state_t state) {
     looper.state = state;
 }
@@ -172,3 +733,36 @@ bool looper_is_playing() {
 bool looper_has_recording() {
     return (looper.has_recording);
 }
+
+uint8_t looper_get_track() {
+    return looper.track;
+}
+
+// The track to record can only change between recordings
+void looper_select_track(uint8_t track) {
+    if (looper_is_recording() || looper.overdub) { return; }
+    looper.track = track;
+}
+
+bool looper_track_has_recording(uint8_t track) {
+    return (looper.tracks[track].rec_index > 0);
+}
+
+uint8_t looper_get_track_instrument(uint8_t track) {
+    return looper.tracks[track].instrument;
+}
+
+void looper_set_track_instrument(uint8_t track, uint8_t instrument) {
+    looper.tracks[track].instrument = instrument;
+    if (looper_is_playing() && looper_track_has_recording(track)) {
+        looper_track_start(track, instrument);
+    }
+}
+
+uint8_t looper_get_track_volume(uint8_t track) {
+    return looper.tracks[track].volume;
+}
+
+void looper_set_track_volume(uint8_t track, uint8_t volume) {
+    looper.tracks[track].volume = volume;
+}
@@ -1,11 +1,17 @@
 #ifndef LOOPER_H
 #define LOOPER_H
 #include "pico/stdlib.h"
+#include "midi_limiter.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#define LOOPER_TRACKS               4
+#define LOOPER_TRACK_VOLUME_MAX     8
+#define LOOPER_DUMP_HEADER_SIZE     8 // Loop duration, number of events, sync flag, reserved
+#define LOOPER_DUMP_EVENT_SIZE      7 // Timestamp, id, velocity, event type
+
 typedef enum looper_state {
     LOOP_OFF,
     LOOP_READY,
@@ -13,25 +19,60 @@ typedef enum looper_state {
     LOOP_PLAY,
 } looper_state_t;
 
-// Structure to represent a recorded note event
+// Playback rate of the timeline
+typedef enum looper_speed {
+    LOOPER_SPEED_HALF,
+    LOOPER_SPEED_NORMAL,
+    LOOPER_SPEED_DOUBLE,
+    LOOPER_SPEED_LAST,
+} looper_speed_t;
+
+// Note off and note on match the former note on flag, so older dumps load as they are
+typedef enum looper_event_type {
+    LOOPER_NOTE_OFF,
+    LOOPER_NOTE_ON,
+    LOOPER_BEND,        // Tilt pitch bend, 0-16383
+    LOOPER_CUTOFF,      // Tilt filter cutoff, 0-127
+    LOOPER_EVENT_LAST,
+} looper_event_type_t;
+
+// Structure to represent a recorded note event.
+// Tilt events store the upper and lower 7 bits of their value in id and velocity.
 typedef struct {
     uint32_t timestamp; // timestamp in microseconds
     uint8_t id;
     uint8_t velocity;
-    bool is_on; // true for note on, false for note off
+    uint8_t type; // looper_event_type_t
 } note_event_t;
 
-typedef struct looper {
-    looper_state_t state;
+// The tracks share the loop duration. Each one has its own share of the events,
+// and is played back on its own Midi channel, with its own instrument and volume.
+typedef struct looper_track {
     note_event_t* events; // Recorded note events
     uint16_t rec_index; // Number of recorded note events
-    uint16_t events_max; // Max number of recorded note events
     uint16_t play_index; // Number of replayed note events
+    uint8_t lanes; // Tilt events in the recording, one bit per event type
+    uint8_t instrument;
+    uint8_t volume; // 0 to LOOPER_TRACK_VOLUME_MAX, scales the velocity of the notes
+} looper_track_t;
+
+typedef struct looper {
+    looper_state_t state;
+    looper_track_t tracks[LOOPER_TRACKS];
+    uint8_t track; // Track recorded, selected from the track screen
+    bool overdub; // Recording the track for one pass, while the others play
+    uint16_t events_max; // Max number of recorded note events, per track
     uint32_t rec_start_timestamp; // Timestamp of the beginning of the recording
     uint32_t play_start_timestamp; // Timestamp of the beginning of the playback
     uint32_t loop_duration; // Duration of the loop, in microseconds
     int8_t transpose; // Used to shift up or down the ids of the recorded notes
+    uint8_t speed; // looper_speed_t
+    bool reverse; // Play the timeline backwards
     bool has_recording; // False if the looper has not recorded any event yet
+    bool synced; // True if recorded while receiving Midi clock. Times are then in clock units
+    uint16_t clock_out_ticks; // Number of Midi clock ticks sent per loop
+    uint16_t clock_out_tick; // Midi clock ticks sent since the loop start
+    midi_limiter_t lane_limiters[2]; // Decimate the tilt recorded, for pitch bend and cutoff
 } looper_t;
 
 void looper_onpress();
@@ -47,15 +88,39 @@ void looper_set_state(looper_state_t state);
 uint8_t looper_get_transpose();
 void looper_init(uint16_t events_max);
 void looper_record(uint8_t id, uint8_t velocity, bool is_on);
+void looper_record_at(uint8_t id, uint8_t velocity, bool is_on, uint32_t time_us);
+void looper_record_tilt(looper_event_type_t type, uint16_t value);
+bool looper_keeps_playing();
+bool looper_plays_tilt(looper_event_type_t type);
 void looper_start_playback();
 void looper_transpose_up();
 void looper_transpose_down();
+looper_speed_t looper_get_speed();
+bool looper_is_reversed();
+void looper_set_playback(looper_speed_t speed, bool reverse);
 void looper_task();
+uint16_t looper_get_dump_size(uint8_t track);
+void looper_dump(uint8_t track, uint16_t offset, uint8_t *data, uint8_t length);
+bool looper_load(uint8_t track, uint16_t offset, const uint8_t *data, uint8_t length, uint16_t size);
+uint8_t looper_get_track();
+void looper_select_track(uint8_t track);
+bool looper_track_has_recording(uint8_t track);
+uint8_t looper_get_track_instrument(uint8_t track);
+void looper_set_track_instrument(uint8_t track, uint8_t instrument);
+uint8_t looper_get_track_volume(uint8_t track);
+void looper_set_track_volume(uint8_t track, uint8_t volume);
+void looper_clock_start();
+void looper_clock_continue();
+void looper_clock_stop();
 
-extern void note_on(uint8_t note, uint8_t velocity);
-extern void note_off(uint8_t note);
 extern void all_notes_off();
+extern void looper_note_on(uint8_t track, uint8_t id, uint8_t velocity);
+extern void looper_note_off(uint8_t track, uint8_t id);
+extern void looper_track_notes_off(uint8_t track);
+extern void looper_track_start(uint8_t track, uint8_t instrument);
+extern void looper_tilt(looper_event_type_t type, uint16_t value);
 extern uint8_t get_note_by_id(uint8_t id);
+extern void send_midi_realtime(uint8_t status);
 
 #ifdef __cplusplus
 }
@@ -14,6 +14,7 @@ typedef uint8_t byte;
 #include "hardware/flash.h"
 #include "pico/binary_info.h"
 #include "pico/multicore.h"
+#include <string.h>
 #include "sound_i2s.h"
 #include "pra32-u-common.h" // https://github.com/risgk/digital-synth-pra32-u
 #include "pra32-u-synth.h"  // PRA32-U version 2.3.1
@@ -23,10 +24,29 @@ typedef uint8_t byte;
 #include "bsp/board_api.h"  // For TinyUSB Midi
 #include "tusb.h"           // For TinyUSB Midi
 #include "scales.h"
+#include "tunings.h"
 #include "battery-check.h"
 #include "imu.h"
 #include "touch.h"
 #include "looper.h"
+#include "preset_bank.h"
+#include "morph.h"
+#include "smoothing.h"
+#include "midi_limiter.h"
+#include "midi_queue.h"
+#include "midi_in.h"
+#include "midi_clock.h"
+#include "mpe.h"
+#include "sysex.h"
+#include "midi_uart.h"
+#include "input_trace.h"
+#include "profiler.h"
+#include "scheduler.h"
+#include "input_queue.h"
+#include "encoder_accel.h"
+#include "arp.h"
+#include "seq.h"
+#include "synth_queue.h"
 #include "display/display.h"
 #include "state.h"
 
@@ -38,7 +58,6 @@ state_t* state;
 
 Imu_data imu_data;
 
-uint8_t **user_presets;
 uint8_t **user_scales;
 
 #if defined (USE_DISPLAY)
@@ -47,10 +66,30 @@ ssd1306_t display;
 
 static alarm_id_t power_on_alarm_id;
 static alarm_id_t long_press_alarm_id;
+static encoder_accel_t encoder_accel;
+static bool button_held;
+static int8_t button_press; // Tells the long press alarms of successive presses apart
 static bool looper_button_pending;
-static alarm_id_t flash_write_alarm_id;
+static bool flash_write_pending;
+static uint32_t flash_write_due_us;
+
+#if defined (USE_MIDI)
+static midi_limiter_t midi_bend_limiter;
+static midi_limiter_t midi_cutoff_limiter;
+#endif
+#if defined (MIDI_MPE)
+static midi_limiter_t mpe_bend_limiters[MPE_MEMBER_CHANNELS];
+static midi_limiter_t mpe_pressure_limiters[MPE_MEMBER_CHANNELS];
+#endif
 
 void core1_main();
+void request_flash_write();
+
+#if defined (USE_PROFILER)
+#define PROFILER_MARK(task) profiler_mark(task) // The main loop time since the previous mark goes to this task
+#else
+#define PROFILER_MARK(task)
+#endif
 
 /* User Presets and flash memory */
 static inline uint8_t get_argument_from_parameter(uint8_t parameter) {
@@ -72,42 +111,151 @@ static inline void update_degree() {
                              // and the name of the scale must be changed to "Custom"
 }
 
-void load_user_preset(uint8_t instrument) {
-    uint8_t preset_num = instrument - 9; // Subtracting the 9 default presets
+/* Preset switching */
+// Presets are not applied to the synth directly from core0. Instead, they are
+// staged in this mailbox and committed by core1 at an audio buffer boundary,
+// so that the synth never renders a mix of the old and new parameters.
+// The sequence number works as a seqlock: it is odd while core0 is writing.
+// The morphed parameters go through a mailbox of their own.
+typedef struct {
+    volatile uint32_t seq;
+    int8_t program;                     // PRA32-U program number, or -1 to use params
+    uint8_t params[PROGRAM_PARAMS_NUM];
+    uint32_t fetched_seq;               // Core1 only
+} preset_mailbox_t;
+
+static preset_mailbox_t preset_mailbox;
+static preset_mailbox_t morph_mailbox;
+
+static void stage_params(preset_mailbox_t *mailbox, int8_t program, const uint8_t *params) {
+    mailbox->seq++;
+    __mem_fence_release();
+    mailbox->program = program;
+    if (params != NULL) {
+        memcpy(mailbox->params, params, PROGRAM_PARAMS_NUM);
+    }
+    __mem_fence_release();
+    mailbox->seq++;
+}
+
+static inline void stage_preset(int8_t program, const uint8_t *params) {
+    stage_params(&preset_mailbox, program, params);
+}
+
+// Called from core1. Returns true if new parameters have been copied to program and params.
+static inline bool fetch_staged_params(preset_mailbox_t *mailbox, int8_t *program, uint8_t *params) {
+    uint32_t seq = mailbox->seq;
+    if (seq == mailbox->fetched_seq || (seq & 1)) { return false; } // Nothing new, or write in progress
+    __mem_fence_acquire();
+    *program = mailbox->program;
+    memcpy(params, mailbox->params, PROGRAM_PARAMS_NUM);
+    __mem_fence_acquire();
+    if (mailbox->seq != seq) { return false; } // Overwritten while reading, retry later
+    mailbox->fetched_seq = seq;
+    return true;
+}
+
+// Called from core1
+static inline void apply_preset(int8_t program, const uint8_t *params) {
+    // The preset overwrites the cutoff, restore the IMU-driven value if active
+    smoothing_invalidate(SMOOTH_CUTOFF);
+    if (program >= 0) {
+        g_synth.program_change(program);
+        return;
+    }
     for (uint32_t i = 0; i < PROGRAM_PARAMS_NUM; i++) {
-        g_synth.control_change(dodepan_program_parameters[i], user_presets[preset_num][i]);
+        g_synth.control_change(dodepan_program_parameters[i], params[i]);
+    }
+}
+
+// Called from core1, at a buffer boundary, after any preset switch
+static inline void apply_morph(const uint8_t *params) {
+    for (uint32_t i = 0; i < PROGRAM_PARAMS_NUM; i++) {
+        uint8_t control_number = dodepan_program_parameters[i];
+        if (g_synth.current_controller_value(control_number) == params[i]) { continue; }
+        g_synth.control_change(control_number, params[i]);
+    }
+}
+
+void load_user_preset(uint8_t slot) {
+    // Parameters are read in place from the preset bank
+    const uint8_t *params = preset_bank_get(slot);
+    if (params == NULL) { params = dodepan_preset; } // Empty slot
+    stage_preset(-1, params);
+}
+
+// Return the parameters of an instrument, or NULL for the PRA32-U presets
+static inline const uint8_t* get_instrument_params(uint8_t instrument) {
+    if (instrument == 0) { return dodepan_preset; }
+    if (instrument < NUM_INSTRUMENTS_BUILTIN) { return NULL; }
+    const uint8_t *params = preset_bank_get(instrument - NUM_INSTRUMENTS_BUILTIN);
+    return (params == NULL ? dodepan_preset : params);
+}
+
+// Waveforms, modes and destinations are switched rather than interpolated when morphing
+static uint64_t get_stepped_parameters_mask() {
+    uint64_t mask = 0;
+    for (uint8_t i = 0; i < PROGRAM_PARAMS_NUM; i++) {
+        switch (dodepan_program_parameters[i]) {
+            case OSC_1_WAVE:
+            case OSC_2_WAVE:
+            case EG_OSC_DST:
+            case VOICE_MODE:
+            case LFO_WAVE:
+            case LFO_OSC_DST:
+            case FILTER_MODE:
+            case EG_AMP_MOD:
+            case REL_EQ_DECAY:
+            case P_BEND_RANGE:
+            case DELAY_MODE:
+                mask |= (1ULL << i);
+            break;
+        }
     }
+    return mask;
+}
+
+// Set up morphing from the current instrument into the selected user preset
+void update_morph() {
+    int8_t slot = get_morph_slot();
+    const uint8_t *source = get_instrument_params(get_instrument());
+    const uint8_t *target = (slot == -1 ? NULL : preset_bank_get(slot));
+    if (source == NULL || target == NULL) {
+        morph_stop();
+        return;
+    }
+    morph_start(source, target, PROGRAM_PARAMS_NUM, get_stepped_parameters_mask());
 }
 
 static inline void sync_control_change() {
     uint8_t parameter = get_parameter();
     uint8_t control_number = dodepan_program_parameters[parameter];
     uint8_t argument = get_argument();
-    g_synth.control_change(control_number, argument);
+    synth_queue_push(time_us_32(), SYNTH_CONTROL_CHANGE, control_number, argument);
 }
 
 void update_instrument() {
     uint8_t instrument = get_instrument();
-    switch (instrument) {
-        case 0: // Load custom Dodepan preset
-            for (uint32_t i = 0; i < PROGRAM_PARAMS_NUM; i++) {
-                g_synth.control_change(dodepan_program_parameters[i], dodepan_preset[i]);
-            }
-            set_preset_slot(-1); // No slot selected
-        break;
-        case 9:
-        case 10:
-        case 11:
-        case 12:
-            load_user_preset(instrument);
-            // Set preset_slot selection to match loaded instrument
-            set_preset_slot(instrument - 9);
-        break;
-        default: // case 1-8: load PRA32-U presets
-            g_synth.program_change(instrument - 1);
-            set_preset_slot(-1); // No slot selected
-        break;
+    if (instrument == 0) { // Load custom Dodepan preset
+        stage_preset(-1, dodepan_preset);
+        set_preset_slot(-1); // No slot selected
+    } else if (instrument < NUM_INSTRUMENTS_BUILTIN) { // Load PRA32-U presets
+        stage_preset(instrument - 1, NULL);
+        set_preset_slot(-1); // No slot selected
+    } else { // Load user presets
+        uint8_t slot = instrument - NUM_INSTRUMENTS_BUILTIN;
+        load_user_preset(slot);
+        // Set preset_slot selection to match loaded instrument
+        set_preset_slot(slot);
     }
+    update_morph();
+}
+
+static void set_arp_defaults() {
+    set_arp_pattern(ARP_OFF);
+    set_arp_rate(3); // 1/16
+    set_arp_octaves(1);
+    set_arp_gate(ARP_GATE_MAX / 2);
 }
 
 bool load_flash_data() { // Only called at startup
@@ -123,10 +271,18 @@ bool load_flash_data() { // Only called at startup
     
     if((stored_data[MAGIC_NUMBER_LENGTH + 0] > HIGHEST_KEY)          || // Validate key
        (stored_data[MAGIC_NUMBER_LENGTH + 1] > NUM_SCALES -1)        || // Validate scale
-       (stored_data[MAGIC_NUMBER_LENGTH + 2] > 8 + NUM_PRESET_SLOTS) || // Validate instrument
+       (stored_data[MAGIC_NUMBER_LENGTH + 2] > NUM_INSTRUMENTS - 1)  || // Validate instrument
        (stored_data[MAGIC_NUMBER_LENGTH + 3] > 0x03)                 || // Validate IMU configuration
        (stored_data[MAGIC_NUMBER_LENGTH + 4] > 8)                    || // Validate volume
-       (stored_data[MAGIC_NUMBER_LENGTH + 5] > CONTRAST_AUTO)           // Validate contrast
+       (stored_data[MAGIC_NUMBER_LENGTH + 5] > CONTRAST_AUTO)        || // Validate contrast
+       (stored_data[MAGIC_NUMBER_LENGTH + 6] > FLASH_DATA_VERSION)   || // Validate data version
+       (stored_data[MAGIC_NUMBER_LENGTH + 7] > NUM_PRESET_SLOTS)     || // Validate morph slot
+       (stored_data[MAGIC_NUMBER_LENGTH + 8] > NUM_TUNINGS - 1)      || // Validate tuning
+       (stored_data[MAGIC_NUMBER_LENGTH + 9] > CHORD_LAST - 1)       || // Validate chord mode
+       ((stored_data[MAGIC_NUMBER_LENGTH + 10] & 0x0F) > ARP_PATTERN_LAST - 1)   || // Validate arpeggiator pattern
+       ((stored_data[MAGIC_NUMBER_LENGTH + 10] >> 4) > NOTE_OCTAVES - 1)         || // and octave range
+       ((stored_data[MAGIC_NUMBER_LENGTH + 11] & 0x0F) > NUM_ARP_RATES - 1)      || // Validate arpeggiator rate
+       ((stored_data[MAGIC_NUMBER_LENGTH + 11] >> 4) > ARP_GATE_MAX)                // and gate length
     ) { return false; } // Invalid data
 
     // Data is valid and can be loaded safely
@@ -136,13 +292,35 @@ bool load_flash_data() { // Only called at startup
     set_imu_axes(        stored_data[MAGIC_NUMBER_LENGTH + 3]);
     set_volume(          stored_data[MAGIC_NUMBER_LENGTH + 4]);
     set_contrast(        stored_data[MAGIC_NUMBER_LENGTH + 5]);
+    uint8_t version =    stored_data[MAGIC_NUMBER_LENGTH + 6] ;
+    set_morph_slot(      stored_data[MAGIC_NUMBER_LENGTH + 7] - 1); // Stored as slot + 1
+    set_tuning(          stored_data[MAGIC_NUMBER_LENGTH + 8]);
+    set_chord_mode((chord_mode_t)stored_data[MAGIC_NUMBER_LENGTH + 9]);
+    if ((stored_data[MAGIC_NUMBER_LENGTH + 11] >> 4) == 0) {
+        set_arp_defaults(); // Stored by an older firmware version, without arpeggiator
+    } else {
+        // Pattern and octave range - 1 in the lower and upper nibbles
+        set_arp_pattern((arp_pattern_t)(stored_data[MAGIC_NUMBER_LENGTH + 10] & 0x0F));
+        set_arp_octaves((stored_data[MAGIC_NUMBER_LENGTH + 10] >> 4) + 1);
+        // Rate and gate length in the lower and upper nibbles
+        set_arp_rate(stored_data[MAGIC_NUMBER_LENGTH + 11] & 0x0F);
+        set_arp_gate(stored_data[MAGIC_NUMBER_LENGTH + 11] >> 4);
+    }
 
-    // Load user presets
     uint8_t offset = MAGIC_NUMBER_LENGTH + 12;
-    for (uint8_t i = 0; i < NUM_PRESET_SLOTS; i++) {
-        for (uint8_t j = 0; j < PROGRAM_PARAMS_NUM; j++) {
-            user_presets[i][j] = stored_data[offset++];
+    if (version == 0) {
+        // Older firmware versions stored the user presets in this page.
+        // Move them to the preset bank, unless it already has data.
+        for (uint8_t i = 0; i < NUM_LEGACY_PRESET_SLOTS; i++) {
+            if (!preset_bank_is_used(i)) {
+                preset_bank_store(i, &stored_data[offset], PROGRAM_PARAMS_NUM);
+            }
+            offset += PROGRAM_PARAMS_NUM;
         }
+        // Rewrite the data in the current format
+        set_preset_has_changes(true);
+        set_scale_has_changes(true);
+        request_flash_write();
     }
     update_instrument();
 
@@ -161,7 +339,7 @@ bool load_flash_data() { // Only called at startup
     return true;
 }
 
-int64_t write_flash_data(alarm_id_t id, void *) {
+void write_flash_data() {
     // Initialize the buffer with a signature
     uint8_t flash_buffer[FLASH_PAGE_SIZE] = MAGIC_NUMBER;
     uint8_t index = MAGIC_NUMBER_LENGTH;
@@ -173,6 +351,12 @@ int64_t write_flash_data(alarm_id_t id, void *) {
     flash_buffer[MAGIC_NUMBER_LENGTH + 3] = get_imu_axes();
     flash_buffer[MAGIC_NUMBER_LENGTH + 4] = get_volume();
     flash_buffer[MAGIC_NUMBER_LENGTH + 5] = get_contrast();
+    flash_buffer[MAGIC_NUMBER_LENGTH + 6] = FLASH_DATA_VERSION;
+    flash_buffer[MAGIC_NUMBER_LENGTH + 7] = get_morph_slot() + 1;
+    flash_buffer[MAGIC_NUMBER_LENGTH + 8] = get_tuning();
+    flash_buffer[MAGIC_NUMBER_LENGTH + 9] = get_chord_mode();
+    flash_buffer[MAGIC_NUMBER_LENGTH + 10] = get_arp_pattern() | ((get_arp_octaves() - 1) << 4);
+    flash_buffer[MAGIC_NUMBER_LENGTH + 11] = get_arp_rate() | (get_arp_gate() << 4);
 
     // Stop here if the stored data is the same as what we're about to write
     const uint8_t *stored_data = (const uint8_t *) (XIP_BASE + FLASH_TARGET_OFFSET);
@@ -182,20 +366,18 @@ int64_t write_flash_data(alarm_id_t id, void *) {
         stored_data[MAGIC_NUMBER_LENGTH + 3] == flash_buffer[MAGIC_NUMBER_LENGTH + 3] &&
         stored_data[MAGIC_NUMBER_LENGTH + 4] == flash_buffer[MAGIC_NUMBER_LENGTH + 4] &&
         stored_data[MAGIC_NUMBER_LENGTH + 5] == flash_buffer[MAGIC_NUMBER_LENGTH + 5] &&
+        stored_data[MAGIC_NUMBER_LENGTH + 6] == flash_buffer[MAGIC_NUMBER_LENGTH + 6] &&
+        stored_data[MAGIC_NUMBER_LENGTH + 7] == flash_buffer[MAGIC_NUMBER_LENGTH + 7] &&
+        stored_data[MAGIC_NUMBER_LENGTH + 8] == flash_buffer[MAGIC_NUMBER_LENGTH + 8] &&
+        stored_data[MAGIC_NUMBER_LENGTH + 9] == flash_buffer[MAGIC_NUMBER_LENGTH + 9] &&
+        stored_data[MAGIC_NUMBER_LENGTH + 10] == flash_buffer[MAGIC_NUMBER_LENGTH + 10] &&
+        stored_data[MAGIC_NUMBER_LENGTH + 11] == flash_buffer[MAGIC_NUMBER_LENGTH + 11] &&
         get_preset_has_changes() == false &&
-        get_scale_has_changes()  == false) { return 0; }
-
-    // Reserving bytes MAGIC_NUMBER_LENGTH + [6-11] for future firmware versions
+        get_scale_has_changes()  == false) { return; }
 
-    // Add user presets to the write buffer
+    // Add user scales to the write buffer.
+    // User presets are not stored here but in the preset bank.
     uint8_t offset = MAGIC_NUMBER_LENGTH + 12;
-    for (uint8_t i = 0; i < NUM_PRESET_SLOTS; i++) {
-        for (uint8_t j = 0; j < PROGRAM_PARAMS_NUM; j++) {
-            flash_buffer[offset++] = user_presets[i][j];
-        }
-    }
-
-    // Add user scales to the write buffer
     for (uint8_t i = 0; i < NUM_SCALE_SLOTS; i++) {
         for (uint8_t j = 0; j < 12; j++) {
             flash_buffer[offset++] = user_scales[i][j];
@@ -214,6 +396,9 @@ int64_t write_flash_data(alarm_id_t id, void *) {
 	flash_range_program(FLASH_TARGET_OFFSET, flash_buffer, FLASH_PAGE_SIZE);
 	restore_interrupts (ints_id);
 
+    // Write pending changes to the preset bank
+    preset_bank_flush();
+
     // Restart processes on core1
     multicore_launch_core1(core1_main);
 
@@ -223,28 +408,35 @@ int64_t write_flash_data(alarm_id_t id, void *) {
 
     // Turn off built-in LED
     gpio_put(PICO_DEFAULT_LED_PIN, 0);
-
-    return 0;
 }
 
 void request_flash_write() {
     // Schedule writing settings to flash.
     // This delay is introduced to minimize write operations.
-    if (flash_write_alarm_id) cancel_alarm(flash_write_alarm_id);
-    flash_write_alarm_id = add_alarm_in_ms(FLASH_WRITE_DELAY_S * 1000, write_flash_data, NULL, true);
+    // The write itself runs in the main loop (see run_flash), never in an interrupt,
+    // so that it can't interleave with the code editing the data to be written.
+    flash_write_due_us = time_us_32() + FLASH_WRITE_DELAY_S * 1000000;
+    flash_write_pending = true;
+}
+
+static void store_preset(uint8_t slot, const uint8_t *params) {
+    // Staged in RAM, and written with the settings by run_flash()
+    preset_bank_store(slot, params, PROGRAM_PARAMS_NUM);
+    set_preset_has_changes(true);
+    request_flash_write();
 }
 
 void submit_preset_slot() {
     int8_t slot = get_preset_slot();
     if(slot == -1) { return; }
+    uint8_t params[PROGRAM_PARAMS_NUM];
     for (uint8_t i = 0; i < PROGRAM_PARAMS_NUM; i++) {
-        user_presets[slot][i] = get_argument_from_parameter(i);
+        params[i] = get_argument_from_parameter(i);
     }
-    set_preset_has_changes(true);
-    request_flash_write();
+    store_preset(slot, params);
 
     // Since we've written a preset, let's select it on the main screen
-    set_instrument(9 + slot);
+    set_instrument(NUM_INSTRUMENTS_BUILTIN + slot);
 }
 
 void submit_scale_slot() {
@@ -263,12 +455,74 @@ void submit_scale_slot() {
     set_scale(NUM_SCALES_BUILTIN + slot);
 }
 
-/* Note and audio */
+/* SysEx dump and load */
+// User presets and scales are sent as their raw bytes, the looper recording serialized
+
+uint8_t sysex_object_count(uint8_t type) {
+    switch (type) {
+        case SYSEX_PRESET: return NUM_PRESET_SLOTS;
+        case SYSEX_SCALE:  return NUM_SCALE_SLOTS;
+        case SYSEX_LOOP:   return LOOPER_TRACKS;
+        default:           return 0;
+    }
+}
+
+uint16_t sysex_object_size(uint8_t type, uint8_t index) {
+    if (index >= sysex_object_count(type)) { return 0; }
+    switch (type) {
+        case SYSEX_PRESET: return (preset_bank_is_used(index) ? PROGRAM_PARAMS_NUM : 0);
+        case SYSEX_SCALE:  return 12;
+        case SYSEX_LOOP:   return looper_get_dump_size(index);
+        default:           return 0;
+    }
+}
+
+void sysex_object_read(uint8_t type, uint8_t index, uint16_t offset, uint8_t *data, uint8_t length) {
+    switch (type) {
+        case SYSEX_PRESET:
+            memcpy(data, preset_bank_get(index) + offset, length);
+        break;
+        case SYSEX_SCALE:
+            memcpy(data, &user_scales[index][offset], length);
+        break;
+        case SYSEX_LOOP:
+            looper_dump(index, offset, data, length);
+        break;
+    }
+}
 
-uint8_t get_note_by_id(uint8_t id) {
-    return get_key() + get_extended_scale(id);
+// Presets and scales fit in a single chunk, and are only stored once validated
+bool sysex_object_write(uint8_t type, uint8_t index, uint16_t offset,
+                        const uint8_t *data, uint8_t length, uint16_t size) {
+    if (index >= sysex_object_count(type)) { return false; }
+    switch (type) {
+        case SYSEX_PRESET:
+            if (size != PROGRAM_PARAMS_NUM || length != size) { return false; }
+            for (uint8_t i = 0; i < length; i++) {
+                if (data[i] > 127) { return false; }
+            }
+            store_preset(index, data);
+            if (get_instrument() == NUM_INSTRUMENTS_BUILTIN + index) { update_instrument(); }
+            return true;
+        case SYSEX_SCALE:
+            if (size != 12 || length != size) { return false; }
+            for (uint8_t i = 0; i < length; i++) {
+                if (data[i] > 127 - HIGHEST_KEY) { return false; } // Keep the notes in the Midi range
+            }
+            memcpy(user_scales[index], data, length);
+            if (get_scale() == NUM_SCALES_BUILTIN + index) { set_and_extend_scale(get_scale()); }
+            set_scale_has_changes(true);
+            request_flash_write();
+            return true;
+        case SYSEX_LOOP:
+            return looper_load(index, offset, data, length, size);
+        default:
+            return false;
+    }
 }
 
+/* Note and audio */
+
 static const struct sound_i2s_config sound_config = {
     .pio_num         = I2S_PIO_NUM,
     .pin_scl         = I2S_CLOCK_PIN_BASE,
@@ -279,102 +533,637 @@ static const struct sound_i2s_config sound_config = {
     .samples_per_buffer = AUDIO_BUFFER_LENGTH,
 };
 
-static inline uint32_t tudi_midi_write24 (uint8_t jack_id, uint8_t b1, uint8_t b2, uint8_t b3) {
-    uint8_t msg[3] = { b1, b2, b3 };
-    return tud_midi_stream_write(jack_id, msg, 3);
+// Messages are queued, and written to USB by midi_queue_flush() in the main loop.
+// The serial output, if enabled, gets the same messages.
+static inline bool tudi_midi_write24 (uint8_t jack_id, uint8_t b1, uint8_t b2, uint8_t b3) {
+#if defined (INPUT_TRACE)
+    input_trace_log_output(b1, b2, b3);
+#endif
+#if defined (USE_MIDI_DIN)
+    midi_uart_write(b1, b2, b3);
+#endif
+    return midi_queue_push(jack_id, b1, b2, b3);
+}
+
+// For controllers that must not be reordered after the notes that follow them
+static inline bool tudi_midi_write24_ordered (uint8_t jack_id, uint8_t b1, uint8_t b2, uint8_t b3) {
+#if defined (INPUT_TRACE)
+    input_trace_log_output(b1, b2, b3);
+#endif
+#if defined (USE_MIDI_DIN)
+    midi_uart_write(b1, b2, b3);
+#endif
+    return midi_queue_push_ordered(jack_id, b1, b2, b3);
+}
+
+// Midi channels of the notes: the pads play on the first channel,
+// and each looper track plays back on its own
+#define NOTE_CHANNELS   LOOPER_TRACKS
+
+// Notes sounding for each note id on each channel, so that they can be ended even if the
+// chord mode, the key or the scale have changed since, and the number of holders of each
+// Midi note on each channel. The synth has a single set of voices, shared by all channels,
+// with its own count of holders on core1, see play_synth_event().
+static uint8_t sounding_notes[NOTE_CHANNELS][NUM_NOTE_IDS][CHORD_NOTES_MAX];
+static uint8_t sounding_count[NOTE_CHANNELS][NUM_NOTE_IDS];
+static uint8_t note_holders[NOTE_CHANNELS][128];
+
+#if defined (MIDI_MPE)
+/* MPE output */
+// Each note is sent on a member channel of its own, with its own pitch bend and pressure
+
+static inline uint8_t get_mpe_pressure() {
+    return (get_imu_axes() & 0x02) ? imu_data.deviation_y : 0;
+}
+
+static void send_rpn(uint8_t channel, uint8_t parameter, uint8_t value) {
+    tudi_midi_write24_ordered(0, 0xB0 | channel, 101, 0);          // Parameter number MSB
+    tudi_midi_write24_ordered(0, 0xB0 | channel, 100, parameter);  // Parameter number LSB
+    tudi_midi_write24_ordered(0, 0xB0 | channel, 6, value);        // Data entry MSB
+}
+
+// Announce the zone, then set the bend range of the members,
+// since the announcement resets it to 48 semitones
+static void send_mpe_configuration() {
+    send_rpn(MPE_MANAGER_CHANNEL, 6, MPE_MEMBER_CHANNELS); // MPE configuration message
+    for (uint8_t member = 0; member < MPE_MEMBER_CHANNELS; member++) {
+        send_rpn(mpe_member_channel(member), 0, MPE_BEND_RANGE);
+    }
+}
+
+// Invoked by tinyusb when the device is mounted
+void tud_mount_cb(void) {
+    send_mpe_configuration();
+}
+
+// Notes are told apart by their channel, their id and their place in the
+// chord of their pad. The arpeggiator and sequencer notes have a channel of
+// their own, after the looper tracks.
+#define MPE_SCHEDULED_CHANNEL   NOTE_CHANNELS
+
+#if NUM_NOTE_IDS > 256 || CHORD_NOTES_MAX > 4 || MPE_SCHEDULED_CHANNEL >= 0x3F
+#error "The MPE note keys do not fit in 16 bits"
+#endif
+
+static inline uint16_t get_mpe_key(uint8_t channel, uint8_t id, uint8_t tone) {
+    return (uint16_t)channel << 10 | (uint16_t)tone << 8 | id;
+}
+
+// Each note of a chord has a member channel of its own, so that it can be
+// bent to its own fine tuning
+static void mpe_note_on(uint16_t key, uint8_t note, int8_t cents, uint8_t velocity) {
+    bool stolen;
+    int8_t channel = mpe_allocate(key, imu_data.deviation_x, cents, &stolen);
+    if (channel == MPE_NO_CHANNEL) { return; }
+    if (stolen) { // All members were busy
+        tudi_midi_write24(0, 0xB0 | channel, 123, 0); // All notes off
+    }
+
+    // The initial expression must reach the receiver before the note
+    uint8_t member = channel - mpe_member_channel(0);
+    uint8_t pressure = get_mpe_pressure();
+    uint16_t bend = mpe_get_bend(member, imu_data.deviation_x); // The fine tuning of the note
+    tudi_midi_write24_ordered(0, 0xE0 | channel, bend & 0x7F, (bend >> 7) & 0x7F);
+    tudi_midi_write24_ordered(0, 0xD0 | channel, pressure, 0);
+    midi_limiter_init(&mpe_bend_limiters[member], bend, MIDI_BEND_THRESHOLD,
+                      MIDI_MIN_INTERVAL_US, MIDI_SETTLE_US);
+    midi_limiter_init(&mpe_pressure_limiters[member], pressure, MIDI_CC_THRESHOLD,
+                      MIDI_MIN_INTERVAL_US, MIDI_SETTLE_US);
+    tudi_midi_write24(0, 0x90 | channel, note, velocity);
+}
+
+static void mpe_note_off(uint16_t key, uint8_t note) {
+    int8_t channel = mpe_release(key);
+    if (channel == MPE_NO_CHANNEL) { return; }
+    tudi_midi_write24(0, 0x80 | channel, note, 0);
+}
+
+// Send the tilt to every sounding note, as per-note pitch bend and channel pressure
+static void mpe_tilt_process() {
+    uint32_t now = time_us_32();
+    for (uint8_t member = 0; member < MPE_MEMBER_CHANNELS; member++) {
+        if (mpe_get_member_key(member) == MPE_NO_KEY) { continue; }
+        uint8_t channel = mpe_member_channel(member);
+
+        if (get_imu_axes() & 0x01) {
+            uint16_t bend = mpe_get_bend(member, imu_data.deviation_x);
+            if (midi_limiter_update(&mpe_bend_limiters[member], bend, now)) {
+                uint16_t bending = mpe_bend_limiters[member].sent;
+                tudi_midi_write24(0, 0xE0 | channel, bending & 0x7F, (bending >> 7) & 0x7F);
+            }
+        }
+        if (get_imu_axes() & 0x02) {
+            if (midi_limiter_update(&mpe_pressure_limiters[member], get_mpe_pressure(), now)) {
+                tudi_midi_write24(0, 0xD0 | channel, mpe_pressure_limiters[member].sent, 0);
+            }
+        }
+    }
+}
+#endif
+
+// The synth has no per-voice fine tuning: the tuning of the latest note
+// is added to the tilt pitch bend by core1, and applies to all the voices.
+// For a chord, that is the tuning of its root.
+static volatile int8_t tuning_cents;
+
+static inline void update_tuning_bend(uint8_t id) {
+    tuning_cents = get_cents_by_id(id);
+}
+
+// A Midi note held several times on a channel, by two pads or by a pad and the
+// arpeggiator for example, is only sent once, and ended by its last holder
+static inline void midi_note_on(uint8_t channel, uint8_t note, uint8_t velocity) {
+    if (note_holders[channel][note]++ > 0) { return; }
+#if !defined (MIDI_MPE)
+    tudi_midi_write24(0, 0x90 | channel, note, velocity);
+#endif
+}
+
+static inline void midi_note_off(uint8_t channel, uint8_t note) {
+    if (note_holders[channel][note] == 0) { return; }
+    if (--note_holders[channel][note] > 0) { return; }
+#if !defined (MIDI_MPE)
+    tudi_midi_write24(0, 0x80 | channel, note, 0);
+#endif
+}
+
+static void channel_note_off(uint8_t channel, uint8_t id);
+
+// A pad plays a single note, or a chord in chord mode. All the notes are
+// dispatched at once, and go out back to back in the same USB transfer.
+static void channel_note_on(uint8_t channel, uint8_t id, uint8_t velocity) {
+    if (sounding_count[channel][id] > 0) { channel_note_off(channel, id); } // Retriggered before its release
+    uint8_t *notes = sounding_notes[channel][id];
+    int8_t cents[CHORD_NOTES_MAX];
+    uint8_t count = get_chord_by_id(id, notes, cents);
+    sounding_count[channel][id] = count;
+    update_tuning_bend(id);
+    uint32_t now = time_us_32();
+    for (uint8_t i = 0; i < count; i++) {
+#if defined (MIDI_MPE)
+        mpe_note_on(get_mpe_key(channel, id, i), notes[i], cents[i], velocity);
+#endif
+        synth_queue_push(now, SYNTH_NOTE_ON, notes[i], velocity);
+        midi_note_on(channel, notes[i], velocity);
+    }
+}
+
+static void channel_note_off(uint8_t channel, uint8_t id) {
+    const uint8_t *notes = sounding_notes[channel][id];
+    uint8_t count = sounding_count[channel][id];
+    sounding_count[channel][id] = 0;
+    uint32_t now = time_us_32();
+    for (uint8_t i = 0; i < count; i++) {
+#if defined (MIDI_MPE)
+        mpe_note_off(get_mpe_key(channel, id, i), notes[i]);
+#endif
+        synth_queue_push(now, SYNTH_NOTE_OFF, notes[i], 0);
+        midi_note_off(channel, notes[i]);
+    }
 }
 
 void note_on(uint8_t id, uint8_t velocity) {
-    uint8_t note = get_note_by_id(id);
-    g_synth.note_on(note, velocity);
-    tudi_midi_write24(0, 0x90, note, velocity);
+    channel_note_on(0, id, velocity);
 }
 
 void note_off(uint8_t id) {
-    uint8_t note = get_note_by_id(id);
-    g_synth.note_off(note);
-    tudi_midi_write24(0, 0x80, note, 0);
+    channel_note_off(0, id);
+}
+
+// The internal synth plays every track with the current instrument. Midi
+// receivers get each track on its own channel, with the track's instrument
+// as program, so that a multitimbral receiver can play them all.
+void looper_note_on(uint8_t track, uint8_t id, uint8_t velocity) {
+    channel_note_on(track, id, velocity);
+}
+
+void looper_note_off(uint8_t track, uint8_t id) {
+    channel_note_off(track, id);
+}
+
+void looper_track_start(uint8_t track, uint8_t instrument) {
+#if defined (USE_MIDI) && !defined (MIDI_MPE) // In MPE mode, the channels belong to the notes
+    tudi_midi_write24(0, 0xC0 | track, instrument, 0);
+#endif
+}
+
+// Send a scheduled note to Midi once it is due.
+// The synth plays it on core1, at its exact time, see synth_queue.h.
+static void scheduled_note_output(const scheduled_note_t *event) {
+    bool is_on = (event->velocity > 0);
+    if (is_on) { update_tuning_bend(event->id); }
+#if defined (MIDI_MPE)
+    uint16_t key = get_mpe_key(MPE_SCHEDULED_CHANNEL, event->id, 0);
+    if (is_on) {
+        mpe_note_on(key, event->note, get_cents_by_id(event->id), event->velocity);
+    } else {
+        mpe_note_off(key, event->note);
+    }
+#else
+    if (is_on) {
+        midi_note_on(0, event->note, event->velocity);
+    } else {
+        midi_note_off(0, event->note);
+    }
+#endif
+}
+
+// The arpeggiator notes are also recorded by the looper, when it is recording
+void arp_output(const scheduled_note_t *event) {
+    bool is_on = (event->velocity > 0);
+    scheduled_note_output(event);
+    if (get_context() == CTX_LOOPER && !looper_is_playing()) {
+        bool was_recording = looper_is_recording();
+        looper_record_at(event->id, event->velocity, is_on, event->time_us);
+#if defined (USE_DISPLAY)
+        if (!was_recording) { display_request_draw(); } // The recording has started
+#endif
+    }
+}
+
+void seq_output(const scheduled_note_t *event) {
+    scheduled_note_output(event);
+}
+
+static inline bool is_arp_active() {
+    return (get_arp_pattern() != ARP_OFF);
 }
 
 void touch_on(uint8_t id) {
+#if defined (INPUT_TRACE)
+    input_trace_record(TRACE_TOUCH, id | 0x10);
+#endif
     // Set the velocity according to accelerometer data.
     // The range of velocity is 0-127, but here it's clamped to 64-127
     uint8_t velocity = imu_data.acceleration;
 
+    if (get_context() == CTX_SEQUENCER) {
+        note_on(id, velocity); // Let the step be heard as it is written
+        seq_write(id, velocity, imu_data.deviation_y);
+#if defined (USE_DISPLAY)
+        display_request_draw();
+#endif
+        return;
+    }
+
     if (looper_is_playing()) {
         if (get_context() != CTX_LOOPER) {
             looper_stop(); // Stop playback, preserve recording, don't start a new one
-            note_on(id, velocity);
+            if (is_arp_active()) {
+                arp_hold(id, velocity);
+            } else {
+                note_on(id, velocity);
+            }
 #if defined (USE_DISPLAY)
-            display_draw(&display);
+            display_request_draw();
 #endif
             return;
         }
-        all_notes_off(); // Stop loop notes before playing the new note
+        // A new recording stops the loop: end its notes before playing the new note.
+        // An overdub plays over the other tracks, and over the notes already held.
+        if (!looper_keeps_playing()) { all_notes_off(); }
     }
-    note_on(id, velocity);
+    if (is_arp_active()) {
+        arp_hold(id, velocity); // The looper records the arpeggio instead of the pads
+        return;
+    }
+    // Recorded first: starting an overdub ends the notes the track was playing
     if (get_context() == CTX_LOOPER) {
         looper_record(id, velocity, true);
     }
+    note_on(id, velocity);
 
     // Since a note_on event can start the looper recording,
     // a display draw needs to be called here.
 #if defined (USE_DISPLAY)
-    display_draw(&display);
+    display_request_draw();
 #endif
 }
 
 void touch_off(uint8_t id) {
+#if defined (INPUT_TRACE)
+    input_trace_record(TRACE_TOUCH, id);
+#endif
+    if (get_context() == CTX_SEQUENCER) {
+        note_off(id);
+        return;
+    }
+    if (is_arp_active()) {
+        arp_release(id);
+        return;
+    }
     note_off(id);
     if (get_context() == CTX_LOOPER) {
         looper_record(id, 0, false);
     }
 }
 
+static void channel_notes_off(uint8_t channel) {
+    for (uint8_t id = 0; id < NUM_NOTE_IDS; id++) {
+        if (sounding_count[channel][id] > 0) { channel_note_off(channel, id); }
+    }
+}
+
+// End the notes of a track, when it is overdubbed. The first track shares
+// its channel with the pads, whose notes end along with it.
+void looper_track_notes_off(uint8_t track) {
+    channel_notes_off(track);
+}
+
 void all_notes_off() {
-    g_synth.all_notes_off();
+    // End the pad and track notes one by one first, so that Midi receivers get their note off
+    for (uint8_t channel = 0; channel < NOTE_CHANNELS; channel++) {
+        channel_notes_off(channel);
+    }
+    synth_queue_push(time_us_32(), SYNTH_ALL_NOTES_OFF, 0, 0);
+}
+
+/* Midi input */
+// Incoming Midi messages drive the synth directly, bypassing the key and scale
+
+// Like the pads, they are played by core1, which counts the holders of each note
+void midi_in_note_on(uint8_t note, uint8_t velocity) {
+    synth_queue_push(time_us_32(), SYNTH_NOTE_ON, note, velocity);
+}
+
+void midi_in_note_off(uint8_t note) {
+    synth_queue_push(time_us_32(), SYNTH_NOTE_OFF, note, 0);
+}
+
+void midi_in_control_change(uint8_t control_number, uint8_t value) {
+    synth_queue_push(time_us_32(), SYNTH_CONTROL_CHANGE, control_number, value);
+}
+
+void midi_in_program_change(uint8_t program) {
+    // Programs are numbered like the instruments
+    if (program >= NUM_INSTRUMENTS) { return; }
+    set_instrument(program);
+    update_instrument();
+#if defined (USE_DISPLAY)
+    display_request_draw();
+#endif
+}
+
+// Replaces the tilt bend until the device is tilted again
+void midi_in_pitch_bend(uint8_t lsb, uint8_t msb) {
+    synth_queue_push(time_us_32(), SYNTH_PITCH_BEND, lsb, msb);
+}
+
+// The looper follows the incoming Midi clock and transport
+void midi_in_clock() {
+    midi_clock_tick(time_us_32());
+}
+
+void midi_in_start() {
+    midi_clock_start();
+    looper_clock_start();
+#if defined (USE_DISPLAY)
+    display_request_draw();
+#endif
+}
+
+void midi_in_continue() {
+    midi_clock_continue();
+    looper_clock_continue();
+#if defined (USE_DISPLAY)
+    display_request_draw();
+#endif
+}
+
+void midi_in_stop() {
+    midi_clock_stop();
+    looper_clock_stop();
+#if defined (USE_DISPLAY)
+    display_request_draw();
+#endif
+}
+
+void send_midi_realtime(uint8_t status) {
+    tudi_midi_write24(0, status, 0, 0);
+}
+
+static inline void tilt_morph() {
+    static uint64_t dirty_mask; // Parameters changed since they were last staged
+    static uint32_t staged_us;
+
+    // Pitching the device forward morphs the current instrument into the target preset
+    uint8_t position = (imu_data.deviation_y > 64 ? (imu_data.deviation_y - 64) * 2 : 0);
+    if (position > 127) { position = 127; }
+    dirty_mask |= morph_update(position);
+
+    // Stage the values for core1 at most once per MORPH_INTERVAL_US. Core1 only
+    // sends the parameters that differ from the synth's, see apply_morph().
+    uint32_t now = time_us_32();
+    if (dirty_mask == 0 || (int32_t)(now - staged_us) < MORPH_INTERVAL_US) { return; }
+    staged_us = now;
+    dirty_mask = 0;
+    uint8_t params[PROGRAM_PARAMS_NUM];
+    for (uint8_t i = 0; i < PROGRAM_PARAMS_NUM; i++) {
+        params[i] = morph_get_value(i);
+    }
+    stage_params(&morph_mailbox, -1, params);
 }
 
-// Use the IMU to alter parameters according to device tilting
+// Play back the cutoff tilt recorded with a sequencer step
+void seq_automate(uint8_t cutoff) {
+    if (!(get_imu_axes() & 0x02) || morph_is_active()) { return; }
+    smoothing_set_target(SMOOTH_CUTOFF, cutoff);
+#if defined (USE_MIDI)
+    tudi_midi_write24(0, 0xB0, FILTER_CUTOFF, cutoff);
+#endif
+}
+
+// Play back the tilt recorded by the looper. It is already decimated,
+// so the Midi messages are sent as they come.
+void looper_tilt(looper_event_type_t type, uint16_t value) {
+    if (type == LOOPER_CUTOFF) {
+        if (!(get_imu_axes() & 0x02) || morph_is_active()) { return; }
+        smoothing_set_target(SMOOTH_CUTOFF, value);
+#if defined (USE_MIDI)
+        tudi_midi_write24(0, 0xB0, FILTER_CUTOFF, value);
+#endif
+    } else {
+        if (!(get_imu_axes() & 0x01)) { return; }
+        smoothing_set_target(SMOOTH_PITCH_BEND, value);
+#if defined (USE_MIDI) && !defined (MIDI_MPE)
+        tudi_midi_write24(0, 0xE0, value & 0x7F, (value >> 7) & 0x7F);
+#endif
+    }
+}
+
+// Use the IMU to alter parameters according to device tilting.
+// Cutoff and pitch bend are only set as targets here: they are smoothed
+// and sent to the synth by core1, once per audio buffer.
 void tilt_process() {
-    if(get_imu_axes() & 0x02) {
-        g_synth.control_change(FILTER_CUTOFF, imu_data.deviation_y);
+#if defined (MIDI_MPE)
+    mpe_tilt_process();
+#endif
+    if((get_imu_axes() & 0x02) && morph_is_active()) {
+        smoothing_release(SMOOTH_CUTOFF);
+        tilt_morph();
+    } else if((get_imu_axes() & 0x02) && (seq_is_playing() || looper_plays_tilt(LOOPER_CUTOFF))) {
+        ; // The cutoff is played back, see seq_automate() and looper_tilt()
+    } else if(get_imu_axes() & 0x02) {
+        smoothing_set_target(SMOOTH_CUTOFF, imu_data.deviation_y);
+        looper_record_tilt(LOOPER_CUTOFF, imu_data.deviation_y);
+#if defined (USE_MIDI)
+        if (midi_limiter_update(&midi_cutoff_limiter, imu_data.deviation_y, time_us_32())) {
+            tudi_midi_write24(0, 0xB0, FILTER_CUTOFF, midi_cutoff_limiter.sent);
+        }
+#endif
+    } else {
+        smoothing_release(SMOOTH_CUTOFF);
     }
 
-    // Split the bytes
-    uint8_t bending_lsb = imu_data.deviation_x & 0x7F;
-    uint8_t bending_msb = (imu_data.deviation_x >> 7) & 0x7F;
+    if(!(get_imu_axes() & 0x01)) {
+        smoothing_release(SMOOTH_PITCH_BEND);
+        return;
+    }
+
+    if (looper_plays_tilt(LOOPER_BEND)) { return; } // See looper_tilt()
 
     // Send the instruction to the synth
-    if(get_imu_axes() & 0x01) {
-        g_synth.pitch_bend(bending_lsb, bending_msb);
+    smoothing_set_target(SMOOTH_PITCH_BEND, imu_data.deviation_x);
+    looper_record_tilt(LOOPER_BEND, imu_data.deviation_x);
 
-#if defined (USE_MIDI)
-        static uint8_t throttle;
-        if(throttle++ % 10 != 0) return; // Limit the message rate
+#if defined (USE_MIDI) && !defined (MIDI_MPE) // In MPE mode, each note is bent on its own
+    // Limit the message rate, but always send the value the device comes to rest on
+    if (midi_limiter_update(&midi_bend_limiter, imu_data.deviation_x, time_us_32())) {
         // Pitch wheel range is between 0 and 16383 (0x0000 to 0x3FFF),
         // with 8192 (0x2000) being the center value.
-        // Send the Midi message
-        tudi_midi_write24 (0, 0xE0, bending_lsb, bending_msb);
+        // Split the bytes and send the Midi message
+        uint16_t bending = midi_bend_limiter.sent;
+        tudi_midi_write24 (0, 0xE0, bending & 0x7F, (bending >> 7) & 0x7F);
+    }
 #endif
+}
+
+#define SAMPLE_PERIOD_US_Q8 ((1000000 << 8) / SOUND_OUTPUT_FREQUENCY) // With 8 fractional bits
+
+// Number of note ons of each note not ended yet, whatever their source:
+// a note held twice, by a pad and by the arpeggiator for example,
+// keeps its voice until both have ended it. Core1 only.
+static uint8_t voice_holders[128];
+
+// Pitch bend from the tilt or the Midi input, before the tuning is added. Core1 only.
+static uint16_t base_bend = 0x2000;
+static bool base_bend_changed;
+
+static inline void __not_in_flash_func(play_synth_event)(const synth_event_t *event) {
+    switch (event->type) {
+        case SYNTH_NOTE_ON:
+            if (voice_holders[event->data1]++ > 0) { return; } // Already sounding
+            g_synth.note_on(event->data1, event->data2);
+        break;
+        case SYNTH_NOTE_OFF:
+            if (voice_holders[event->data1] == 0) { return; } // Ended by all notes off
+            if (--voice_holders[event->data1] > 0) { return; }
+            g_synth.note_off(event->data1);
+        break;
+        case SYNTH_ALL_NOTES_OFF:
+            memset(voice_holders, 0, sizeof(voice_holders));
+            g_synth.all_notes_off();
+        break;
+        case SYNTH_CONTROL_CHANGE:
+            g_synth.control_change(event->data1, event->data2);
+        break;
+        case SYNTH_PITCH_BEND:
+            base_bend = (event->data2 & 0x7F) << 7 | (event->data1 & 0x7F);
+            base_bend_changed = true; // Sent with the next buffer
+        break;
     }
 }
 
+// Start and end the notes at the sample they are due
+static inline void __not_in_flash_func(play_scheduled_notes)(uint32_t time_us) {
+    synth_event_t event;
+    while (synth_queue_pop_due(time_us, &event)) {
+        play_synth_event(&event);
+    }
+}
+
+typedef enum preset_switch_phase {
+    PRESET_SWITCH_IDLE,
+    PRESET_SWITCH_FADE_OUT,
+    PRESET_SWITCH_FADE_IN,
+} preset_switch_phase_t;
+
 static void __not_in_flash_func(i2s_audio_task)(void) {
     static int16_t *last_buffer;
+    static preset_switch_phase_t phase;
+    static int8_t program;
+    static uint8_t params[PROGRAM_PARAMS_NUM];
+    static uint8_t morph_params[PROGRAM_PARAMS_NUM];
+    static int16_t last_tuning_bend;
     int16_t *buffer = sound_i2s_get_next_buffer();
+    uint32_t buffer_us = time_us_32();
     int16_t right_buffer; // Necessary quirk for compatibility with
                           // the original PRA32-U code
             
     if (buffer != last_buffer) { 
         last_buffer = buffer;
+
+        // Presets are switched at buffer boundaries. With PRESET_SWITCH_FADE,
+        // the output is faded out over one buffer before the switch
+        // and faded back in over the next one.
+        if (phase == PRESET_SWITCH_FADE_OUT) {
+            apply_preset(program, params);
+            phase = PRESET_SWITCH_FADE_IN;
+        } else if (fetch_staged_params(&preset_mailbox, &program, params)) {
+#if defined (PRESET_SWITCH_FADE)
+            phase = PRESET_SWITCH_FADE_OUT;
+#else
+            apply_preset(program, params);
+#endif
+        } else {
+            phase = PRESET_SWITCH_IDLE;
+        }
+        int8_t morph_program;
+        if (fetch_staged_params(&morph_mailbox, &morph_program, morph_params)) {
+            apply_morph(morph_params);
+        }
+
+        // Update the IMU-driven parameters, only if their value has changed
+        uint16_t value;
+        if (smoothing_process(SMOOTH_CUTOFF, &value)) {
+            g_synth.control_change(FILTER_CUTOFF, value);
+        }
+        if (smoothing_process(SMOOTH_PITCH_BEND, &value)) {
+            base_bend = value;
+            base_bend_changed = true;
+        }
+        bool bend_changed = base_bend_changed;
+        base_bend_changed = false;
+        // The tuning is converted with the bend range of the current preset, none if bending is disabled
+        uint8_t bend_range = g_synth.current_controller_value(P_BEND_RANGE); // In semitones
+        int16_t tuning_bend = (bend_range == 0 ? 0 : (int16_t)tuning_cents * 0x2000 / (bend_range * 100));
+        if (tuning_bend != last_tuning_bend) {
+            last_tuning_bend = tuning_bend;
+            bend_changed = true;
+        }
+        if (bend_changed) {
+            int32_t bend = (int32_t)base_bend + last_tuning_bend;
+            if (bend < 0) { bend = 0; }
+            if (bend > 0x3FFF) { bend = 0x3FFF; }
+            g_synth.pitch_bend(bend & 0x7F, (bend >> 7) & 0x7F);
+        }
+
         for (int i = 0; i < AUDIO_BUFFER_LENGTH; i++) {
+        play_scheduled_notes(buffer_us + ((i * SAMPLE_PERIOD_US_Q8) >> 8));
         short sample = g_synth.process(0, right_buffer);
         int temp = (int)sample * get_volume();
+        if (phase == PRESET_SWITCH_FADE_OUT) {
+            temp = temp * (AUDIO_BUFFER_LENGTH - i) / AUDIO_BUFFER_LENGTH;
+        } else if (phase == PRESET_SWITCH_FADE_IN) {
+            temp = temp * i / AUDIO_BUFFER_LENGTH;
+        }
         short output = (short)(temp >> 3);
         *buffer++ = output;
         *buffer++ = output;
         }
+#if defined (USE_PROFILER)
+        profiler_render(time_us_32() - buffer_us);
+#endif
     }
 }
 
@@ -389,7 +1178,55 @@ void intro_complete() {
 
 /* I/O functions */
 
-void encoder_up() {
+// Pads played while the arpeggiator was off would never get their note off
+// from it, and the other way around, so switching it on or off ends all notes
+static void arp_pattern_changed(arp_pattern_t previous) {
+    if ((previous == ARP_OFF) == (get_arp_pattern() == ARP_OFF)) { return; }
+    arp_clear();
+    all_notes_off();
+}
+
+// Edit the selected setting of the looper track screen. Selecting a track
+// also selects its instrument, so that the track is played live with it.
+static void change_track_value(int8_t steps) {
+    uint8_t track = looper_get_track();
+    switch (get_track_field()) {
+        case TRACK_FIELD_TRACK:
+            if (steps > 0 && track < LOOPER_TRACKS - 1) { looper_select_track(track + 1); }
+            if (steps < 0 && track > 0) { looper_select_track(track - 1); }
+            track = looper_get_track();
+            if (looper_track_has_recording(track)) {
+                set_instrument(looper_get_track_instrument(track));
+                update_instrument();
+            }
+        break;
+        case TRACK_FIELD_INSTRUMENT:
+            for (int8_t i = 0; i < steps; i++) { set_instrument_up(); }
+            for (int8_t i = 0; i > steps; i--) { set_instrument_down(); }
+            update_instrument();
+            looper_set_track_instrument(track, get_instrument());
+        break;
+        case TRACK_FIELD_VOLUME: {
+            int8_t volume = looper_get_track_volume(track) + (steps > 0 ? 1 : -1);
+            if (volume >= 0 && volume <= LOOPER_TRACK_VOLUME_MAX) { looper_set_track_volume(track, volume); }
+        }
+        break;
+        case TRACK_FIELD_PLAYBACK: {
+            // Forward speeds first, then the same speeds backwards
+            int8_t playback = looper_get_speed() + (looper_is_reversed() ? LOOPER_SPEED_LAST : 0) + (steps > 0 ? 1 : -1);
+            if (playback >= 0 && playback < 2 * LOOPER_SPEED_LAST) {
+                looper_set_playback((looper_speed_t)(playback % LOOPER_SPEED_LAST), playback >= LOOPER_SPEED_LAST);
+            }
+        }
+        break;
+        default:
+        break;
+    }
+}
+
+// Only the settings with long ranges move by more than one step at a time,
+// the menus and short lists always move by one
+void encoder_up(uint8_t steps) {
     context_t context = get_context();
     switch (context) {
         case CTX_SELECTION:
@@ -401,6 +1238,10 @@ void encoder_up() {
                 case SELECTION_KEY:
                 case SELECTION_LOOPER:
                 case SELECTION_IMU_CONFIG:
+                case SELECTION_CHORD:
+                case SELECTION_ARP:
+                case SELECTION_SEQUENCER:
+                case SELECTION_TRACKS:
                     display_refresh(&display);
                 break;
             }
@@ -408,7 +1249,7 @@ void encoder_up() {
         break;
         case CTX_KEY:
             // D#7 is the highest note that can be set as root note
-            set_key_up();
+            for (uint8_t i = 0; i < steps; i++) { set_key_up(); }
             all_notes_off();
         break;
         case CTX_SCALE:
@@ -416,7 +1257,7 @@ void encoder_up() {
             all_notes_off();
         break;
         case CTX_INSTRUMENT:
-            set_instrument_up();
+            for (uint8_t i = 0; i < steps; i++) { set_instrument_up(); }
             update_instrument();
         break;
         case CTX_IMU_CONFIG:
@@ -436,11 +1277,11 @@ void encoder_up() {
             update_argument_from_parameter(get_parameter());
         break;
         case CTX_SYNTH_EDIT_ARG:
-            set_argument_up();
+            for (uint8_t i = 0; i < steps; i++) { set_argument_up(); }
             sync_control_change();
         break;
         case CTX_SYNTH_EDIT_STORE:
-            set_preset_slot_up();
+            for (uint8_t i = 0; i < steps; i++) { set_preset_slot_up(); }
         break;
         case CTX_LOOPER:
             looper_transpose_up();
@@ -455,8 +1296,44 @@ void encoder_up() {
         case CTX_SCALE_EDIT_STORE:
             set_scale_slot_up();
         break;
-        case CTX_INIT:
+        case CTX_MORPH_SLOT:
+            for (uint8_t i = 0; i < steps; i++) { set_morph_slot_up(); }
+        break;
+        case CTX_TUNING:
+            set_tuning_up();
+        break;
+        case CTX_CHORD:
+            set_chord_mode_up();
+        break;
+        case CTX_ARP_FIELD:
+            set_arp_field_up();
+        break;
+        case CTX_ARP_VALUE: {
+            arp_pattern_t pattern = get_arp_pattern();
+            set_arp_value_up();
+            arp_pattern_changed(pattern);
+        }
+        break;
+        case CTX_SEQUENCER:
+            if (!seq_is_playing()) { seq_cursor_up(); }
+        break;
+        case CTX_TRACK_FIELD:
+            set_track_field_up();
+        break;
+        case CTX_TRACK_VALUE:
+            change_track_value(steps);
+        break;
         case CTX_INFO:
+#if defined (USE_PROFILER)
+            set_context(CTX_DIAGNOSTICS); // Hidden screen
+#endif
+        break;
+        case CTX_DIAGNOSTICS:
+#if defined (USE_MIDI)
+            set_context(CTX_MIDI_DIAGNOSTICS);
+#endif
+        break;
+        case CTX_INIT:
         default:
             ; // Do nothing
         break;
@@ -465,11 +1342,11 @@ void encoder_up() {
     if(get_contrast() == CONTRAST_AUTO) {
         display_wake(&display);
     }
-    display_draw(&display);
+    display_request_draw();
 #endif
 }
 
-void encoder_down() {
+void encoder_down(uint8_t steps) {
     context_t context = get_context();
     switch (get_context()) {
         case CTX_SELECTION:
@@ -481,13 +1358,17 @@ void encoder_down() {
                 case SELECTION_VOLUME:
                 case SELECTION_LOOPER:
                 case SELECTION_IMU_CONFIG:
+                case SELECTION_CHORD:
+                case SELECTION_ARP:
+                case SELECTION_SEQUENCER:
+                case SELECTION_TRACKS:
                     display_refresh(&display);
                 break;
             }
 #endif
         break;
         case CTX_KEY:
-            set_key_down();
+            for (uint8_t i = 0; i < steps; i++) { set_key_down(); }
             all_notes_off();
         break;
         case CTX_SCALE:
@@ -495,7 +1376,7 @@ void encoder_down() {
             all_notes_off();
         break;
         case CTX_INSTRUMENT:
-            set_instrument_down();
+            for (uint8_t i = 0; i < steps; i++) { set_instrument_down(); }
             update_instrument();
         break;
         case CTX_IMU_CONFIG:
@@ -515,11 +1396,11 @@ void encoder_down() {
             update_argument_from_parameter(get_parameter());
         break;
         case CTX_SYNTH_EDIT_ARG:
-            set_argument_down();
+            for (uint8_t i = 0; i < steps; i++) { set_argument_down(); }
             sync_control_change();
         break;
         case CTX_SYNTH_EDIT_STORE:
-            set_preset_slot_down();
+            for (uint8_t i = 0; i < steps; i++) { set_preset_slot_down(); }
         break;
         case CTX_LOOPER:
             looper_transpose_down();
@@ -534,6 +1415,36 @@ void encoder_down() {
         case CTX_SCALE_EDIT_STORE:
             set_scale_slot_down();
         break;
+        case CTX_MORPH_SLOT:
+            for (uint8_t i = 0; i < steps; i++) { set_morph_slot_down(); }
+        break;
+        case CTX_TUNING:
+            set_tuning_down();
+        break;
+        case CTX_CHORD:
+            set_chord_mode_down();
+        break;
+        case CTX_ARP_FIELD:
+            set_arp_field_down();
+        break;
+        case CTX_ARP_VALUE: {
+            arp_pattern_t pattern = get_arp_pattern();
+            set_arp_value_down();
+            arp_pattern_changed(pattern);
+        }
+        break;
+        case CTX_SEQUENCER:
+            if (!seq_is_playing()) { seq_cursor_down(); }
+        break;
+        case CTX_TRACK_FIELD:
+            set_track_field_down();
+        break;
+        case CTX_TRACK_VALUE:
+            change_track_value(-steps);
+        break;
+        case CTX_MIDI_DIAGNOSTICS:
+            set_context(CTX_DIAGNOSTICS);
+        break;
         case CTX_INIT:
         case CTX_INFO:
         default:
@@ -544,27 +1455,46 @@ void encoder_down() {
     if(get_contrast() == CONTRAST_AUTO) {
         display_wake(&display);
     }
-    display_draw(&display);
+    display_request_draw();
 #endif
 }
 
+// Input callbacks run in interrupt context: they only queue an event,
+// which is handled by input_task() in the main loop
 void encoder_onchange(rotary_encoder_t *encoder) {
     static long int last_position;
     long int position = encoder->position / 4; // Adjust the encoder sensitivity here
-    int8_t direction = 0;
-    if(last_position != position) {
-        direction = (last_position < position ? 1 : -1);
-    }
+    if(last_position == position) { return; }
+    int8_t direction = (last_position < position ? 1 : -1);
     last_position = position;
+    input_queue_push(INPUT_ENCODER, encoder_accel_update(&encoder_accel, direction, time_us_32()));
+}
 
-    if (direction == 1) {
-        encoder_up();
-    } else if (direction == -1) {
-        encoder_down();
+static void encoder_turn(int8_t steps) {
+    if (steps > 0) {
+        encoder_up(steps);
+    } else if (steps < 0) {
+        encoder_down(-steps);
     }
 }
 
-int64_t on_long_press(alarm_id_t id, void *) {
+static void encoder_process(int8_t steps) {
+#if defined (INPUT_TRACE)
+    input_trace_record(TRACE_ENCODER, (uint8_t)steps);
+#endif
+    encoder_turn(steps);
+}
+
+int64_t on_long_press(alarm_id_t id, void *press) {
+    input_queue_push(INPUT_LONG_PRESS, (int8_t)(uintptr_t)press);
+    return 0;
+}
+
+static void long_press_process(int8_t press) {
+    // The alarm may have fired just before the button was released,
+    // or for an earlier press
+    if (!button_held || press != button_press) { return; }
+
     context_t context = get_context();
     selection_t selection = get_selection();
     switch(context) {
@@ -586,15 +1516,35 @@ int64_t on_long_press(alarm_id_t id, void *) {
                 }
         break;
         case CTX_KEY:
-            set_context(CTX_INFO);
+            set_context(CTX_TUNING);
+        break;
+        case CTX_TUNING:
+        case CTX_CHORD:
+            set_context(CTX_SELECTION);
+        break;
+        case CTX_ARP_FIELD:
+        case CTX_ARP_VALUE:
+            set_context(CTX_SELECTION);
+            request_flash_write();
+        break;
+        case CTX_SEQUENCER:
+            seq_stop();
+            set_context(CTX_SELECTION);
+        break;
+        case CTX_TRACK_FIELD:
+        case CTX_TRACK_VALUE:
+            set_context(CTX_SELECTION);
+            request_flash_write(); // The instrument may have changed
         break;
         case CTX_VOLUME:
             set_context(CTX_CONTRAST);
         break;
         case CTX_CONTRAST:
-        case CTX_IMU_CONFIG:
             set_context(CTX_SELECTION);
         break;
+        case CTX_IMU_CONFIG:
+            set_context(CTX_MORPH_SLOT);
+        break;
         case CTX_INSTRUMENT:
             set_context(CTX_SYNTH_EDIT_PARAM);
             update_argument_from_parameter(get_parameter());
@@ -611,6 +1561,8 @@ int64_t on_long_press(alarm_id_t id, void *) {
             set_context(CTX_SYNTH_EDIT_STORE);
         break;
         case CTX_INFO:
+        case CTX_DIAGNOSTICS:
+        case CTX_MIDI_DIAGNOSTICS:
             set_context(CTX_SELECTION);
         break;
         case CTX_LOOPER:
@@ -627,25 +1579,25 @@ int64_t on_long_press(alarm_id_t id, void *) {
     }
 
 #if defined (USE_DISPLAY)
-    display_draw(&display);
+    display_request_draw();
 #endif
-    return 0;
 }
 
-void button_onchange(button_t *button_p) {
-    button_t *button = (button_t*)button_p;
+static void button_process(bool released) {
     if (long_press_alarm_id) cancel_alarm(long_press_alarm_id);
-    if (button->state) { // Button released
+    button_held = !released;
+    if (released) { // Button released
         if (looper_button_pending) {
             looper_button_pending = false;
             set_context(CTX_SELECTION);
 #if defined(USE_DISPLAY)
-            display_draw(&display);
+            display_request_draw();
 #endif
         }
         return;
     }
-    long_press_alarm_id = add_alarm_in_ms(LONG_PRESS_THRESHOLD, on_long_press, NULL, true);
+    button_press++;
+    long_press_alarm_id = add_alarm_in_ms(LONG_PRESS_THRESHOLD, on_long_press, (void*)(uintptr_t)button_press, true);
 
     context_t context = get_context();
     selection_t selection = get_selection();
@@ -672,16 +1624,32 @@ void button_onchange(button_t *button_p) {
                 case SELECTION_IMU_CONFIG:
                     set_context(CTX_IMU_CONFIG);
                 break;
+                case SELECTION_CHORD:
+                    set_context(CTX_CHORD);
+                break;
+                case SELECTION_ARP:
+                    set_context(CTX_ARP_FIELD);
+                break;
+                case SELECTION_SEQUENCER:
+                    set_context(CTX_SEQUENCER);
+                break;
+                case SELECTION_TRACKS:
+                    set_context(CTX_TRACK_FIELD);
+                break;
             }
         }
         break;
         case CTX_INFO:
+        case CTX_DIAGNOSTICS:
+        case CTX_MIDI_DIAGNOSTICS:
         case CTX_KEY:
         case CTX_SCALE:
         case CTX_INSTRUMENT:
         case CTX_VOLUME:
         case CTX_CONTRAST:
         case CTX_IMU_CONFIG:
+        case CTX_TUNING:
+        case CTX_CHORD:
             set_context(CTX_SELECTION);
             request_flash_write();
         break;
@@ -691,6 +1659,25 @@ void button_onchange(button_t *button_p) {
         case CTX_SYNTH_EDIT_ARG:
             set_context(CTX_SYNTH_EDIT_PARAM);
         break;
+        case CTX_ARP_FIELD:
+            set_context(CTX_ARP_VALUE);
+        break;
+        case CTX_ARP_VALUE:
+            set_context(CTX_ARP_FIELD);
+        break;
+        case CTX_TRACK_FIELD:
+            set_context(CTX_TRACK_VALUE);
+        break;
+        case CTX_TRACK_VALUE:
+            set_context(CTX_TRACK_FIELD);
+        break;
+        case CTX_SEQUENCER:
+            if (seq_is_playing()) {
+                seq_stop();
+            } else {
+                seq_start();
+            }
+        break;
         case CTX_SYNTH_EDIT_STORE:
             submit_preset_slot();
             set_context(CTX_SELECTION);
@@ -714,6 +1701,12 @@ void button_onchange(button_t *button_p) {
             set_context(CTX_SELECTION);
             set_selection(SELECTION_SCALE);
         break;
+        case CTX_MORPH_SLOT:
+            // Restore the unmorphed instrument and set up the new morph target
+            update_instrument();
+            set_context(CTX_SELECTION);
+            request_flash_write();
+        break;
         case CTX_INIT:
         default:
             ; // Do nothing
@@ -723,10 +1716,90 @@ void button_onchange(button_t *button_p) {
     if(get_contrast() == CONTRAST_AUTO) {
         display_wake(&display);
     }
-    display_draw(&display);
+    display_request_draw();
 #endif
 }
 
+void button_onchange(button_t *button_p) {
+    button_t *button = (button_t*)button_p;
+    input_queue_push(INPUT_BUTTON, button->state);
+}
+
+// Handle the queued input events, in the order they happened.
+// Consecutive encoder steps in the same direction are applied at once,
+// with a single state update and redraw.
+static void input_task() {
+    input_event_t event;
+    int16_t steps = 0;
+    while (input_queue_pop(&event)) {
+#if defined (INPUT_TRACE)
+        // Live input is ignored during replays, except for the long presses
+        // that the replayed button presses started
+        if (input_trace_is_replaying() && event.type != INPUT_LONG_PRESS) { continue; }
+#endif
+        if (event.type == INPUT_ENCODER && (steps == 0 || (steps > 0) == (event.value > 0))) {
+            steps += event.value;
+            if (steps > INT8_MAX) { steps = INT8_MAX; }
+            if (steps < -INT8_MAX) { steps = -INT8_MAX; }
+            continue;
+        }
+        if (steps != 0) { // Apply the steps before what follows them
+            encoder_process(steps);
+            steps = 0;
+        }
+        switch (event.type) {
+            case INPUT_ENCODER: // Turned back
+                steps = event.value;
+            break;
+            case INPUT_BUTTON:
+#if defined (INPUT_TRACE)
+                input_trace_record(TRACE_BUTTON, event.value);
+#endif
+                button_process(event.value);
+            break;
+            case INPUT_LONG_PRESS:
+                long_press_process(event.value);
+            break;
+        }
+    }
+    if (steps != 0) { encoder_process(steps); }
+}
+
+#if defined (INPUT_TRACE)
+// Replay a recorded input through the same path as the live one
+void input_trace_apply(trace_source_t source, uint32_t data) {
+    switch (source) {
+        case TRACE_TOUCH:
+            if (data & 0x10) {
+                touch_on(data & 0x0F);
+            } else {
+                touch_off(data & 0x0F);
+            }
+        break;
+        case TRACE_IMU:
+            imu_data.deviation_x = data & 0x3FFF;
+            imu_data.deviation_y = (data >> 14) & 0x7F;
+            imu_data.acceleration = (data >> 21) & 0xFF;
+        break;
+        case TRACE_ENCODER:
+            encoder_turn((int8_t)data);
+        break;
+        case TRACE_BUTTON:
+            button_process(data);
+        break;
+    }
+}
+
+static inline void record_imu_data() {
+    static uint32_t last_data;
+    uint32_t data = imu_data.deviation_x | (uint32_t)imu_data.deviation_y << 14 |
+                    (uint32_t)imu_data.acceleration << 21;
+    if (data == last_data) { return; }
+    last_data = data;
+    input_trace_record(TRACE_IMU, data);
+}
+#endif
+
 void battery_low_detected() {
     set_low_batt(true);
     battery_check_stop(); // Stop the timer
@@ -758,8 +1831,82 @@ void bi_decl_all() {
     bi_decl(bi_3pins_with_names(I2S_DATA_PIN, I2S_DATA_DESCRIPTION,
     I2S_CLOCK_PIN_BASE, I2S_BCK_DESCRIPTION,
     I2S_CLOCK_PIN_BASE+1, I2S_LRCK_DESCRIPTION));
+#if defined (USE_MIDI_DIN)
+    bi_decl(bi_1pin_with_name(MIDI_DIN_TX_PIN, MIDI_DIN_TX_DESCRIPTION));
+#endif
 }
 
+/* Core0 tasks, run by the scheduler */
+
+static void run_encoder() {
+    encoder_poll_all_events();
+    input_task();
+    PROFILER_MARK(PROF_ENCODER);
+}
+
+static void run_touch() {
+#if defined (INPUT_TRACE)
+    input_trace_task();
+    if (!input_trace_is_replaying()) { mpr121_task(); } // Replaced by the recording while replaying
+#else
+    mpr121_task();
+#endif
+    PROFILER_MARK(PROF_TOUCH);
+}
+
+#if defined (USE_IMU)
+static void run_imu() {
+#if defined (INPUT_TRACE)
+    if(get_imu_axes() > 0 && !input_trace_is_replaying()) {
+        imu_task(&imu_data);
+        record_imu_data();
+    }
+#else
+    if(get_imu_axes() > 0) {
+        imu_task(&imu_data);
+    }
+#endif
+    tilt_process(); // Also releases the parameters of disabled axes
+    PROFILER_MARK(PROF_IMU);
+}
+#endif
+
+static void run_looper() {
+    uint32_t now = time_us_32();
+    arp_task(now);
+    seq_task(now);
+    looper_task();
+    PROFILER_MARK(PROF_LOOPER);
+}
+
+static void run_midi() {
+#if defined (USE_MIDI_DIN)
+    midi_uart_task(); // Send the serial Midi written during the last transfer
+#endif
+#if defined (USE_MIDI)
+    sysex_task(); // Continue any pending dump
+    midi_queue_flush(); // Hand queued Midi messages to tinyusb
+    PROFILER_MARK(PROF_MIDI);
+    tud_task(); // tinyusb device task
+    PROFILER_MARK(PROF_USB);
+    midi_in_task();
+#endif
+    PROFILER_MARK(PROF_MIDI);
+}
+
+static void run_flash() {
+    if (!flash_write_pending || (int32_t)(time_us_32() - flash_write_due_us) < 0) { return; }
+    flash_write_pending = false;
+    write_flash_data();
+}
+
+#if defined (USE_DISPLAY)
+static void run_display() {
+    display_task(&display);
+    PROFILER_MARK(PROF_DISPLAY);
+}
+#endif
+
 // Secondary core task
 void core1_main() {
     while(true) {
@@ -790,6 +1937,14 @@ int main() {
     }
 #endif
 
+#if defined (USE_MIDI_DIN)
+    // Serial Midi output
+    midi_uart_init(MIDI_DIN_PIO_NUM, MIDI_DIN_TX_PIN);
+#if defined (MIDI_MPE)
+    send_mpe_configuration(); // Serial receivers can't see the USB connection
+#endif
+#endif
+
     // Initialize display and IMU (sharing an I²C bus)
 #if defined (USE_DISPLAY) || defined (USE_IMU)
     gpio_init(SSD1306_SDA_PIN);
@@ -823,15 +1978,18 @@ int main() {
     set_low_batt(false);
     set_preset_slot(-1); // No slot selected
     set_scale_slot(-1);  // No slot selected
+    set_morph_slot(-1);  // Morphing disabled
     set_preset_has_changes(false);
     set_scale_has_changes(false);
 
-    // Allocate memory for the user presets and scales arrays
-    user_presets = (uint8_t **)malloc(NUM_PRESET_SLOTS * sizeof(uint8_t *));
-    for (uint8_t i = 0; i < NUM_PRESET_SLOTS; i++) {
-        user_presets[i] = (uint8_t *)malloc(PROGRAM_PARAMS_NUM * sizeof(uint8_t));
-    }
+#if defined (MIDI_MPE)
+    mpe_init();
+#endif
+
+    // Build the index of the user preset bank
+    preset_bank_init();
 
+    // Allocate memory for the user scales array
     user_scales = (uint8_t **)malloc(NUM_SCALE_SLOTS * sizeof(uint8_t *));
     for (uint8_t i = 0; i < NUM_SCALE_SLOTS; i++) {
         user_scales[i] = (uint8_t *)malloc(12 * sizeof(uint8_t));
@@ -843,6 +2001,9 @@ int main() {
         // Settings not loaded, initialize state with default values
         set_key(60); // C4
         set_and_extend_scale(0); // Major
+        set_tuning(0); // Equal temperament
+        set_chord_mode(CHORD_OFF);
+        set_arp_defaults();
         set_scale_unsaved(false);
         set_instrument(0); // Dodepan custom preset
         update_instrument();
@@ -852,12 +2013,6 @@ int main() {
 #if defined (USE_DISPLAY)
         display_update_contrast(&display);
 #endif
-        // Copy the custom preset to the four user preset slots
-        for (uint8_t i = 0; i < NUM_PRESET_SLOTS; i++) {
-            for (uint8_t j = 0; j < PROGRAM_PARAMS_NUM; j++) {
-                user_presets[i][j] = dodepan_preset[j];
-            }
-        }
         // Set all user scales to chromatic
         for (uint8_t i = 0; i < NUM_SCALE_SLOTS; i++) {
             for (uint8_t j = 0; j < 12; j++) {
@@ -872,8 +2027,13 @@ int main() {
     // Initialize the touch module
     mpr121_i2c_init();
 
-    // Initialize the looper with a maximum of 512 note events
-    looper_init(512);
+    // Initialize the looper
+    looper_init(LOOPER_EVENTS_MAX);
+    seq_init();
+
+#if defined (INPUT_TRACE)
+    input_trace_init(INPUT_TRACE_EVENTS, INPUT_TRACE_OUTPUTS);
+#endif
 
     // Initialize the rotary encoder and switch
     button_system_init();
@@ -883,6 +2043,7 @@ int main() {
     gpio_pull_up(ENCODER_CLK_PIN);
     gpio_pull_up(ENCODER_SWITCH_PIN);
 #endif
+    encoder_accel_init(&encoder_accel, ENCODER_ACCEL_SLOW_US, ENCODER_ACCEL_FAST_US, ENCODER_ACCEL_MAX_STEPS);
     rotary_encoder_t *encoder = create_encoder(ENCODER_DT_PIN, ENCODER_CLK_PIN, encoder_onchange);
     button_t *button = create_button(ENCODER_SWITCH_PIN, button_onchange);
 
@@ -890,6 +2051,14 @@ int main() {
     imu_data.deviation_x = 0x2000;  // Center value
     imu_data.deviation_y = 64;      // Center value
     imu_data.acceleration = 127;    // Max value
+    smoothing_init(SMOOTH_CUTOFF, imu_data.deviation_y, TILT_SMOOTHING_SHIFT);
+    smoothing_init(SMOOTH_PITCH_BEND, imu_data.deviation_x, TILT_SMOOTHING_SHIFT);
+#if defined (USE_MIDI)
+    midi_limiter_init(&midi_bend_limiter, imu_data.deviation_x, MIDI_BEND_THRESHOLD,
+                      MIDI_MIN_INTERVAL_US, MIDI_SETTLE_US);
+    midi_limiter_init(&midi_cutoff_limiter, imu_data.deviation_y, MIDI_CC_THRESHOLD,
+                      MIDI_MIN_INTERVAL_US, MIDI_SETTLE_US);
+#endif
 
     // Use the onboard LED as a power-on indicator
     gpio_init(PICO_DEFAULT_LED_PIN);
@@ -906,26 +2075,42 @@ int main() {
     // Show a short intro animation. This will distract the user
     // while the hardware is calibrating
     intro_animation(&display, intro_complete);
-    display_draw(&display);
+    display_request_draw();
 #else
     // Since there's no intro animation without a display,
     // let's trigger the new state manually
     set_context(CTX_SELECTION);
 #endif
 
-    while (true) { // Main loop
-        encoder_poll_all_events();
-        mpr121_task();
+#if defined (USE_PROFILER)
+    profiler_init();
+#endif
 
+    // Schedule the core0 tasks, by priority
+    scheduler_add(run_midi, MIDI_PERIOD_US, 0);
+    scheduler_add(run_touch, TOUCH_PERIOD_US, 1);
+    scheduler_add(run_looper, LOOPER_PERIOD_US, 2);
+    scheduler_add(run_encoder, ENCODER_PERIOD_US, 3);
 #if defined (USE_IMU)
-        if(get_imu_axes() > 0) {
-            imu_task(&imu_data);
-            tilt_process();
-        }
+    scheduler_add(run_imu, IMU_PERIOD_US, 4);
 #endif
-        looper_task();
-#if defined (USE_MIDI)
-        tud_task(); // tinyusb device task
+#if defined (USE_DISPLAY)
+    scheduler_add(run_display, DISPLAY_PERIOD_US, 5);
+#endif
+    scheduler_add(run_flash, FLASH_PERIOD_US, 6);
+
+    while (true) { // Main loop
+#if defined (USE_PROFILER)
+        profiler_loop_begin();
+#endif
+        scheduler_run();
+#if defined (USE_PROFILER)
+        if (profiler_loop_end() && (get_context() == CTX_DIAGNOSTICS || get_context() == CTX_MIDI_DIAGNOSTICS)) {
+#if defined (USE_DISPLAY)
+            display_request_draw();
+#endif
+        }
 #endif
+        scheduler_idle(); // Sleep until the next task is due
     }
 }
@@ -0,0 +1,97 @@
+/* Incoming Midi clock follower */
+
+#include "pico/stdlib.h"
+#include "config.h"
+#include "midi_clock.h"
+
+#define PLL_PERIOD_SHIFT    4 // Each tick corrects the period by 1/16 of the phase error
+#define PLL_PHASE_SHIFT     2 // and the phase by 1/4 of the phase error
+#define DEFAULT_PERIOD_US   20833 // 120 BPM
+
+// Declare the static clock instance
+static midi_clock_t midi_clock;
+static bool awaiting_first_tick; // After a start, the first tick is position zero
+
+static inline void pll_update(uint32_t now) {
+    uint32_t period_us = midi_clock.period_q8 >> 8;
+    uint32_t predicted = midi_clock.tick_us + period_us;
+    int32_t error = (int32_t)(now - predicted);
+
+    if (error > (int32_t)(period_us / 2) || error < -(int32_t)(period_us / 2)) {
+        // Too far off to be jitter: the tempo has jumped, or the clock has resumed
+        // after a pause. Lock again, starting from the measured interval.
+        uint32_t interval = now - midi_clock.raw_tick_us;
+        if (interval >= MIDI_CLOCK_PERIOD_MIN_US && interval <= MIDI_CLOCK_PERIOD_MAX_US) {
+            midi_clock.period_q8 = interval << 8;
+        }
+        midi_clock.tick_us = now;
+        return;
+    }
+
+    int32_t period_q8 = (int32_t)midi_clock.period_q8 + ((error * 256) >> PLL_PERIOD_SHIFT);
+    if (period_q8 < (MIDI_CLOCK_PERIOD_MIN_US << 8)) { period_q8 = MIDI_CLOCK_PERIOD_MIN_US << 8; }
+    if (period_q8 > (MIDI_CLOCK_PERIOD_MAX_US << 8)) { period_q8 = MIDI_CLOCK_PERIOD_MAX_US << 8; }
+    midi_clock.period_q8 = period_q8;
+    midi_clock.tick_us = predicted + (error >> PLL_PHASE_SHIFT);
+}
+
+void midi_clock_tick(uint32_t now) {
+    if (midi_clock.seeded) {
+        pll_update(now);
+    } else {
+        midi_clock.seeded = true;
+        midi_clock.period_q8 = DEFAULT_PERIOD_US << 8;
+        midi_clock.tick_us = now;
+    }
+    midi_clock.raw_tick_us = now;
+
+    if (!midi_clock.running) { return; }
+    if (awaiting_first_tick) {
+        awaiting_first_tick = false;
+    } else {
+        midi_clock.ticks++;
+    }
+}
+
+void midi_clock_start() {
+    midi_clock.running = true;
+    midi_clock.ticks = 0;
+    awaiting_first_tick = true;
+}
+
+void midi_clock_continue() {
+    midi_clock.running = true;
+}
+
+void midi_clock_stop() {
+    midi_clock.running = false;
+}
+
+bool midi_clock_is_running() {
+    return midi_clock.running;
+}
+
+uint32_t midi_clock_get_period_us() {
+    return midi_clock.period_q8 >> 8;
+}
+
+// Beat duration, following the incoming clock while it runs, TEMPO_BPM otherwise
+uint32_t midi_clock_get_beat_us() {
+    if (!midi_clock.running) { return 60000000 / TEMPO_BPM; }
+    return (midi_clock.period_q8 >> 8) * MIDI_CLOCK_PPQN;
+}
+
+// Return the song position in fractions of a tick (MIDI_CLOCK_TICK_UNITS per tick),
+// interpolated between ticks according to the estimated tempo.
+// The time does not advance while the clock is stopped.
+uint32_t midi_clock_get_time(uint32_t now) {
+    uint32_t time = midi_clock.ticks * MIDI_CLOCK_TICK_UNITS;
+    if (!midi_clock.running || awaiting_first_tick) { return time; }
+
+    uint32_t period_us = midi_clock.period_q8 >> 8;
+    int32_t since_tick = (int32_t)(now - midi_clock.tick_us);
+    if (since_tick <= 0) { return time; }
+    // Never run past the next tick, in case it is late
+    if ((uint32_t)since_tick >= period_us) { return time + MIDI_CLOCK_TICK_UNITS - 1; }
+    return time + (uint32_t)since_tick * MIDI_CLOCK_TICK_UNITS / period_us;
+}
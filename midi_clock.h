@@ -0,0 +1,39 @@
+#ifndef MIDI_CLOCK_H
+#define MIDI_CLOCK_H
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MIDI_CLOCK_PPQN             24      // Midi clock ticks per quarter note
+#define MIDI_CLOCK_TICK_UNITS       1000    // Clock time resolution, in fractions of a tick
+#define MIDI_CLOCK_BEAT_UNITS       (MIDI_CLOCK_PPQN * MIDI_CLOCK_TICK_UNITS)
+#define MIDI_CLOCK_PERIOD_MIN_US    6250    // 400 BPM
+#define MIDI_CLOCK_PERIOD_MAX_US    83333   // 30 BPM
+
+// Tempo follower for incoming Midi clock. A simple phase-locked loop estimates
+// the tick period and the time of the latest tick, filtering out USB jitter.
+typedef struct midi_clock {
+    bool running;               // Between Midi start/continue and stop
+    bool seeded;                // At least one tick has been received
+    uint32_t ticks;             // Ticks since the last start
+    uint32_t tick_us;           // Estimated time of the latest tick
+    uint32_t raw_tick_us;       // Actual arrival time of the latest tick
+    uint32_t period_q8;         // Estimated tick period in microseconds, with 8 fractional bits
+} midi_clock_t;
+
+void midi_clock_tick(uint32_t now);
+void midi_clock_start();
+void midi_clock_continue();
+void midi_clock_stop();
+bool midi_clock_is_running();
+uint32_t midi_clock_get_period_us();
+uint32_t midi_clock_get_beat_us();
+uint32_t midi_clock_get_time(uint32_t now);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
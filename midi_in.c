@@ -0,0 +1,85 @@
+/* USB Midi input */
+
+#include "pico/stdlib.h"
+#include "tusb.h"
+#include "config.h"
+#include "midi_in.h"
+#include "sysex.h"
+
+// Dispatch a USB Midi event packet. Since USB Midi already splits the stream
+// into complete messages, they are parsed in place without any buffering.
+void midi_in_parse_packet(const uint8_t packet[4]) {
+    uint8_t code_index = packet[0] & 0x0F;
+    uint8_t status = packet[1];
+    uint8_t channel = status & 0x0F;
+
+    if (code_index == 0xF) { // Single byte, used for real-time messages
+        switch (status) {
+            case 0xF8:
+                midi_in_clock();
+            break;
+            case 0xFA:
+                midi_in_start();
+            break;
+            case 0xFB:
+                midi_in_continue();
+            break;
+            case 0xFC:
+                midi_in_stop();
+            break;
+        }
+        return;
+    }
+
+    switch (code_index) {
+        case 0x4: // SysEx starts or continues
+        case 0x5: // SysEx ends with the following single byte
+        case 0x6: // SysEx ends with the following two bytes
+        case 0x7: // SysEx ends with the following three bytes
+            sysex_receive(&packet[1], (code_index == 0x4 ? 3 : code_index - 0x4));
+            return;
+        case 0x8: // Note off
+        case 0x9: // Note on
+        case 0xB: // Control change
+        case 0xC: // Program change
+        case 0xE: // Pitch bend
+            if (channel != MIDI_IN_CHANNEL) { return; }
+            // The code index must match the status byte
+            if ((status >> 4) != code_index) { return; }
+        break;
+        default:
+            return; // Other messages are not supported
+    }
+
+    switch (status & 0xF0) {
+        case 0x80:
+            midi_in_note_off(packet[2]);
+        break;
+        case 0x90:
+            if (packet[3] == 0) { // Note on with zero velocity is a note off
+                midi_in_note_off(packet[2]);
+            } else {
+                midi_in_note_on(packet[2], packet[3]);
+            }
+        break;
+        case 0xB0:
+            midi_in_control_change(packet[2], packet[3]);
+        break;
+        case 0xC0:
+            midi_in_program_change(packet[2]);
+        break;
+        case 0xE0:
+            midi_in_pitch_bend(packet[2], packet[3]);
+        break;
+    }
+}
+
+// Read the packets received since the last call, up to a limit,
+// so that a burst of incoming messages cannot hold back the touch scan
+void midi_in_task() {
+    uint8_t packet[4];
+    for (uint8_t i = 0; i < MIDI_IN_PACKETS_PER_TASK; i++) {
+        if (!tud_midi_packet_read(packet)) { return; } // No more packets
+        midi_in_parse_packet(packet);
+    }
+}
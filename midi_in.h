@@ -0,0 +1,28 @@
+#ifndef MIDI_IN_H
+#define MIDI_IN_H
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MIDI_IN_PACKETS_PER_TASK    16 // Limit the work done per main loop iteration
+
+void midi_in_task();
+void midi_in_parse_packet(const uint8_t packet[4]);
+
+extern void midi_in_note_on(uint8_t note, uint8_t velocity);
+extern void midi_in_note_off(uint8_t note);
+extern void midi_in_control_change(uint8_t control_number, uint8_t value);
+extern void midi_in_program_change(uint8_t program);
+extern void midi_in_pitch_bend(uint8_t lsb, uint8_t msb);
+extern void midi_in_clock();
+extern void midi_in_start();
+extern void midi_in_continue();
+extern void midi_in_stop();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,35 @@
+/* Rate and change limiter for continuous Midi messages */
+
+#include "pico/stdlib.h"
+#include "midi_limiter.h"
+
+void midi_limiter_init(midi_limiter_t *limiter, uint16_t value, uint16_t threshold,
+                       uint32_t min_interval_us, uint32_t settle_us) {
+    limiter->sent = value;
+    limiter->value = value;
+    limiter->sent_us = 0;
+    limiter->changed_us = 0;
+    limiter->threshold = threshold;
+    limiter->min_interval_us = min_interval_us;
+    limiter->settle_us = settle_us;
+}
+
+// Feed the current value, on every iteration even if it has not changed.
+// Returns true if the value should be sent now; limiter->sent then holds the value.
+bool midi_limiter_update(midi_limiter_t *limiter, uint16_t value, uint32_t now) {
+    if (value != limiter->value) {
+        limiter->value = value;
+        limiter->changed_us = now;
+    }
+    if (value == limiter->sent) { return false; } // Nothing new to send
+    if (now - limiter->sent_us < limiter->min_interval_us) { return false; } // Too soon
+
+    uint16_t delta = (value > limiter->sent ? value - limiter->sent : limiter->sent - value);
+    bool is_significant = (delta >= limiter->threshold);
+    bool is_settled = (now - limiter->changed_us >= limiter->settle_us);
+    if (!is_significant && !is_settled) { return false; }
+
+    limiter->sent = value;
+    limiter->sent_us = now;
+    return true;
+}
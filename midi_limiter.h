@@ -0,0 +1,30 @@
+#ifndef MIDI_LIMITER_H
+#define MIDI_LIMITER_H
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Limits the rate of continuous Midi messages (pitch bend, control changes).
+// Significant changes are sent as soon as the rate allows; smaller changes
+// are sent once the value has stopped moving, so the resting value always goes out.
+typedef struct midi_limiter {
+    uint16_t sent;              // Last value sent
+    uint16_t value;             // Latest value received
+    uint32_t sent_us;           // Timestamp of the last message sent
+    uint32_t changed_us;        // Timestamp of the last change of value
+    uint16_t threshold;         // Minimum change that is sent without waiting for the value to settle
+    uint32_t min_interval_us;   // Minimum time between two messages
+    uint32_t settle_us;         // Time without changes after which the value is considered at rest
+} midi_limiter_t;
+
+void midi_limiter_init(midi_limiter_t *limiter, uint16_t value, uint16_t threshold,
+                       uint32_t min_interval_us, uint32_t settle_us);
+bool midi_limiter_update(midi_limiter_t *limiter, uint16_t value, uint32_t now);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
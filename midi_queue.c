@@ -0,0 +1,190 @@
+/* Prioritized and coalescing USB Midi output queue */
+
+#include "pico/stdlib.h"
+#include <string.h>
+#include "tusb.h"
+#include "midi_queue.h"
+
+typedef struct midi_packet {
+    uint8_t data[4]; // USB Midi event packet: cable and code index, then the Midi message
+} midi_packet_t;
+
+// Notes and other messages whose order matters, in a ring buffer
+static midi_packet_t events[MIDI_QUEUE_EVENTS_MAX];
+static uint16_t events_head;
+static uint16_t events_tail;
+
+// Continuous controllers, at most one pending message each
+static midi_packet_t controllers[MIDI_QUEUE_CONTROLLERS_MAX];
+static uint8_t controllers_count;
+
+static midi_queue_stats_t stats;
+
+static inline void make_packet(midi_packet_t *packet, uint8_t cable, uint8_t b1, uint8_t b2, uint8_t b3) {
+    packet->data[0] = (uint8_t)(cable << 4) | (b1 >> 4); // Code index number matches the status
+    packet->data[1] = b1;
+    packet->data[2] = b2;
+    packet->data[3] = b3;
+}
+
+static inline bool is_continuous_controller(uint8_t status) {
+    switch (status & 0xF0) {
+        case 0xA0: // Polyphonic pressure
+        case 0xB0: // Control change
+        case 0xD0: // Channel pressure
+        case 0xE0: // Pitch bend
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Two controller messages are the same controller if they only differ by value
+static inline bool is_same_controller(const midi_packet_t *packet, uint8_t cable, uint8_t b1, uint8_t b2) {
+    if (packet->data[0] >> 4 != cable || packet->data[1] != b1) { return false; }
+    uint8_t type = b1 & 0xF0;
+    if (type == 0xD0 || type == 0xE0) { return true; } // No controller number
+    return (packet->data[2] == b2);
+}
+
+static inline bool is_note_off(uint8_t b1, uint8_t b3) {
+    return ((b1 & 0xF0) == 0x80 || ((b1 & 0xF0) == 0x90 && b3 == 0));
+}
+
+static inline uint16_t get_events_free() {
+    return MIDI_QUEUE_EVENTS_MAX - (uint16_t)(events_head - events_tail);
+}
+
+static bool push_controller(uint8_t cable, uint8_t b1, uint8_t b2, uint8_t b3) {
+    for (uint8_t i = 0; i < controllers_count; i++) {
+        if (is_same_controller(&controllers[i], cable, b1, b2)) {
+            make_packet(&controllers[i], cable, b1, b2, b3);
+            stats.coalesced++;
+            return true;
+        }
+    }
+    if (controllers_count >= MIDI_QUEUE_CONTROLLERS_MAX) {
+        stats.dropped++;
+        return false;
+    }
+    make_packet(&controllers[controllers_count++], cable, b1, b2, b3);
+    return true;
+}
+
+// Move the oldest controller out of the ordered queue, to the controllers.
+// Returns false if there is none.
+static bool demote_controller() {
+    for (uint16_t i = events_tail; i != events_head; i++) {
+        const midi_packet_t *packet = &events[i & (MIDI_QUEUE_EVENTS_MAX - 1)];
+        // The code index matches the status, unlike in the packets of system exclusive messages
+        if ((packet->data[0] & 0x0F) != packet->data[1] >> 4 || !is_continuous_controller(packet->data[1])) {
+            continue;
+        }
+        push_controller(packet->data[0] >> 4, packet->data[1], packet->data[2], packet->data[3]);
+        for (uint16_t j = i; (uint16_t)(j + 1) != events_head; j++) {
+            events[j & (MIDI_QUEUE_EVENTS_MAX - 1)] = events[(j + 1) & (MIDI_QUEUE_EVENTS_MAX - 1)];
+        }
+        events_head--;
+        return true;
+    }
+    return false;
+}
+
+static inline bool push_event(uint8_t cable, uint8_t b1, uint8_t b2, uint8_t b3) {
+    bool note_off = is_note_off(b1, b3);
+    uint16_t events_free = get_events_free();
+    if ((!note_off && events_free <= MIDI_QUEUE_NOTE_OFFS_RESERVED) ||
+        (note_off && events_free == 0 && !demote_controller())) {
+        stats.dropped++;
+        return false;
+    }
+    make_packet(&events[events_head & (MIDI_QUEUE_EVENTS_MAX - 1)], cable, b1, b2, b3);
+    events_head++;
+    return true;
+}
+
+// Queue a three-byte Midi message. Returns false if it had to be dropped.
+bool midi_queue_push(uint8_t cable, uint8_t b1, uint8_t b2, uint8_t b3) {
+    if (is_continuous_controller(b1)) {
+        return push_controller(cable, b1, b2, b3);
+    }
+
+    return push_event(cable, b1, b2, b3);
+}
+
+// Queue a three-byte Midi message in order with the notes, even if it is a
+// controller, for messages that must reach the receiver before the next note
+// (e.g. a parameter number, or the initial expression of a note).
+// It supersedes a pending message for the same controller.
+bool midi_queue_push_ordered(uint8_t cable, uint8_t b1, uint8_t b2, uint8_t b3) {
+    if (is_continuous_controller(b1)) {
+        for (uint8_t i = 0; i < controllers_count; i++) {
+            if (is_same_controller(&controllers[i], cable, b1, b2)) {
+                memmove(&controllers[i], &controllers[i + 1], (controllers_count - i - 1) * sizeof(midi_packet_t));
+                controllers_count--;
+                break;
+            }
+        }
+    }
+    return push_event(cable, b1, b2, b3);
+}
+
+// Queue a complete system exclusive message, from F0 to F7. The whole message
+// is split into event packets and queued at once, so that no other message
+// can end up in its middle. Returns false, queuing nothing, if it does not fit.
+bool midi_queue_push_sysex(uint8_t cable, const uint8_t *data, uint16_t length) {
+    uint16_t packets = (length + 2) / 3;
+    if (get_events_free() < packets + MIDI_QUEUE_NOTE_OFFS_RESERVED) { return false; }
+
+    for (uint16_t i = 0; i < length; i += 3) {
+        midi_packet_t *packet = &events[events_head & (MIDI_QUEUE_EVENTS_MAX - 1)];
+        uint16_t remaining = length - i;
+        uint8_t code_index = 0x4; // SysEx starts or continues
+        if (remaining <= 3) { code_index = 0x4 + remaining; } // SysEx ends with the following 1, 2 or 3 bytes
+        packet->data[0] = (uint8_t)(cable << 4) | code_index;
+        for (uint8_t j = 0; j < 3; j++) {
+            packet->data[1 + j] = (j < remaining ? data[i + j] : 0);
+        }
+        events_head++;
+    }
+    return true;
+}
+
+// Write as many queued messages as the TX FIFO can take, notes first.
+// TinyUSB sends the FIFO content in as few USB transfers as possible.
+void midi_queue_flush() {
+    if (!tud_midi_mounted()) {
+        // Nobody is listening, don't let stale messages pile up
+        midi_queue_clear();
+        return;
+    }
+
+    while (events_tail != events_head) {
+        if (!tud_midi_packet_write(events[events_tail & (MIDI_QUEUE_EVENTS_MAX - 1)].data)) {
+            return; // FIFO full, try again on the next iteration
+        }
+        events_tail++;
+        stats.sent++;
+    }
+
+    uint8_t sent = 0;
+    while (sent < controllers_count) {
+        if (!tud_midi_packet_write(controllers[sent].data)) { break; }
+        sent++;
+    }
+    // Keep the controllers that did not fit at the front of the list
+    if (sent > 0) {
+        memmove(&controllers[0], &controllers[sent], (controllers_count - sent) * sizeof(midi_packet_t));
+        controllers_count -= sent;
+        stats.sent += sent;
+    }
+}
+
+void midi_queue_clear() {
+    events_tail = events_head;
+    controllers_count = 0;
+}
+
+const midi_queue_stats_t* midi_queue_get_stats() {
+    return &stats;
+}
@@ -0,0 +1,37 @@
+#ifndef MIDI_QUEUE_H
+#define MIDI_QUEUE_H
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MIDI_QUEUE_EVENTS_MAX       64 // Must be a power of two
+#define MIDI_QUEUE_CONTROLLERS_MAX  32 // Distinct controllers that can be pending at once, enough for MPE
+#define MIDI_QUEUE_NOTE_OFFS_RESERVED 16 // Slots of the ordered queue that only note offs can take
+
+// Outgoing USB Midi messages are queued here and written to the TinyUSB
+// TX FIFO by midi_queue_flush(), as many as fit, once per main loop iteration.
+// Note and other ordered messages always go out before continuous controllers.
+// A controller already pending is updated in place instead of being queued again.
+// Note offs are never dropped for other messages: the last slots of the ordered queue
+// are kept for them, and when it is full a note off moves the oldest ordered controller
+// to the controllers, where it can be coalesced, to take its place.
+typedef struct midi_queue_stats {
+    uint32_t sent;              // Messages written to the TX FIFO
+    uint32_t coalesced;         // Controller messages merged into a pending one
+    uint32_t dropped;           // Messages lost because the queue was full
+} midi_queue_stats_t;
+
+bool midi_queue_push(uint8_t cable, uint8_t b1, uint8_t b2, uint8_t b3);
+bool midi_queue_push_ordered(uint8_t cable, uint8_t b1, uint8_t b2, uint8_t b3);
+bool midi_queue_push_sysex(uint8_t cable, const uint8_t *data, uint16_t length);
+void midi_queue_flush();
+void midi_queue_clear();
+const midi_queue_stats_t* midi_queue_get_stats();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,102 @@
+/* Serial Midi output through a PIO UART */
+
+#include "pico/stdlib.h"
+#include <string.h>
+#include "hardware/pio.h"
+#include "hardware/dma.h"
+#include "midi_uart.h"
+#include "midi_uart.pio.h"
+
+static PIO uart_pio;
+static uint uart_sm;
+static uint uart_dma_chan;
+
+// Two buffers: one is being sent by DMA while the other one is filled
+static uint8_t buffers[2][MIDI_UART_BUFFER_SIZE];
+static uint8_t fill_buffer;
+static uint16_t fill_length;
+
+static uint8_t running_status; // Status byte of the last channel message sent
+static uint32_t dropped;
+
+void midi_uart_init(uint8_t pio_num, uint8_t pin) {
+    uart_pio = (pio_num == 0) ? pio0 : pio1;
+    uint offset = pio_add_program(uart_pio, &midi_uart_tx_program);
+    uart_sm = pio_claim_unused_sm(uart_pio, true);
+    midi_uart_tx_program_init(uart_pio, uart_sm, offset, pin, MIDI_UART_BAUD);
+
+    // Each byte written to the TX FIFO is one character on the line
+    uart_dma_chan = dma_claim_unused_channel(true);
+    dma_channel_config dma_cfg = dma_channel_get_default_config(uart_dma_chan);
+    channel_config_set_transfer_data_size(&dma_cfg, DMA_SIZE_8);
+    channel_config_set_read_increment(&dma_cfg, true);
+    channel_config_set_write_increment(&dma_cfg, false);
+    channel_config_set_dreq(&dma_cfg, pio_get_dreq(uart_pio, uart_sm, true));
+    dma_channel_configure(uart_dma_chan, &dma_cfg,
+                          &uart_pio->txf[uart_sm],  // destination
+                          buffers[0],               // source
+                          0,                        // number of dma transfers
+                          false                     // started by the first write
+                          );
+}
+
+// Hand the filled buffer over to DMA, if the previous transfer is over
+static void start_transfer() {
+    if (fill_length == 0 || dma_channel_is_busy(uart_dma_chan)) { return; }
+    dma_channel_transfer_from_buffer_now(uart_dma_chan, buffers[fill_buffer], fill_length);
+    fill_buffer ^= 1;
+    fill_length = 0;
+}
+
+static inline uint8_t get_message_length(uint8_t status) {
+    switch (status & 0xF0) {
+        case 0xC0: // Program change
+        case 0xD0: // Channel pressure
+            return 2;
+        case 0xF0: // Only real-time system messages are supported
+            return (status >= 0xF8 ? 1 : 0);
+        default:
+            return 3;
+    }
+}
+
+// Queue a Midi message for sending. Returns false if it had to be dropped.
+bool midi_uart_write(uint8_t b1, uint8_t b2, uint8_t b3) {
+    uint8_t length = get_message_length(b1);
+    if (length == 0) { return false; }
+
+    uint8_t bytes[3];
+    uint8_t n = 0;
+    uint8_t status = running_status;
+    if (length == 1) {
+        bytes[n++] = b1; // Real-time messages leave the running status untouched
+    } else {
+        // Send note offs as note ons with zero velocity, so they can share the running status
+        if ((b1 & 0xF0) == 0x80 && b3 == 0) { b1 = 0x90 | (b1 & 0x0F); }
+        if (b1 != running_status) {
+            bytes[n++] = b1;
+            status = b1;
+        }
+        bytes[n++] = b2;
+        if (length == 3) { bytes[n++] = b3; }
+    }
+
+    if (fill_length + n > MIDI_UART_BUFFER_SIZE) {
+        dropped++;
+        return false;
+    }
+    memcpy(&buffers[fill_buffer][fill_length], bytes, n);
+    fill_length += n;
+    running_status = status;
+    start_transfer();
+    return true;
+}
+
+// Send what was written while the previous transfer was in progress
+void midi_uart_task() {
+    start_transfer();
+}
+
+uint32_t midi_uart_get_dropped() {
+    return dropped;
+}
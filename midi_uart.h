@@ -0,0 +1,24 @@
+#ifndef MIDI_UART_H
+#define MIDI_UART_H
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MIDI_UART_BAUD          31250
+#define MIDI_UART_BUFFER_SIZE   256 // Bytes that can be waiting while the previous ones are sent
+
+// Serial Midi output, for DIN or TRS jacks. Messages are written with running
+// status into a RAM buffer, which is sent to a PIO UART by DMA while the next
+// one is filled, so writing a message never waits for the line.
+void midi_uart_init(uint8_t pio_num, uint8_t pin);
+bool midi_uart_write(uint8_t b1, uint8_t b2, uint8_t b3);
+void midi_uart_task();
+uint32_t midi_uart_get_dropped();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
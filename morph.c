@@ -0,0 +1,67 @@
+/* Morphing between two presets */
+
+#include "pico/stdlib.h"
+#include <string.h>
+#include "morph.h"
+
+// Declare the static morph instance
+static morph_t morph;
+
+void morph_start(const uint8_t *source, const uint8_t *target, uint8_t params_num, uint64_t stepped_mask) {
+    if (params_num > MORPH_PARAMS_MAX) { params_num = MORPH_PARAMS_MAX; }
+    // Keep a copy of both presets, as they might be moved or rewritten while morphing
+    memcpy(morph.source, source, params_num);
+    memcpy(morph.target, target, params_num);
+    memcpy(morph.values, source, params_num);
+    morph.params_num = params_num;
+    morph.stepped_mask = stepped_mask;
+    morph.position = 0;
+
+    // Parameters with the same value in both presets never need updating
+    morph.differ_mask = 0;
+    for (uint8_t i = 0; i < params_num; i++) {
+        if (source[i] != target[i]) {
+            morph.differ_mask |= (1ULL << i);
+        }
+    }
+    morph.active = true;
+}
+
+void morph_stop() {
+    morph.active = false;
+}
+
+bool morph_is_active() {
+    return morph.active;
+}
+
+// Compute the parameter values for the given position.
+// Returns a mask of the parameters whose value has changed since the last update.
+uint64_t morph_update(uint8_t position) {
+    if (!morph.active || position == morph.position) { return 0; }
+    morph.position = position;
+
+    uint64_t dirty_mask = 0;
+    for (uint8_t i = 0; i < morph.params_num; i++) {
+        if (!(morph.differ_mask & (1ULL << i))) { continue; }
+
+        uint8_t value;
+        if (morph.stepped_mask & (1ULL << i)) {
+            // Switch over halfway through
+            value = (position < 64 ? morph.source[i] : morph.target[i]);
+        } else {
+            int16_t delta = morph.target[i] - morph.source[i];
+            value = morph.source[i] + delta * position / 127;
+        }
+
+        if (value != morph.values[i]) {
+            morph.values[i] = value;
+            dirty_mask |= (1ULL << i);
+        }
+    }
+    return dirty_mask;
+}
+
+uint8_t morph_get_value(uint8_t param) {
+    return morph.values[param];
+}
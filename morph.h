@@ -0,0 +1,32 @@
+#ifndef MORPH_H
+#define MORPH_H
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MORPH_PARAMS_MAX    64 // One bit per parameter in the masks
+
+typedef struct morph {
+    bool active;
+    uint8_t params_num;
+    uint8_t source[MORPH_PARAMS_MAX];
+    uint8_t target[MORPH_PARAMS_MAX];
+    uint8_t values[MORPH_PARAMS_MAX]; // Last values returned by morph_update()
+    uint64_t differ_mask;   // Parameters that differ between source and target
+    uint64_t stepped_mask;  // Parameters that cannot be interpolated (e.g. waveforms)
+    uint8_t position;       // 0 is the source preset, 127 is the target preset
+} morph_t;
+
+void morph_start(const uint8_t *source, const uint8_t *target, uint8_t params_num, uint64_t stepped_mask);
+void morph_stop();
+bool morph_is_active();
+uint64_t morph_update(uint8_t position);
+uint8_t morph_get_value(uint8_t param);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
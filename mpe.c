@@ -0,0 +1,82 @@
+/* MPE member channel allocation */
+
+#include "pico/stdlib.h"
+#include "config.h"
+#include "mpe.h"
+
+#if MPE_MEMBER_CHANNELS > MPE_MEMBERS_MAX
+#error "An MPE zone has at most 15 member channels"
+#endif
+
+// Declare the static allocator instance
+static mpe_t mpe;
+
+void mpe_init() {
+    for (uint8_t i = 0; i < MPE_MEMBER_CHANNELS; i++) {
+        mpe.key_by_member[i] = MPE_NO_KEY;
+    }
+    mpe.next_member = 0;
+}
+
+static inline int8_t find_member(uint16_t key) {
+    for (uint8_t i = 0; i < MPE_MEMBER_CHANNELS; i++) {
+        if (mpe.key_by_member[i] == key) { return i; }
+    }
+    return MPE_NO_CHANNEL;
+}
+
+// Allocate a member channel for a new note and return its Midi channel.
+// When all members are busy, the one next in rotation is taken over:
+// stolen is then set, and the caller must end the notes of that channel.
+// So is it when a note still holds a channel under the same key,
+// which is taken over as well. The fine tuning of the note is given in cents.
+int8_t mpe_allocate(uint16_t key, uint16_t bend_origin, int8_t cents, bool *stolen) {
+    *stolen = false;
+    if (key == MPE_NO_KEY) { return MPE_NO_CHANNEL; }
+
+    int8_t member = find_member(key);
+    if (member == MPE_NO_CHANNEL) {
+        member = mpe.next_member;
+        for (uint8_t i = 0; i < MPE_MEMBER_CHANNELS; i++) {
+            uint8_t candidate = (mpe.next_member + i) % MPE_MEMBER_CHANNELS;
+            if (mpe.key_by_member[candidate] == MPE_NO_KEY) {
+                member = candidate;
+                break;
+            }
+        }
+    }
+    *stolen = (mpe.key_by_member[member] != MPE_NO_KEY);
+
+    mpe.key_by_member[member] = key;
+    mpe.bend_origin[member] = bend_origin;
+    mpe.tuning[member] = (int16_t)cents * 0x2000 / (MPE_BEND_RANGE * 100);
+    mpe.next_member = (member + 1) % MPE_MEMBER_CHANNELS;
+    return mpe_member_channel(member);
+}
+
+// Free the member channel of a note and return its Midi channel
+int8_t mpe_release(uint16_t key) {
+    int8_t member = find_member(key);
+    if (member == MPE_NO_CHANNEL) { return MPE_NO_CHANNEL; }
+    mpe.key_by_member[member] = MPE_NO_KEY;
+    return mpe_member_channel(member);
+}
+
+int8_t mpe_get_channel(uint16_t key) {
+    int8_t member = find_member(key);
+    if (member == MPE_NO_CHANNEL) { return MPE_NO_CHANNEL; }
+    return mpe_member_channel(member);
+}
+
+uint16_t mpe_get_member_key(uint8_t member) {
+    return mpe.key_by_member[member];
+}
+
+// Each note is bent by the change of tilt since it started, on top of its
+// fine tuning, so notes played while the device is tilted start in tune
+uint16_t mpe_get_bend(uint8_t member, uint16_t deviation) {
+    int32_t bend = 0x2000 + mpe.tuning[member] + (int32_t)deviation - (int32_t)mpe.bend_origin[member];
+    if (bend < 0) { bend = 0; }
+    if (bend > 0x3FFF) { bend = 0x3FFF; }
+    return (uint16_t)bend;
+}
@@ -0,0 +1,41 @@
+#ifndef MPE_H
+#define MPE_H
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MPE_MANAGER_CHANNEL     0  // Lower zone: the manager is channel 1 and the members follow it (0-based)
+#define MPE_MEMBERS_MAX         15 // All the channels but the manager
+#define MPE_NO_CHANNEL          -1
+#define MPE_NO_KEY              0xFFFF
+
+// Member channel allocator for MPE output. Each sounding note gets a member
+// channel of its own, so that pitch bend and pressure only affect that note.
+// Channels are handed out in rotation, which gives the release tail of
+// a note on the receiving synth the most time before its channel is reused.
+// Notes are told apart by a key of the caller's choosing.
+typedef struct mpe {
+    uint16_t key_by_member[MPE_MEMBERS_MAX]; // Key of the note of each member, or MPE_NO_KEY
+    uint16_t bend_origin[MPE_MEMBERS_MAX]; // Tilt at the time of note on
+    int16_t tuning[MPE_MEMBERS_MAX];        // Fine tuning of the note, in pitch bend units
+    uint8_t next_member;                    // Rotation position
+} mpe_t;
+
+void mpe_init();
+int8_t mpe_allocate(uint16_t key, uint16_t bend_origin, int8_t cents, bool *stolen);
+int8_t mpe_release(uint16_t key);
+int8_t mpe_get_channel(uint16_t key);
+uint16_t mpe_get_member_key(uint8_t member);
+uint16_t mpe_get_bend(uint8_t member, uint16_t deviation);
+
+static inline uint8_t mpe_member_channel(uint8_t member) {
+    return MPE_MANAGER_CHANNEL + 1 + member;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,28 @@
+/* Queue of notes scheduled ahead of time */
+
+#include "pico/stdlib.h"
+#include "note_queue.h"
+
+uint16_t note_queue_get_free(const note_queue_t *queue) {
+    return NOTE_QUEUE_SIZE - (uint16_t)(queue->head - queue->tail);
+}
+
+// Check note_queue_get_free() first
+void note_queue_push(note_queue_t *queue, uint32_t time_us, uint8_t id, uint8_t note, uint8_t velocity) {
+    scheduled_note_t *event = &queue->events[queue->head & (NOTE_QUEUE_SIZE - 1)];
+    event->time_us = time_us;
+    event->id = id;
+    event->note = note;
+    event->velocity = velocity;
+    queue->head++;
+}
+
+// Called from the main loop. Returns the next note if it is due by now.
+bool note_queue_pop_due(note_queue_t *queue, uint32_t now, scheduled_note_t *event) {
+    if (queue->tail == queue->head) { return false; }
+    const scheduled_note_t *next = &queue->events[queue->tail & (NOTE_QUEUE_SIZE - 1)];
+    if ((int32_t)(next->time_us - now) > 0) { return false; }
+    *event = *next;
+    queue->tail++;
+    return true;
+}
@@ -0,0 +1,36 @@
+#ifndef NOTE_QUEUE_H
+#define NOTE_QUEUE_H
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NOTE_QUEUE_SIZE     32 // Scheduled notes, must be a power of two
+
+// A note scheduled ahead of time
+typedef struct scheduled_note {
+    uint32_t time_us;           // System time the note is due at
+    uint8_t id;                 // Note id, see get_note_by_id()
+    uint8_t note;
+    uint8_t velocity;           // 0 for note off
+} scheduled_note_t;
+
+// Notes pushed in time order by the main loop, and read back by the main loop
+// once they are due, to send them to Midi. The synth gets its own copy of
+// the notes when they are scheduled, see synth_queue.h.
+typedef struct note_queue {
+    scheduled_note_t events[NOTE_QUEUE_SIZE];
+    uint16_t head;
+    uint16_t tail;
+} note_queue_t;
+
+uint16_t note_queue_get_free(const note_queue_t *queue);
+void note_queue_push(note_queue_t *queue, uint32_t time_us, uint8_t id, uint8_t note, uint8_t velocity);
+bool note_queue_pop_due(note_queue_t *queue, uint32_t now, scheduled_note_t *event);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,98 @@
+/* User preset bank, stored in flash */
+
+#include "pico/stdlib.h"
+#include <string.h>
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "config.h"
+#include "preset_bank.h"
+
+#define PRESETS_PER_SECTOR  (FLASH_SECTOR_SIZE / PRESET_RECORD_SIZE)
+
+// RAM index with one bit per slot, so that browsing the bank
+// does not require reading from flash
+static uint8_t used_mask[(NUM_PRESET_SLOTS + 7) / 8];
+
+// Presets are not written to flash as soon as they are stored. Instead, the sector
+// containing them is copied to RAM and modified there, until preset_bank_flush() is called.
+// Each sector has its own buffer, so that storing to one never has to wait for the
+// other to be written. The buffers are static: a sector is too large to allocate
+// and fail at store time.
+static uint8_t sector_cache[PRESET_BANK_SECTORS][FLASH_SECTOR_SIZE];
+static uint8_t dirty_sectors; // One bit per sector
+
+static inline const uint8_t* get_sector_address(uint8_t sector) {
+    return (const uint8_t *) (XIP_BASE + PRESET_BANK_OFFSET + sector * FLASH_SECTOR_SIZE);
+}
+
+static inline const uint8_t* get_record_address(uint8_t slot) {
+    return (const uint8_t *) (XIP_BASE + PRESET_BANK_OFFSET + slot * PRESET_RECORD_SIZE);
+}
+
+static inline void set_used(uint8_t slot, bool used) {
+    if (used) {
+        used_mask[slot >> 3] |= (1 << (slot & 0x07));
+    } else {
+        used_mask[slot >> 3] &= ~(1 << (slot & 0x07));
+    }
+}
+
+// Build the index by checking the marker byte of each record
+void preset_bank_init() {
+    for (uint8_t i = 0; i < NUM_PRESET_SLOTS; i++) {
+        set_used(i, get_record_address(i)[0] == PRESET_RECORD_VALID);
+    }
+}
+
+bool preset_bank_is_used(uint8_t slot) {
+    if (slot >= NUM_PRESET_SLOTS) { return false; }
+    return (used_mask[slot >> 3] & (1 << (slot & 0x07)));
+}
+
+// Return a pointer to the parameters of a preset, or NULL if the slot is empty.
+// The data is read in place from flash (through XIP), unless it is still pending a write.
+const uint8_t* preset_bank_get(uint8_t slot) {
+    if (!preset_bank_is_used(slot)) { return NULL; }
+    uint8_t sector = slot / PRESETS_PER_SECTOR;
+    if (dirty_sectors & (1 << sector)) {
+        return &sector_cache[sector][(slot % PRESETS_PER_SECTOR) * PRESET_RECORD_SIZE + 1];
+    }
+    return get_record_address(slot) + 1;
+}
+
+// Stage a preset for writing, along with any other pending sector.
+// Return false if the slot is out of the bank.
+bool preset_bank_store(uint8_t slot, const uint8_t *params, uint8_t params_num) {
+    if (slot >= NUM_PRESET_SLOTS) { return false; }
+    uint8_t sector = slot / PRESETS_PER_SECTOR;
+    if (!(dirty_sectors & (1 << sector))) {
+        memcpy(sector_cache[sector], get_sector_address(sector), FLASH_SECTOR_SIZE);
+        dirty_sectors |= (1 << sector);
+    }
+
+    uint8_t *record = &sector_cache[sector][(slot % PRESETS_PER_SECTOR) * PRESET_RECORD_SIZE];
+    record[0] = PRESET_RECORD_VALID;
+    memcpy(&record[1], params, params_num);
+    set_used(slot, true);
+    return true;
+}
+
+bool preset_bank_has_changes() {
+    return (dirty_sectors != 0);
+}
+
+// Write the pending sectors to flash. Core1 must not be executing from flash
+// while this is running.
+void preset_bank_flush() {
+    for (uint8_t sector = 0; sector < PRESET_BANK_SECTORS; sector++) {
+        if (!(dirty_sectors & (1 << sector))) { continue; }
+        uint32_t offset = PRESET_BANK_OFFSET + sector * FLASH_SECTOR_SIZE;
+
+        // Disable interrupts, write, and restore interrupts
+        uint32_t ints_id = save_and_disable_interrupts();
+        flash_range_erase(offset, FLASH_SECTOR_SIZE);
+        flash_range_program(offset, sector_cache[sector], FLASH_SECTOR_SIZE);
+        restore_interrupts(ints_id);
+    }
+    dirty_sectors = 0;
+}
@@ -0,0 +1,26 @@
+#ifndef PRESET_BANK_H
+#define PRESET_BANK_H
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Each preset occupies a fixed-size record in flash, so that its address
+// can be computed directly from the slot number.
+// Byte 0 of a record is a marker, followed by the synth parameters.
+#define PRESET_RECORD_SIZE          64
+#define PRESET_RECORD_VALID         0xA5 // Erased flash reads as 0xFF
+
+void preset_bank_init();
+bool preset_bank_is_used(uint8_t slot);
+const uint8_t* preset_bank_get(uint8_t slot);
+bool preset_bank_store(uint8_t slot, const uint8_t *params, uint8_t params_num);
+bool preset_bank_has_changes();
+void preset_bank_flush();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
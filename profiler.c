@@ -0,0 +1,147 @@
+/* Main loop profiler */
+
+#include "pico/stdlib.h"
+#include <stdio.h>
+#include "hardware/clocks.h"
+#include "hardware/structs/systick.h"
+#include "config.h"
+#include "profiler.h"
+
+#define AUDIO_BUFFER_US (AUDIO_BUFFER_LENGTH * 1000000 / SOUND_OUTPUT_FREQUENCY)
+#if defined (USE_MIDI)
+#define REPORT_LINES    (PROF_LAST + 1) // One line per task, then the Midi output queue
+#else
+#define REPORT_LINES    PROF_LAST
+#endif
+
+static const char* task_names[PROF_LAST] = {
+    "loop", "encoder", "touch", "imu", "looper", "midi", "usb", "display"
+};
+
+static profiler_stats_t stats[PROF_LAST];
+static uint32_t cycles[PROF_LAST];   // Accumulated over the current loop iteration
+static uint32_t loop_start;
+static uint32_t last_mark;
+static uint32_t cycles_per_us;
+static uint32_t window_start_us;
+static uint32_t window_loops;       // Loop iterations in the current window
+static uint32_t loop_rate;          // Loop iterations per second in the last window
+static uint8_t report_line;         // Next line of the UART report, REPORT_LINES when done
+static uint32_t report_line_us;
+static volatile uint32_t render_max_us; // Longest audio buffer render on core1 in the current window
+static uint32_t render_load;            // Longest render in the last window, in percent of the buffer period
+static midi_queue_stats_t midi_last;    // Midi queue counters at the start of the current window
+static midi_queue_stats_t midi_window;  // Midi queue counters over the last window
+
+void profiler_init() {
+    // Free running, clocked by the processor
+    systick_hw->rvr = 0x00FFFFFF;
+    systick_hw->cvr = 0;
+    systick_hw->csr = 0x5; // Enable, processor clock, no interrupt
+    cycles_per_us = clock_get_hz(clk_sys) / 1000000;
+    window_start_us = time_us_32();
+    report_line = REPORT_LINES;
+}
+
+// SysTick counts down from 0xFFFFFF, wrapping around about every 100ms.
+// Longer iterations, like the ones writing to flash, are not measured correctly.
+static inline uint32_t elapsed_cycles(uint32_t from, uint32_t to) {
+    return (from - to) & 0x00FFFFFF;
+}
+
+void profiler_loop_begin() {
+    loop_start = systick_hw->cvr;
+    last_mark = loop_start;
+}
+
+void profiler_mark(profiler_task_t task) {
+    uint32_t now = systick_hw->cvr;
+    cycles[task] += elapsed_cycles(last_mark, now);
+    last_mark = now;
+}
+
+static inline void update_stats(profiler_stats_t *s, uint32_t sample) {
+    s->mean_q4 += ((int32_t)(sample << 4) - (int32_t)s->mean_q4) >> PROFILER_MEAN_SHIFT;
+    if (sample > s->max) { s->max = sample; }
+}
+
+// Call at the end of each main loop iteration. Returns true when a report window is complete.
+bool profiler_loop_end() {
+    cycles[PROF_LOOP] = elapsed_cycles(loop_start, systick_hw->cvr);
+    for (uint8_t i = 0; i < PROF_LAST; i++) {
+        update_stats(&stats[i], cycles[i]);
+        cycles[i] = 0;
+    }
+
+    uint32_t now = time_us_32();
+    window_loops++;
+
+    // Print one line at a time, so that the UART FIFO never fills up
+    if (report_line < REPORT_LINES && now - report_line_us >= PROFILER_LINE_INTERVAL_US) {
+        if (report_line < PROF_LAST) {
+            printf("%-8s%6lu%6lu\n", task_names[report_line],
+                   (unsigned long)profiler_get_mean_us(report_line),
+                   (unsigned long)profiler_get_max_us(report_line));
+        } else {
+            printf("midi sent %lu, coalesced %lu, dropped %lu\n", (unsigned long)midi_window.sent,
+                   (unsigned long)midi_window.coalesced, (unsigned long)midi_window.dropped);
+        }
+        report_line++;
+        report_line_us = now;
+    }
+
+    uint32_t elapsed = now - window_start_us;
+    if (elapsed < PROFILER_REPORT_US) { return false; }
+
+    for (uint8_t i = 0; i < PROF_LAST; i++) {
+        stats[i].reported_max = stats[i].max;
+        stats[i].max = 0;
+    }
+    loop_rate = (uint64_t)window_loops * 1000000 / elapsed;
+    window_loops = 0;
+    window_start_us = now;
+    // A render finishing right now may be lost, which does not matter for a maximum
+    render_load = render_max_us * 100 / AUDIO_BUFFER_US;
+    render_max_us = 0;
+#if defined (USE_MIDI)
+    const midi_queue_stats_t *midi = midi_queue_get_stats();
+    midi_window.sent = midi->sent - midi_last.sent;
+    midi_window.coalesced = midi->coalesced - midi_last.coalesced;
+    midi_window.dropped = midi->dropped - midi_last.dropped;
+    midi_last = *midi;
+#endif
+
+    printf("%lu loops/s, render %lu%%, mean/max us:\n", (unsigned long)loop_rate, (unsigned long)render_load);
+    report_line = 0;
+    report_line_us = now;
+    return true;
+}
+
+uint32_t profiler_get_mean_us(profiler_task_t task) {
+    return (stats[task].mean_q4 >> 4) / cycles_per_us;
+}
+
+uint32_t profiler_get_max_us(profiler_task_t task) {
+    return stats[task].reported_max / cycles_per_us;
+}
+
+uint32_t profiler_get_loop_rate() {
+    return loop_rate;
+}
+
+// Called by core1 after each audio buffer, with the time it took to render it
+void __not_in_flash_func(profiler_render)(uint32_t us) {
+    if (us > render_max_us) { render_max_us = us; }
+}
+
+// With several tracks and the arpeggiator or the sequencer playing,
+// the render time must stay well below the buffer period to avoid dropouts
+uint32_t profiler_get_render_load() {
+    return render_load;
+}
+
+// Messages sent, coalesced and dropped by the Midi output queue in the last window.
+// Coalescing is expected with a lot of controller traffic, dropping is not.
+const midi_queue_stats_t* profiler_get_midi_stats() {
+    return &midi_window;
+}
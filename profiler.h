@@ -0,0 +1,50 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+#include "pico/stdlib.h"
+#include "midi_queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PROFILER_REPORT_US          1000000 // Length of the window for the maximum values
+#define PROFILER_LINE_INTERVAL_US   4000    // Report lines are spaced out, so that printing never waits for the UART
+#define PROFILER_MEAN_SHIFT         4       // Each sample moves the mean by 1/16 of its difference
+
+typedef enum profiler_task {
+    PROF_LOOP,      // A whole pass of the scheduler
+    PROF_ENCODER,
+    PROF_TOUCH,
+    PROF_IMU,       // IMU reading and tilt processing
+    PROF_LOOPER,    // Looper and arpeggiator
+    PROF_MIDI,      // Midi output, SysEx and Midi input
+    PROF_USB,
+    PROF_DISPLAY,
+    PROF_LAST
+} profiler_task_t;
+
+// Execution time of each main loop task, measured in processor cycles with SysTick.
+// The time between two marks is attributed to the task named by the second one.
+// Maximum values cover the last complete report window.
+typedef struct profiler_stats {
+    uint32_t mean_q4;           // Rolling mean per loop iteration in cycles, with 4 fractional bits
+    uint32_t max;               // Maximum in the current window
+    uint32_t reported_max;      // Maximum in the last complete window
+} profiler_stats_t;
+
+void profiler_init();
+void profiler_loop_begin();
+void profiler_mark(profiler_task_t task);
+bool profiler_loop_end();
+uint32_t profiler_get_mean_us(profiler_task_t task);
+uint32_t profiler_get_max_us(profiler_task_t task);
+uint32_t profiler_get_loop_rate();
+void profiler_render(uint32_t us);
+uint32_t profiler_get_render_load();
+const midi_queue_stats_t* profiler_get_midi_stats();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
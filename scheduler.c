@@ -0,0 +1,54 @@
+/* Cooperative core0 task scheduler */
+
+#include "pico/stdlib.h"
+#include "scheduler.h"
+
+// Tasks are kept sorted by priority
+static scheduler_task_t tasks[SCHEDULER_TASKS_MAX];
+static uint8_t tasks_count;
+
+static inline bool is_due(const scheduler_task_t *task, uint32_t now) {
+    return (int32_t)(now - task->deadline_us) >= 0;
+}
+
+void scheduler_add(void (*run)(), uint32_t period_us, uint8_t priority) {
+    if (tasks_count >= SCHEDULER_TASKS_MAX) { return; }
+    uint8_t i = tasks_count++;
+    while (i > 0 && tasks[i - 1].priority > priority) {
+        tasks[i] = tasks[i - 1];
+        i--;
+    }
+    tasks[i].run = run;
+    tasks[i].period_us = period_us;
+    tasks[i].deadline_us = time_us_32();
+    tasks[i].priority = priority;
+}
+
+// Run every task that is due, highest priority first
+void scheduler_run() {
+    for (uint8_t i = 0; i < tasks_count; i++) {
+        scheduler_task_t *task = &tasks[i];
+        uint32_t now = time_us_32();
+        if (!is_due(task, now)) { continue; }
+        task->run();
+        task->deadline_us += task->period_us;
+        if (is_due(task, now)) {
+            // The task is running late: skip the missed runs instead of catching up in a burst
+            task->deadline_us = now + task->period_us;
+        }
+    }
+}
+
+// Sleep until the earliest deadline. Interrupts (USB, DMA, GPIO, alarms) wake
+// the core earlier: the main loop then finds no task due and sleeps again.
+void scheduler_idle() {
+    if (tasks_count == 0) { return; }
+    uint32_t now = time_us_32();
+    int32_t wait_us = INT32_MAX;
+    for (uint8_t i = 0; i < tasks_count; i++) {
+        int32_t until = (int32_t)(tasks[i].deadline_us - now);
+        if (until < wait_us) { wait_us = until; }
+    }
+    if (wait_us <= 0) { return; }
+    best_effort_wfe_or_timeout(make_timeout_time_us(wait_us));
+}
@@ -0,0 +1,29 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SCHEDULER_TASKS_MAX     8
+
+// Cooperative scheduler for the core0 tasks. Each task runs once per period;
+// when several are due at once, they run in order of priority (0 first).
+// When no task is due, the core sleeps until the next deadline or interrupt.
+typedef struct scheduler_task {
+    void (*run)();
+    uint32_t period_us;
+    uint32_t deadline_us;       // Time of the next run
+    uint8_t priority;
+} scheduler_task_t;
+
+void scheduler_add(void (*run)(), uint32_t period_us, uint8_t priority);
+void scheduler_run();
+void scheduler_idle();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
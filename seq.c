@@ -0,0 +1,138 @@
+/* Step sequencer */
+
+#include "pico/stdlib.h"
+#include "config.h"
+#include "state.h"
+#include "midi_clock.h"
+#include "note_queue.h"
+#include "synth_queue.h"
+#include "seq.h"
+
+#define STEPS_PER_BEAT      4 // 1/16 notes
+
+// Declare the static sequencer instance
+static seq_t seq;
+
+// Scheduled notes, in time order, for Midi
+static note_queue_t queue;
+
+void seq_init() {
+    for (uint8_t i = 0; i < SEQ_STEPS_MAX; i++) {
+        seq.steps[i].id = SEQ_REST;
+    }
+    seq.length = SEQ_STEPS_MIN;
+}
+
+void seq_start() {
+    if (seq.playing) { return; }
+    seq.playing = true;
+    // Schedule the first step right away
+    seq.step = seq.length - 1;
+    seq.step_started = true;
+    seq.next_step_us = time_us_32();
+}
+
+void seq_stop() {
+    seq.playing = false; // The notes already scheduled end on their own
+}
+
+bool seq_is_playing() {
+    return seq.playing;
+}
+
+// The sequence plays up to the last half that has a note
+static inline void update_length() {
+    seq.length = SEQ_STEPS_MIN;
+    for (uint8_t i = SEQ_STEPS_MIN; i < SEQ_STEPS_MAX; i++) {
+        if (seq.steps[i].id != SEQ_REST) {
+            seq.length = SEQ_STEPS_MAX;
+            return;
+        }
+    }
+}
+
+// While stopped, write the step under the cursor and move to the next one.
+// Writing the note a step already has turns it into a rest.
+// While playing, write the step playing, so that it is heard on the next pass.
+void seq_write(uint8_t id, uint8_t velocity, uint8_t cutoff) {
+    uint8_t step = (seq.playing ? seq.position : seq.cursor);
+    if (!seq.playing && seq.steps[step].id == id) {
+        seq.steps[step].id = SEQ_REST;
+    } else {
+        seq.steps[step].id = id;
+        seq.steps[step].velocity = velocity >> 4;
+        seq.steps[step].cutoff = cutoff;
+    }
+    if (!seq.playing) { seq.cursor = (seq.cursor + 1) % SEQ_STEPS_MAX; }
+    update_length();
+}
+
+void seq_cursor_up() {
+    if (seq.cursor < SEQ_STEPS_MAX - 1) { seq.cursor++; }
+}
+
+void seq_cursor_down() {
+    if (seq.cursor > 0) { seq.cursor--; }
+}
+
+uint8_t seq_get_cursor() {
+    return seq.cursor;
+}
+
+uint8_t seq_get_position() {
+    return seq.position;
+}
+
+uint8_t seq_get_length() {
+    return seq.length;
+}
+
+seq_step_t seq_get_step(uint8_t step) {
+    return seq.steps[step];
+}
+
+static inline uint32_t get_step_us() {
+    return midi_clock_get_beat_us() / STEPS_PER_BEAT;
+}
+
+// Schedule the note on and note off of the next step
+static void schedule_step() {
+    uint32_t step_us = get_step_us();
+    seq.step = (seq.step + 1 < seq.length ? seq.step + 1 : 0); // The length may have just shrunk
+    seq.step_us = seq.next_step_us;
+    seq.step_started = false;
+    seq.next_step_us += step_us;
+
+    seq_step_t step = seq.steps[seq.step];
+    if (step.id == SEQ_REST) { return; }
+    uint8_t note = get_note_by_id(step.id);
+    uint8_t velocity = (step.velocity << 4) | 0x0F;
+    note_queue_push(&queue, seq.step_us, step.id, note, velocity);
+    note_queue_push(&queue, seq.step_us + step_us * SEQ_GATE / 10, step.id, note, 0);
+    synth_queue_push(seq.step_us, SYNTH_NOTE_ON, note, velocity);
+    synth_queue_push(seq.step_us + step_us * SEQ_GATE / 10, SYNTH_NOTE_OFF, note, 0);
+}
+
+// Called from the main loop. Sends the notes that are due to Midi, applies the
+// automation of the step that is due, and schedules the next step once it
+// starts within NOTE_LOOKAHEAD_US.
+void seq_task(uint32_t now) {
+    scheduled_note_t event;
+    while (note_queue_pop_due(&queue, now, &event)) {
+        seq_output(&event);
+    }
+
+    if (!seq.playing) { return; }
+    if (!seq.step_started) {
+        if ((int32_t)(now - seq.step_us) < 0) { return; }
+        seq.step_started = true;
+        seq.position = seq.step;
+        if (seq.steps[seq.step].id != SEQ_REST) { seq_automate(seq.steps[seq.step].cutoff); }
+    }
+    // If the main loop was held up for longer than the lookahead, drop the missed steps
+    if ((int32_t)(now - seq.next_step_us) > NOTE_LOOKAHEAD_US) { seq.next_step_us = now; }
+
+    if ((int32_t)(seq.next_step_us - now) < NOTE_LOOKAHEAD_US && note_queue_get_free(&queue) >= 2) {
+        schedule_step();
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef SEQ_H
+#define SEQ_H
+#include "pico/stdlib.h"
+#include "note_queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SEQ_STEPS_MAX       32
+#define SEQ_STEPS_MIN       16 // The sequence is 16 steps long, unless a later step is used
+#define SEQ_REST            0x3F
+
+// A step, packed in two bytes
+typedef struct seq_step {
+    uint16_t id : 6;                    // Note id, or SEQ_REST
+    uint16_t velocity : 3;              // Velocity in steps of 16
+    uint16_t cutoff : 7;                // Tilt of the filter cutoff axis when the step was written
+} seq_step_t;
+
+// Step sequencer, playing 1/16 notes in a loop at the tempo of the arpeggiator.
+// Like the arpeggiator, steps are scheduled ahead of time by the main loop,
+// and the synth plays them on core1 at the exact sample they are due.
+typedef struct seq {
+    seq_step_t steps[SEQ_STEPS_MAX];
+    uint8_t length;                     // SEQ_STEPS_MIN or SEQ_STEPS_MAX
+    uint8_t cursor;                     // Step written by the next pad touched while stopped
+    bool playing;
+    uint8_t step;                       // Step scheduled last
+    bool step_started;                  // The step scheduled last is due
+    uint8_t position;                   // Step playing
+    uint32_t step_us;                   // Time of the step scheduled last
+    uint32_t next_step_us;              // Time of the next step to schedule
+} seq_t;
+
+void seq_init();
+void seq_start();
+void seq_stop();
+bool seq_is_playing();
+void seq_write(uint8_t id, uint8_t velocity, uint8_t cutoff);
+void seq_cursor_up();
+void seq_cursor_down();
+uint8_t seq_get_cursor();
+uint8_t seq_get_position();
+uint8_t seq_get_length();
+seq_step_t seq_get_step(uint8_t step);
+void seq_task(uint32_t now);
+
+extern void seq_output(const scheduled_note_t *event);
+extern void seq_automate(uint8_t cutoff);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
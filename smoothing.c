@@ -0,0 +1,53 @@
+/* One-pole smoothing of IMU-driven parameters */
+
+#include "pico/stdlib.h"
+#include "smoothing.h"
+
+static smoothed_param_t params[SMOOTH_LAST];
+
+void smoothing_init(smoothed_param_id_t id, uint16_t value, uint8_t shift) {
+    smoothed_param_t *param = &params[id];
+    param->target = value;
+    param->value = (int32_t)value << 8;
+    param->output = value;
+    param->shift = shift;
+    param->active = false;
+    param->invalid = false;
+}
+
+// Called from core0. Setting a target activates the parameter.
+void smoothing_set_target(smoothed_param_id_t id, uint16_t target) {
+    params[id].target = target;
+    params[id].active = true;
+}
+
+// Called from core0. The parameter keeps its last value but is no longer sent.
+void smoothing_release(smoothed_param_id_t id) {
+    params[id].active = false;
+}
+
+// Make sure the next output is sent even if the value has not changed,
+// e.g. because the synth parameter has been overwritten by a preset
+void smoothing_invalidate(smoothed_param_id_t id) {
+    params[id].invalid = true;
+}
+
+// Called from core1 once per audio buffer.
+// Returns true if the output value has changed and needs to be sent.
+bool __not_in_flash_func(smoothing_process)(smoothed_param_id_t id, uint16_t *output) {
+    smoothed_param_t *param = &params[id];
+    if (!param->active) { return false; }
+
+    int32_t delta = ((int32_t)param->target << 8) - param->value;
+    int32_t step = delta >> param->shift;
+    // Make sure the target is eventually reached
+    if (step == 0 && delta != 0) { step = (delta > 0 ? 1 : -1); }
+    param->value += step;
+
+    uint16_t value = (uint16_t)((param->value + 0x80) >> 8); // Rounded
+    if (value == param->output && !param->invalid) { return false; }
+    param->output = value;
+    param->invalid = false;
+    *output = value;
+    return true;
+}
@@ -0,0 +1,36 @@
+#ifndef SMOOTHING_H
+#define SMOOTHING_H
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Parameters driven by the IMU. Their targets are set from core0,
+// and they are smoothed and sent to the synth once per audio buffer on core1.
+typedef enum smoothed_param_id {
+    SMOOTH_CUTOFF,
+    SMOOTH_PITCH_BEND,
+    SMOOTH_LAST,
+} smoothed_param_id_t;
+
+typedef struct smoothed_param {
+    volatile uint16_t target;
+    volatile bool active;       // Inactive parameters are not sent to the synth
+    volatile bool invalid;      // Forces the next output to be sent
+    int32_t value;              // Current value, with 8 extra bits of precision
+    uint16_t output;            // Last value sent to the synth
+    uint8_t shift;              // Smoothing amount: each step covers 1/(2^shift) of the distance
+} smoothed_param_t;
+
+void smoothing_init(smoothed_param_id_t id, uint16_t value, uint8_t shift);
+void smoothing_set_target(smoothed_param_id_t id, uint16_t target);
+void smoothing_release(smoothed_param_id_t id);
+void smoothing_invalidate(smoothed_param_id_t id);
+bool smoothing_process(smoothed_param_id_t id, uint16_t *output);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
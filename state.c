@@ -2,11 +2,43 @@
 #include "state.h"
 #include "config.h"
 #include "scales.h"
+#include "tunings.h"
 #include "instrument_preset.h"
+#include "preset_bank.h"
 
 // Declare the static state instance
 static state_t state;
 
+// Note played by each note id and its fine tuning, kept up to date when the key,
+// the extended scale or the tuning change, so that playing a note is a single lookup
+static uint8_t note_map[NUM_NOTE_IDS];
+static int8_t cents_map[NUM_NOTE_IDS];
+
+static inline void update_note(uint8_t index) {
+    int8_t cents = tunings[state.tuning][state.extended_scale[index] % 12];
+    uint16_t note = state.key + state.extended_scale[index];
+    for (uint8_t id = index; id < NUM_NOTE_IDS; id += 12) {
+        while (note > 127) { note -= 12; } // Fold down the octaves out of the Midi range
+        note_map[id] = (uint8_t)note;
+        cents_map[id] = cents;
+        note += 12;
+    }
+}
+
+static void update_note_map() {
+    for (uint8_t i = 0; i < 12; i++) {
+        update_note(i);
+    }
+}
+
+uint8_t get_note_by_id(uint8_t id) {
+    return note_map[id];
+}
+
+int8_t get_cents_by_id(uint8_t id) {
+    return cents_map[id];
+}
+
 state_t* get_state(void) {
     return &state;
 }
@@ -19,6 +51,7 @@ uint8_t get_key() {
 
 void set_key(uint8_t key) {
     state.key = key;
+    update_note_map();
     set_tonic(key % 12);
     set_octave(key / 12); // C3 is on octave 5 in this system because
                           // octave -1 is the first element
@@ -107,6 +140,199 @@ uint8_t get_extended_scale(uint8_t index) {
 
 void set_extended_scale(uint8_t index, uint8_t degree) {
     state.extended_scale[index] = degree;
+    update_note(index);
+}
+
+/* Tuning */
+
+uint8_t get_tuning() {
+    return state.tuning;
+}
+
+void set_tuning(uint8_t tuning) {
+    state.tuning = tuning;
+    update_note_map();
+}
+
+void set_tuning_up() {
+    uint8_t tuning = get_tuning();
+    if (tuning < NUM_TUNINGS - 1) {
+        set_tuning(tuning + 1);
+    }
+}
+
+void set_tuning_down() {
+    uint8_t tuning = get_tuning();
+    if (tuning > 0) {
+        set_tuning(tuning - 1);
+    }
+}
+
+/* Chords */
+
+chord_mode_t get_chord_mode() {
+    return state.chord_mode;
+}
+
+void set_chord_mode(chord_mode_t chord_mode) {
+    state.chord_mode = chord_mode;
+}
+
+void set_chord_mode_up() {
+    chord_mode_t chord_mode = get_chord_mode();
+    if (chord_mode < CHORD_LAST - 1) {
+        set_chord_mode((chord_mode_t)(chord_mode + 1));
+    }
+}
+
+void set_chord_mode_down() {
+    chord_mode_t chord_mode = get_chord_mode();
+    if (chord_mode > CHORD_OFF) {
+        set_chord_mode((chord_mode_t)(chord_mode - 1));
+    }
+}
+
+// Degree of a step of the extended scale, which continues past the 12 pads
+// by repeating the scale on higher octaves
+static inline uint8_t get_extended_degree(uint8_t index) {
+    uint8_t scale_size = get_scale_size(state.scale);
+    uint8_t octave_shift = 0;
+    while (index >= 12) {
+        index -= scale_size;
+        octave_shift += 12;
+    }
+    return state.extended_scale[index] + octave_shift;
+}
+
+// Fill notes with what a pad plays in the current chord mode, root first,
+// stacking every other step of the scale, and cents with the fine tuning of
+// each of them, after its own degree. Returns the number of notes.
+uint8_t get_chord_by_id(uint8_t id, uint8_t notes[CHORD_NOTES_MAX], int8_t cents[CHORD_NOTES_MAX]) {
+    notes[0] = note_map[id];
+    cents[0] = cents_map[id];
+    uint8_t count = 1;
+    uint8_t size = 1;
+    if (state.chord_mode == CHORD_TRIAD) { size = 3; }
+    if (state.chord_mode == CHORD_SEVENTH) { size = 4; }
+    uint8_t pad = id % 12;
+    uint8_t octave_shift = id / 12 * 12;
+    for (uint8_t i = 1; i < size; i++) {
+        uint8_t degree = get_extended_degree(pad + i * 2);
+        uint16_t note = state.key + degree + octave_shift;
+        if (note > 127) { break; }
+        notes[count] = (uint8_t)note;
+        cents[count++] = tunings[state.tuning][degree % 12];
+    }
+    return count;
+}
+
+/* Arpeggiator */
+
+arp_pattern_t get_arp_pattern() {
+    return state.arp_pattern;
+}
+
+void set_arp_pattern(arp_pattern_t pattern) {
+    state.arp_pattern = pattern;
+}
+
+uint8_t get_arp_rate() {
+    return state.arp_rate;
+}
+
+void set_arp_rate(uint8_t rate) {
+    state.arp_rate = rate;
+}
+
+uint8_t get_arp_octaves() {
+    return state.arp_octaves;
+}
+
+void set_arp_octaves(uint8_t octaves) {
+    state.arp_octaves = octaves;
+}
+
+uint8_t get_arp_gate() {
+    return state.arp_gate;
+}
+
+void set_arp_gate(uint8_t gate) {
+    state.arp_gate = gate;
+}
+
+arp_field_t get_arp_field() {
+    return state.arp_field;
+}
+
+void set_arp_field(arp_field_t field) {
+    state.arp_field = field;
+}
+
+void set_arp_field_up() {
+    // Wrap around
+    set_arp_field((arp_field_t)((get_arp_field() + 1) % ARP_FIELD_LAST));
+}
+
+void set_arp_field_down() {
+    // Wrap around
+    set_arp_field((arp_field_t)((get_arp_field() + ARP_FIELD_LAST - 1) % ARP_FIELD_LAST));
+}
+
+// Change the selected setting, without wrapping around
+void set_arp_value_up() {
+    switch (get_arp_field()) {
+        case ARP_FIELD_PATTERN:
+            if (state.arp_pattern < ARP_PATTERN_LAST - 1) { state.arp_pattern++; }
+        break;
+        case ARP_FIELD_RATE:
+            if (state.arp_rate < NUM_ARP_RATES - 1) { state.arp_rate++; }
+        break;
+        case ARP_FIELD_OCTAVES:
+            if (state.arp_octaves < NOTE_OCTAVES) { state.arp_octaves++; }
+        break;
+        case ARP_FIELD_GATE:
+            if (state.arp_gate < ARP_GATE_MAX) { state.arp_gate++; }
+        break;
+        default:
+        break;
+    }
+}
+
+void set_arp_value_down() {
+    switch (get_arp_field()) {
+        case ARP_FIELD_PATTERN:
+            if (state.arp_pattern > ARP_OFF) { state.arp_pattern--; }
+        break;
+        case ARP_FIELD_RATE:
+            if (state.arp_rate > 0) { state.arp_rate--; }
+        break;
+        case ARP_FIELD_OCTAVES:
+            if (state.arp_octaves > 1) { state.arp_octaves--; }
+        break;
+        case ARP_FIELD_GATE:
+            if (state.arp_gate > 1) { state.arp_gate--; }
+        break;
+        default:
+        break;
+    }
+}
+
+track_field_t get_track_field() {
+    return state.track_field;
+}
+
+void set_track_field(track_field_t field) {
+    state.track_field = field;
+}
+
+void set_track_field_up() {
+    // Wrap around
+    set_track_field((track_field_t)((get_track_field() + 1) % TRACK_FIELD_LAST));
+}
+
+void set_track_field_down() {
+    // Wrap around
+    set_track_field((track_field_t)((get_track_field() + TRACK_FIELD_LAST - 1) % TRACK_FIELD_LAST));
 }
 
 /* Instrument */
@@ -119,20 +345,36 @@ void set_instrument(uint8_t instrument) {
     state.instrument = instrument;
 }
 
+static inline bool is_instrument_available(uint8_t instrument) {
+    if (instrument < NUM_INSTRUMENTS_BUILTIN) { return true; }
+    // Skip empty user preset slots
+    return preset_bank_is_used(instrument - NUM_INSTRUMENTS_BUILTIN);
+}
+
 void set_instrument_up() {
     uint8_t instrument = get_instrument();
-    if(instrument < 8 + NUM_PRESET_SLOTS) { instrument++; }
+    for (uint8_t i = instrument + 1; i < NUM_INSTRUMENTS; i++) {
+        if (is_instrument_available(i)) {
+            instrument = i;
+            break;
+        }
+    }
     set_instrument(instrument);
 }
 
 void set_instrument_down() {
     uint8_t instrument = get_instrument();
-    if(instrument > 0) { instrument--; }
+    for (int16_t i = instrument - 1; i >= 0; i--) {
+        if (is_instrument_available(i)) {
+            instrument = i;
+            break;
+        }
+    }
     set_instrument(instrument);
 }
 
 /* Context */
-uint8_t get_context() {
+context_t get_context() {
     return state.context;
 }
 
@@ -141,7 +383,7 @@ void set_context(context_t context) {
 }
 
 /* Selection */
-uint8_t get_selection() {
+selection_t get_selection() {
     return state.selection;
 }
 
@@ -185,6 +427,41 @@ void set_imu_axes_down() {
     set_imu_axes(imu_axes);
 }
 
+/* Morph slot */
+
+int8_t get_morph_slot() {
+    return state.morph_slot;
+}
+
+void set_morph_slot(int8_t slot) {
+    state.morph_slot = slot;
+}
+
+void set_morph_slot_up() {
+    int8_t slot = get_morph_slot();
+    // Only stored presets can be selected. Do not wrap around
+    for (int16_t i = slot + 1; i < NUM_PRESET_SLOTS; i++) {
+        if (preset_bank_is_used(i)) {
+            slot = i;
+            break;
+        }
+    }
+    set_morph_slot(slot);
+}
+
+void set_morph_slot_down() {
+    int8_t slot = get_morph_slot();
+    // Only stored presets can be selected. Do not wrap around
+    for (int16_t i = slot - 1; i >= 0; i--) {
+        if (preset_bank_is_used(i)) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot == get_morph_slot()) { slot = -1; } // No stored presets below
+    set_morph_slot(slot);
+}
+
 /* Tonic */
 
 uint8_t get_tonic() {
@@ -462,6 +739,7 @@ void set_degree(uint8_t step, uint8_t degree) {
         degree = 24;
     }
     state.extended_scale[step] = degree;
+    update_note(step);
 }
 
 void set_degree_up() {
@@ -22,6 +22,16 @@ typedef enum context {
     CTX_SCALE_EDIT_STEP,
     CTX_SCALE_EDIT_DEG,
     CTX_SCALE_EDIT_STORE,
+    CTX_MORPH_SLOT,
+    CTX_DIAGNOSTICS,
+    CTX_TUNING,
+    CTX_CHORD,
+    CTX_ARP_FIELD,
+    CTX_ARP_VALUE,
+    CTX_SEQUENCER,
+    CTX_TRACK_FIELD,
+    CTX_TRACK_VALUE,
+    CTX_MIDI_DIAGNOSTICS,
 } context_t;
 
 typedef enum selection {
@@ -31,12 +41,62 @@ typedef enum selection {
     SELECTION_VOLUME,
     SELECTION_LOOPER,
     SELECTION_IMU_CONFIG,
+    SELECTION_CHORD,
+    SELECTION_ARP,
+    SELECTION_SEQUENCER,
+    SELECTION_TRACKS,
     SELECTION_LAST,
 } selection_t;
 
+typedef enum chord_mode {
+    CHORD_OFF,                      // Each pad plays a single note
+    CHORD_TRIAD,                    // Each pad plays the triad built on its scale degree
+    CHORD_SEVENTH,                  // Same, with the seventh added
+    CHORD_LAST,
+} chord_mode_t;
+
+#define CHORD_NOTES_MAX     4
+
+typedef enum arp_pattern {
+    ARP_OFF,
+    ARP_UP,
+    ARP_DOWN,
+    ARP_UP_DOWN,
+    ARP_RANDOM,
+    ARP_AS_PLAYED,
+    ARP_PATTERN_LAST,
+} arp_pattern_t;
+
+// Arpeggiator settings, edited one at a time
+typedef enum arp_field {
+    ARP_FIELD_PATTERN,
+    ARP_FIELD_RATE,
+    ARP_FIELD_OCTAVES,
+    ARP_FIELD_GATE,
+    ARP_FIELD_LAST,
+} arp_field_t;
+
+// Looper track settings, edited one at a time
+typedef enum track_field {
+    TRACK_FIELD_TRACK,
+    TRACK_FIELD_INSTRUMENT,
+    TRACK_FIELD_VOLUME,
+    TRACK_FIELD_PLAYBACK, // Speed and direction of the whole looper
+    TRACK_FIELD_LAST,
+} track_field_t;
+
+#define NUM_ARP_RATES       6
+#define ARP_GATE_MAX        10 // Gate length in tenths of a step
+
+// Note ids are the pad numbers, raised by 12 for each octave above the pad
+// (e.g. by the arpeggiator octave range)
+#define NOTE_OCTAVES        4
+#define NUM_NOTE_IDS        (12 * NOTE_OCTAVES)
+
 typedef struct state {
     uint8_t key;
     uint8_t scale;
+    uint8_t tuning;                 // Cent offsets applied to the notes of the scale
     uint8_t tonic;                  // The 'base' note
     uint8_t extended_scale[12];     // A copy of the scale array, padded with
                                     // repeated notes shifted up in octaves,
@@ -67,12 +127,22 @@ typedef struct state {
                                     // 0x1 - rolling the device bends the pitch
                                     // 0x2 - pitching (as in tilting) the device changes the filter cutoff frequency
                                     // 0x3 - (default) both effects are active
+    int8_t morph_slot;              // User preset to morph into by pitching the device.
+                                    // -1 disables morphing, and pitching changes the cutoff
+    chord_mode_t chord_mode;
+
+    // Arpeggiator
+    arp_pattern_t arp_pattern;
+    uint8_t arp_rate;               // Index in the step rates, from quarter notes to 1/32
+    uint8_t arp_octaves;            // Octave range, from 1 to NOTE_OCTAVES
+    uint8_t arp_gate;               // Gate length, from 1 to ARP_GATE_MAX tenths of a step
+    arp_field_t arp_field;
+
+    track_field_t track_field;      // Looper track setting being edited, the tracks are held by the looper
 
     bool low_batt;                  // Low battery detected
 } state_t;
 
-extern uint8_t get_note_by_id(uint8_t id);
-
 state_t* get_state(void);
 
 uint8_t get_key();
@@ -88,6 +158,14 @@ void set_scale_down();
 
 uint8_t get_extended_scale(uint8_t index);
 void set_extended_scale(uint8_t index, uint8_t degree);
+uint8_t get_note_by_id(uint8_t id);
+int8_t get_cents_by_id(uint8_t id);
+uint8_t get_chord_by_id(uint8_t id, uint8_t notes[CHORD_NOTES_MAX], int8_t cents[CHORD_NOTES_MAX]);
+
+uint8_t get_tuning();
+void set_tuning(uint8_t tuning);
+void set_tuning_up();
+void set_tuning_down();
 
 uint8_t get_instrument();
 void set_instrument(uint8_t instrument);
@@ -107,6 +185,35 @@ void set_imu_axes(uint8_t imu_axes);
 void set_imu_axes_up();
 void set_imu_axes_down();
 
+chord_mode_t get_chord_mode();
+void set_chord_mode(chord_mode_t chord_mode);
+void set_chord_mode_up();
+void set_chord_mode_down();
+
+arp_pattern_t get_arp_pattern();
+void set_arp_pattern(arp_pattern_t pattern);
+uint8_t get_arp_rate();
+void set_arp_rate(uint8_t rate);
+uint8_t get_arp_octaves();
+void set_arp_octaves(uint8_t octaves);
+uint8_t get_arp_gate();
+void set_arp_gate(uint8_t gate);
+arp_field_t get_arp_field();
+void set_arp_field(arp_field_t field);
+void set_arp_field_up();
+void set_arp_field_down();
+void set_arp_value_up();
+void set_arp_value_down();
+track_field_t get_track_field();
+void set_track_field(track_field_t field);
+void set_track_field_up();
+void set_track_field_down();
+
+int8_t get_morph_slot();
+void set_morph_slot(int8_t slot);
+void set_morph_slot_up();
+void set_morph_slot_down();
+
 uint8_t get_tonic();
 void set_tonic(uint8_t tonic);
 
@@ -0,0 +1,59 @@
+/* Queue of the synth events, from core0 to core1 */
+
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "synth_queue.h"
+
+static synth_queue_t queue;
+
+// Called from core0. Returns false if the queue is full and the event was dropped.
+bool synth_queue_push(uint32_t time_us, synth_event_type_t type, uint8_t data1, uint8_t data2) {
+    if ((uint16_t)(queue.head - queue.tail) >= SYNTH_QUEUE_SIZE) {
+        queue.dropped++;
+        return false;
+    }
+    synth_event_t *event = &queue.events[queue.head & (SYNTH_QUEUE_SIZE - 1)];
+    event->time_us = time_us;
+    event->type = type;
+    event->data1 = data1;
+    event->data2 = data2;
+    __mem_fence_release(); // The event must be complete before core1 can see it
+    queue.head++;
+    return true;
+}
+
+// Move the events received into the pending list, after the ones due at the same time
+static inline void __not_in_flash_func(receive)() {
+    while (queue.tail != queue.head && queue.pending_count < SYNTH_PENDING_MAX) {
+        __mem_fence_acquire();
+        synth_event_t event = queue.events[queue.tail & (SYNTH_QUEUE_SIZE - 1)];
+        __mem_fence_release(); // Done reading the slot before it can be reused
+        queue.tail++;
+
+        uint8_t i = queue.pending_count;
+        while (i > 0 && (int32_t)(queue.pending[i - 1].time_us - event.time_us) > 0) {
+            queue.pending[i] = queue.pending[i - 1];
+            i--;
+        }
+        queue.pending[i] = event;
+        queue.pending_count++;
+    }
+}
+
+// Called from core1 with the time of the sample being rendered.
+// Returns the next event if it is due by then.
+bool __not_in_flash_func(synth_queue_pop_due)(uint32_t time_us, synth_event_t *event) {
+    receive();
+    if (queue.pending_count == 0) { return false; }
+    if ((int32_t)(queue.pending[0].time_us - time_us) > 0) { return false; }
+    *event = queue.pending[0];
+    queue.pending_count--;
+    for (uint8_t i = 0; i < queue.pending_count; i++) {
+        queue.pending[i] = queue.pending[i + 1];
+    }
+    return true;
+}
+
+uint32_t synth_queue_get_dropped() {
+    return queue.dropped;
+}
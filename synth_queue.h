@@ -0,0 +1,50 @@
+#ifndef SYNTH_QUEUE_H
+#define SYNTH_QUEUE_H
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SYNTH_QUEUE_SIZE        128 // Events in transit from core0, must be a power of two
+#define SYNTH_PENDING_MAX       64  // Events received by core1 and not due yet
+
+typedef enum synth_event_type {
+    SYNTH_NOTE_ON,
+    SYNTH_NOTE_OFF,
+    SYNTH_ALL_NOTES_OFF,
+    SYNTH_CONTROL_CHANGE,
+    SYNTH_PITCH_BEND,
+} synth_event_type_t;
+
+typedef struct synth_event {
+    uint32_t time_us;           // System time the event is due at
+    uint8_t type;               // See synth_event_type_t
+    uint8_t data1;              // Note, control number or bend LSB
+    uint8_t data2;              // Velocity, value or bend MSB
+} synth_event_t;
+
+// Every note the synth plays goes through this queue, whatever its source
+// (pads, looper, arpeggiator, sequencer, Midi input), so that core1 is the
+// only one playing notes on the synth. So do the control changes and the
+// pitch bend received over Midi. Core0 pushes the events, either due now or
+// scheduled ahead of time; core1 keeps them sorted by time, and plays them
+// at the sample they are due. Events due at the same time keep their order.
+typedef struct synth_queue {
+    synth_event_t events[SYNTH_QUEUE_SIZE];
+    volatile uint16_t head;             // Written by core0
+    volatile uint16_t tail;             // Written by core1
+    synth_event_t pending[SYNTH_PENDING_MAX]; // Core1 only, in time order
+    uint8_t pending_count;
+    uint32_t dropped;                   // Events pushed while the queue was full
+} synth_queue_t;
+
+bool synth_queue_push(uint32_t time_us, synth_event_type_t type, uint8_t data1, uint8_t data2);
+bool synth_queue_pop_due(uint32_t time_us, synth_event_t *event);
+uint32_t synth_queue_get_dropped();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
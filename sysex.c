@@ -0,0 +1,225 @@
+/* System exclusive bulk dump and load */
+
+#include "pico/stdlib.h"
+#include "midi_queue.h"
+#include "sysex.h"
+
+#define HEADER_LENGTH   3 // F0, manufacturer and device
+
+// Incoming frame, assembled from the USB Midi packets
+static uint8_t rx_frame[SYSEX_FRAME_MAX];
+static uint8_t rx_length;
+static bool rx_overflow;
+
+// Object being received, one chunk after the other
+static struct {
+    bool active;
+    uint8_t type;
+    uint8_t index;
+    uint16_t size;
+    uint16_t next_chunk;
+} load;
+
+// Objects being sent, one chunk per frame
+static struct {
+    bool active;
+    bool all;       // Send every available object of the type
+    uint8_t type;
+    uint8_t index;
+    uint16_t chunk;
+} dump;
+
+static inline uint8_t checksum(const uint8_t *data, uint8_t length) {
+    uint8_t sum = 0;
+    for (uint8_t i = 0; i < length; i++) {
+        sum += data[i];
+    }
+    return (uint8_t)(-sum) & 0x7F;
+}
+
+static uint8_t pack(const uint8_t *data, uint8_t length, uint8_t *packed) {
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < length; i += 7) {
+        uint8_t *msbs = &packed[n++];
+        *msbs = 0;
+        for (uint8_t j = 0; j < 7 && i + j < length; j++) {
+            if (data[i + j] & 0x80) { *msbs |= (1 << j); }
+            packed[n++] = data[i + j] & 0x7F;
+        }
+    }
+    return n;
+}
+
+static uint8_t unpack(const uint8_t *packed, uint8_t length, uint8_t *data) {
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < length; i += 8) {
+        uint8_t msbs = packed[i];
+        for (uint8_t j = 0; j < 7 && i + 1 + j < length; j++) {
+            data[n++] = packed[i + 1 + j] | ((msbs >> j) & 0x01) << 7;
+        }
+    }
+    return n;
+}
+
+// Complete a frame with its header, checksum and end byte, then queue it
+static bool send_frame(uint8_t *frame, uint8_t length) {
+    frame[0] = 0xF0;
+    frame[1] = SYSEX_MANUFACTURER_ID;
+    frame[2] = SYSEX_DEVICE_ID;
+    frame[length] = checksum(&frame[HEADER_LENGTH], length - HEADER_LENGTH);
+    frame[length + 1] = 0xF7;
+    return midi_queue_push_sysex(0, frame, length + 2);
+}
+
+static void send_reply(uint8_t command, uint8_t type, uint8_t index, uint16_t chunk) {
+    uint8_t frame[10];
+    frame[3] = command;
+    frame[4] = type;
+    frame[5] = index;
+    frame[6] = (chunk >> 7) & 0x7F;
+    frame[7] = chunk & 0x7F;
+    send_frame(frame, 8);
+}
+
+static void receive_data(const uint8_t *fields, uint8_t length) {
+    if (length < 7) { return; }
+    uint8_t type = fields[1];
+    uint8_t index = fields[2];
+    uint16_t size = (fields[3] << 7) | fields[4];
+    uint16_t chunk = (fields[5] << 7) | fields[6];
+
+    if (chunk == 0) { // A new object starts
+        load.active = true;
+        load.type = type;
+        load.index = index;
+        load.size = size;
+        load.next_chunk = 0;
+    }
+    uint32_t offset = (uint32_t)chunk * SYSEX_CHUNK_SIZE;
+    if (!load.active || load.type != type || load.index != index || load.size != size ||
+        load.next_chunk != chunk || offset >= size) {
+        load.active = false;
+        send_reply(SYSEX_NAK, type, index, chunk);
+        return;
+    }
+
+    uint8_t chunk_length = (size - offset < SYSEX_CHUNK_SIZE ? size - offset : SYSEX_CHUNK_SIZE);
+    uint8_t data[SYSEX_CHUNK_SIZE];
+    if (length - 7 != SYSEX_PACKED_SIZE(chunk_length) ||
+        unpack(&fields[7], length - 7, data) != chunk_length ||
+        !sysex_object_write(type, index, offset, data, chunk_length, size)) {
+        load.active = false;
+        send_reply(SYSEX_NAK, type, index, chunk);
+        return;
+    }
+
+    load.next_chunk++;
+    if (offset + chunk_length >= size) { load.active = false; } // Object complete
+    send_reply(SYSEX_ACK, type, index, chunk);
+}
+
+static void receive_request(const uint8_t *fields, uint8_t length, bool all) {
+    if (length < 3) { return; }
+    dump.type = fields[1];
+    dump.all = all;
+    dump.index = (all ? 0 : fields[2]);
+    dump.chunk = 0;
+    dump.active = true;
+}
+
+static void receive_frame() {
+    if (rx_length < HEADER_LENGTH + 3 ||
+        rx_frame[1] != SYSEX_MANUFACTURER_ID || rx_frame[2] != SYSEX_DEVICE_ID) { return; }
+
+    // Fields go from the command to the checksum, excluded
+    const uint8_t *fields = &rx_frame[HEADER_LENGTH];
+    uint8_t length = rx_length - HEADER_LENGTH - 2;
+    if (checksum(fields, length + 1) != 0) {
+        if (fields[0] == SYSEX_DATA && length >= 7) {
+            load.active = false;
+            send_reply(SYSEX_NAK, fields[1], fields[2], (fields[5] << 7) | fields[6]);
+        }
+        return;
+    }
+
+    switch (fields[0]) {
+        case SYSEX_REQUEST:
+            receive_request(fields, length, false);
+        break;
+        case SYSEX_REQUEST_ALL:
+            receive_request(fields, length, true);
+        break;
+        case SYSEX_DATA:
+            receive_data(fields, length);
+        break;
+        default:
+            return; // Replies from the host need no action
+    }
+}
+
+// Collect the bytes of a system exclusive message, as carried by USB Midi packets
+void sysex_receive(const uint8_t *data, uint8_t length) {
+    for (uint8_t i = 0; i < length; i++) {
+        uint8_t byte = data[i];
+        if (byte == 0xF0) { // Start of a new frame
+            rx_length = 0;
+            rx_overflow = false;
+        }
+        if (rx_length >= SYSEX_FRAME_MAX) {
+            rx_overflow = true; // Not one of ours, ignore it
+        } else {
+            rx_frame[rx_length++] = byte;
+        }
+        if (byte == 0xF7) {
+            if (!rx_overflow) { receive_frame(); }
+            rx_length = 0;
+        }
+    }
+}
+
+// Move on to the next object of the dump, skipping the empty ones
+static void next_object() {
+    dump.chunk = 0;
+    if (!dump.all) {
+        dump.active = false;
+        return;
+    }
+    dump.index++;
+    if (dump.index >= sysex_object_count(dump.type)) { dump.active = false; }
+}
+
+// Send the pending dump chunks, as long as the output queue has room for them.
+// Only a few frames are built per call, so a long dump does not hold back the main loop.
+void sysex_task() {
+    uint8_t frame[SYSEX_FRAME_MAX];
+    while (dump.active) {
+        if (dump.index >= sysex_object_count(dump.type)) {
+            dump.active = false;
+            return;
+        }
+        uint16_t size = sysex_object_size(dump.type, dump.index);
+        if (size == 0 || size > SYSEX_OBJECT_SIZE_MAX) { // Nothing to send
+            if (!dump.all) { send_reply(SYSEX_NAK, dump.type, dump.index, 0); }
+            next_object();
+            continue;
+        }
+
+        uint16_t offset = dump.chunk * SYSEX_CHUNK_SIZE;
+        uint8_t chunk_length = (size - offset < SYSEX_CHUNK_SIZE ? size - offset : SYSEX_CHUNK_SIZE);
+        uint8_t data[SYSEX_CHUNK_SIZE];
+        sysex_object_read(dump.type, dump.index, offset, data, chunk_length);
+
+        frame[3] = SYSEX_DATA;
+        frame[4] = dump.type;
+        frame[5] = dump.index;
+        frame[6] = (size >> 7) & 0x7F;
+        frame[7] = size & 0x7F;
+        frame[8] = (dump.chunk >> 7) & 0x7F;
+        frame[9] = dump.chunk & 0x7F;
+        uint8_t length = 10 + pack(data, chunk_length, &frame[10]);
+        if (!send_frame(frame, length)) { return; } // Queue full, try again on the next iteration
+
+        dump.chunk++;
+        if (offset + chunk_length >= size) { next_object(); }
+    }
+}
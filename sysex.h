@@ -0,0 +1,50 @@
+#ifndef SYSEX_H
+#define SYSEX_H
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Bulk dump and load of user data through system exclusive messages.
+// Every frame is: F0 7D 44 <command> <type> <index> [fields] <checksum> F7
+// where 7D is the non-commercial manufacturer ID and 44 is "D" for Dodepan.
+// Data frames carry the object size and the chunk number (two 7-bit bytes each,
+// most significant first) and up to SYSEX_CHUNK_SIZE bytes of data, packed
+// in groups of seven bytes preceded by a byte holding their most significant bits.
+// The checksum makes the sum of the bytes from the command on a multiple of 128.
+#define SYSEX_MANUFACTURER_ID   0x7D
+#define SYSEX_DEVICE_ID         0x44
+#define SYSEX_CHUNK_SIZE        64      // Data bytes per frame, before packing
+#define SYSEX_PACKED_SIZE(n)    ((n) + ((n) + 6) / 7)
+#define SYSEX_FRAME_MAX         (12 + SYSEX_PACKED_SIZE(SYSEX_CHUNK_SIZE))
+#define SYSEX_OBJECT_SIZE_MAX   0x3FFF  // Sizes are sent as two 7-bit bytes
+
+typedef enum sysex_command {
+    SYSEX_REQUEST = 0x01, // Ask for a dump of an object
+    SYSEX_REQUEST_ALL,    // Ask for a dump of every object of a type, the index is ignored
+    SYSEX_DATA,           // A chunk of an object, sent in either direction
+    SYSEX_ACK,            // A data chunk was received and stored
+    SYSEX_NAK,            // A data chunk was rejected, the whole object must be sent again
+} sysex_command_t;
+
+typedef enum sysex_object_type {
+    SYSEX_PRESET = 0x01,  // User presets, indexed by slot
+    SYSEX_SCALE,          // User scales, indexed by slot
+    SYSEX_LOOP,           // The looper tracks, indexed by track
+} sysex_object_type_t;
+
+void sysex_receive(const uint8_t *data, uint8_t length);
+void sysex_task();
+
+extern uint8_t sysex_object_count(uint8_t type);
+extern uint16_t sysex_object_size(uint8_t type, uint8_t index);
+extern void sysex_object_read(uint8_t type, uint8_t index, uint16_t offset, uint8_t *data, uint8_t length);
+extern bool sysex_object_write(uint8_t type, uint8_t index, uint16_t offset,
+                               const uint8_t *data, uint8_t length, uint16_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
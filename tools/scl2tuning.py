@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+"""Convert a Scala tuning file (.scl) into a Dodepan tuning table.
+
+Dodepan tunings are cent offsets from equal temperament for each of the
+twelve semitones above the key, so only 12-note scales repeating at the
+octave can be converted. The output is a row for the tunings array in
+tunings.h and a name for tuning_names in display/display_strings.h.
+
+Usage: scl2tuning.py file.scl [name]
+"""
+
+import math
+import os
+import sys
+from fractions import Fraction
+
+
+def parse_pitch(text):
+    """Return the pitch of a Scala pitch line, in cents."""
+    value = text.split()[0]
+    if '.' in value:
+        return float(value)
+    ratio = Fraction(value)
+    if ratio <= 0:
+        raise ValueError('invalid ratio %s' % value)
+    return 1200 * math.log2(ratio)
+
+
+def read_scl(path):
+    """Return the description and the pitches of a Scala file."""
+    with open(path, encoding='latin-1') as f:
+        lines = [line.strip() for line in f if not line.startswith('!')]
+    description = lines[0]
+    count = int(lines[1].split()[0])
+    pitches = [parse_pitch(line) for line in lines[2:] if line][:count]
+    if len(pitches) != count:
+        raise ValueError('expected %d pitches, found %d' % (count, len(pitches)))
+    return description, pitches
+
+
+def to_offsets(pitches):
+    if len(pitches) != 12:
+        raise ValueError('only 12-note scales can be converted, this one has %d' % len(pitches))
+    if abs(pitches[-1] - 1200) > 0.5:
+        raise ValueError('the scale must repeat at the octave, not at %.1f cents' % pitches[-1])
+    offsets = [0]
+    for semitone, cents in enumerate(pitches[:-1], start=1):
+        offset = round(cents - 100 * semitone)
+        if not -128 <= offset <= 127:
+            raise ValueError('step %d is %d cents away from equal temperament' % (semitone, offset))
+        offsets.append(offset)
+    return offsets
+
+
+def main():
+    if len(sys.argv) not in (2, 3):
+        sys.exit(__doc__.strip().splitlines()[-1])
+    path = sys.argv[1]
+    try:
+        description, pitches = read_scl(path)
+        offsets = to_offsets(pitches)
+    except (OSError, ValueError, IndexError) as error:
+        sys.exit('%s: %s' % (path, error))
+
+    name = sys.argv[2] if len(sys.argv) == 3 else os.path.splitext(os.path.basename(path))[0]
+    print('// Add to tunings in tunings.h, and increase NUM_TUNINGS:')
+    print('    {%s}, // %s' % (', '.join('%3d' % o for o in offsets), description.upper() or name.upper()))
+    print('// Add to tuning_names in display/display_strings.h:')
+    print('    "%s",' % name[:12])
+
+
+if __name__ == '__main__':
+    main()
@@ -23,6 +23,9 @@ void mpr121_i2c_init(){
 }
 
 
+// Readings of an electrode released before its release is reported, at one reading per touch task run
+#define DEBOUNCE_READINGS   ((MPR121_DEBOUNCE_MS * 1000 + TOUCH_PERIOD_US - 1) / TOUCH_PERIOD_US)
+
 // Perform a second pass of debouncing to better deal with long presses
 static bool debounced_states[12] = {false};
 static int debounce_counters[12] = {0};
@@ -32,7 +35,7 @@ static inline bool mpr121_debounce(uint8_t i, bool is_touched) {
             debounce_counters[i] = 0;
         } else if (!is_touched && debounced_states[i]) {
             debounce_counters[i]++;
-            if (debounce_counters[i] >= MPR121_DEBOUNCE_THRESHOLD) {
+            if (debounce_counters[i] >= DEBOUNCE_READINGS) {
                 debounced_states[i] = false;
                 debounce_counters[i] = 0;
             }
@@ -41,15 +44,16 @@ static inline bool mpr121_debounce(uint8_t i, bool is_touched) {
     return debounced_states[i];
 }
 
-void mpr121_task(){
+// Turn the electrode readings into touch events. Kept apart from the sensor
+// access, so that the same logic can be fed with recorded or generated readings.
+void touch_process(uint16_t touched, uint32_t now){
     bool is_touched;
     static bool was_touched[12];
     for(uint8_t i=0; i<12; i++) {
-        mpr121_is_touched(i, &is_touched, &mpr121);
-        is_touched = mpr121_debounce(i, is_touched);
+        is_touched = mpr121_debounce(i, touched & (1 << i));
         if (is_touched != was_touched[i]){
-            if(time_us_32() < 500000) return;  // Ignore readings for half a second,
-                                               // allowing the MPR121 to calibrate.
+            if(now < 500000) return;  // Ignore readings for half a second,
+                                      // allowing the MPR121 to calibrate.
             if (is_touched){
                 touch_on(i);
             } else {
@@ -58,4 +62,14 @@ void mpr121_task(){
             was_touched[i] = is_touched;
         }
     }
-}
\ No newline at end of file
+}
+
+void mpr121_task(){
+    bool is_touched;
+    uint16_t touched = 0;
+    for(uint8_t i=0; i<12; i++) {
+        mpr121_is_touched(i, &is_touched, &mpr121);
+        if (is_touched) { touched |= (1 << i); }
+    }
+    touch_process(touched, time_us_32());
+}
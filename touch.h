@@ -8,6 +8,7 @@ extern "C" {
 
 void mpr121_i2c_init();
 void mpr121_task();
+void touch_process(uint16_t touched, uint32_t now);
 
 extern void touch_on(uint8_t id);
 extern void touch_off(uint8_t id);
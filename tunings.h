@@ -0,0 +1,26 @@
+// Tuning tables, in cents from equal temperament for each semitone above the key.
+// More tunings can be converted from Scala files with tools/scl2tuning.py
+
+#ifndef TUNINGS_H
+#define TUNINGS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NUM_TUNINGS  7
+static const int8_t tunings[NUM_TUNINGS][12] = {
+    {  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0}, // EQUAL TEMPERAMENT
+    {  0,  12,   4,  16, -14,  -2, -10,   2,  14, -16,  18, -12}, // JUST INTONATION (5-limit)
+    {  0, -10,   4,  -6,   8,  -2,  12,   2,  -8,   6,  -4,  10}, // PYTHAGOREAN
+    {  0, -24,  -7,  10, -14,   3, -21,  -3, -27, -10,   7, -17}, // QUARTER-COMMA MEANTONE
+    {  0, -10,  -8,  -6, -10,  -2, -12,  -4,  -8, -12,  -4,  -8}, // WERCKMEISTER III
+    {  0,   0,   0,   0, -50,   0,   0,   0,   0,   0,   0, -50}, // MAQAM RAST (neutral third and seventh)
+    {  0,   5,   4,  -3, -14, -29, -49,   2,  41,   6, -31, -12}, // HARMONIC SERIES (harmonics 16 to 30)
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif